@@ -0,0 +1,296 @@
+#include "city_generator.h"
+
+#include <cmath>
+#include <iomanip>
+#include <stdexcept>
+#include <string>
+
+using namespace std;
+using namespace transport::bench;
+
+namespace
+{
+// Шаг решётки остановок: около 300 м по широте и по долготе на широте Москвы
+const double LATITUDE_STEP = 0.0027;
+const double LONGITUDE_STEP = 0.0048;
+const double BASE_LATITUDE = 55.5;
+const double BASE_LONGITUDE = 37.3;
+// Метров в градусе широты и косинус базовой широты: расстояния считаются без тригонометрии,
+// чтобы результат не зависел от реализации libm
+const double METERS_PER_DEGREE = 111195.0;
+const double LONGITUDE_SCALE = 0.5664;
+
+const char* const PALETTE[] = { "\"green\"", "[255, 160, 0]", "\"red\"", "[120, 60, 200, 0.8]",
+	"\"blue\"", "\"brown\"", "[30, 200, 160]", "\"purple\"", "[255, 80, 120, 0.6]", "\"orange\"" };
+
+// SplitMix64: последовательность задаётся только зерном
+class Random
+{
+public:
+	explicit Random(uint64_t seed)
+		: state_(seed)
+	{
+	}
+
+	uint64_t Next()
+	{
+		uint64_t z = (state_ += 0x9e3779b97f4a7c15ULL);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+		return z ^ (z >> 31);
+	}
+
+	size_t Below(size_t bound)
+	{
+		return static_cast<size_t>(Next() % bound);
+	}
+
+	// Равномерно в [0, 1)
+	double Uniform()
+	{
+		return (Next() >> 11) * (1.0 / 9007199254740992.0);
+	}
+
+private:
+	uint64_t state_;
+};
+
+string GetStopName(size_t stop)
+{
+	return "Stop "s + to_string(stop);
+}
+
+string GetBusName(size_t bus)
+{
+	return "Bus "s + to_string(bus);
+}
+} // namespace
+
+CityGenerator::CityGenerator(const CityOptions& options)
+	: options_(options)
+{
+	if (options_.stops_count < 2 || options_.min_route_stops < 2 || options_.min_route_stops > options_.max_route_stops)
+	{
+		throw invalid_argument("city needs at least 2 stops and 2 <= min_route_stops <= max_route_stops"s);
+	}
+	grid_side_ = static_cast<size_t>(ceil(sqrt(static_cast<double>(options_.stops_count))));
+	// У каждой части города своё зерно: изменение числа автобусов не сдвигает остановки
+	PlaceStops(options_.seed);
+	BuildRoutes(options_.seed + 1);
+	AddExtraDistances(options_.seed + 2);
+}
+
+void CityGenerator::WriteBaseRequests(ostream& output) const
+{
+	output << '[';
+	output << fixed << setprecision(6);
+	for (size_t stop = 0; stop < stops_.size(); ++stop)
+	{
+		const StopInfo& info = stops_[stop];
+		output << (stop == 0 ? "\n" : ",\n") << "{\"type\": \"Stop\", \"name\": \"" << GetStopName(stop)
+			<< "\", \"latitude\": " << info.latitude << ", \"longitude\": " << info.longitude
+			<< ", \"road_distances\": {";
+		for (size_t i = 0; i < info.distances.size(); ++i)
+		{
+			output << (i == 0 ? "\"" : ", \"") << GetStopName(info.distances[i].first) << "\": "
+				<< info.distances[i].second;
+		}
+		output << "}}";
+	}
+	for (size_t bus = 0; bus < buses_.size(); ++bus)
+	{
+		output << ",\n{\"type\": \"Bus\", \"name\": \"" << GetBusName(bus) << "\", \"stops\": [";
+		for (size_t i = 0; i < buses_[bus].stops.size(); ++i)
+		{
+			output << (i == 0 ? "\"" : ", \"") << GetStopName(buses_[bus].stops[i]) << '"';
+		}
+		output << "], \"is_roundtrip\": " << (buses_[bus].is_round ? "true" : "false") << '}';
+	}
+	output << "\n]";
+	output << defaultfloat;
+}
+
+void CityGenerator::WriteRenderSettings(ostream& output) const
+{
+	output << "{\"width\": " << options_.map_width << ", \"height\": " << options_.map_height
+		<< ", \"padding\": " << options_.map_padding
+		<< ", \"stop_radius\": 3, \"line_width\": 4, \"bus_label_font_size\": 14, \"bus_label_offset\": [7, 15]"
+		<< ", \"stop_label_font_size\": 12, \"stop_label_offset\": [7, -3]"
+		<< ", \"underlayer_color\": [255, 255, 255, 0.85], \"underlayer_width\": 3, \"color_palette\": [";
+	const size_t known_colors = sizeof(PALETTE) / sizeof(PALETTE[0]);
+	for (size_t i = 0; i < max<size_t>(1, options_.palette_size); ++i)
+	{
+		output << (i == 0 ? "" : ", ") << PALETTE[i % known_colors];
+	}
+	output << "]}";
+}
+
+void CityGenerator::WriteRoutingSettings(ostream& output, string_view engine) const
+{
+	output << "{\"bus_wait_time\": 6, \"bus_velocity\": 40";
+	if (!engine.empty())
+	{
+		output << ", \"engine\": \"" << engine << '"';
+	}
+	output << '}';
+}
+
+void CityGenerator::WriteStatRequests(const RequestMix& mix, ostream& output) const
+{
+	const double total_share = mix.stop_share + mix.bus_share + mix.map_share + mix.route_share;
+	if (total_share <= 0)
+	{
+		throw invalid_argument("request mix has no request types"s);
+	}
+	Random random(mix.seed);
+	output << '[';
+	for (size_t id = 0; id < mix.requests_count; ++id)
+	{
+		output << (id == 0 ? "\n" : ",\n") << "{\"id\": " << id << ", \"type\": ";
+		const double kind = random.Uniform() * total_share;
+		const bool is_missing = random.Uniform() < mix.missing_share;
+		if (kind < mix.stop_share)
+		{
+			output << "\"Stop\", \"name\": \""
+				<< (is_missing ? "Missing stop "s + to_string(id) : GetStopName(random.Below(stops_.size()))) << '"';
+		}
+		else if (kind < mix.stop_share + mix.bus_share && !buses_.empty())
+		{
+			output << "\"Bus\", \"name\": \""
+				<< (is_missing ? "Missing bus "s + to_string(id) : GetBusName(random.Below(buses_.size()))) << '"';
+		}
+		else if (kind < mix.stop_share + mix.bus_share + mix.map_share)
+		{
+			output << "\"Map\"";
+		}
+		else
+		{
+			output << "\"Route\", \"from\": \"" << GetStopName(random.Below(stops_.size()))
+				<< "\", \"to\": \"" << GetStopName(random.Below(stops_.size())) << '"';
+		}
+		output << '}';
+	}
+	output << "\n]";
+}
+
+void CityGenerator::WriteDocument(const RequestMix& mix, ostream& output) const
+{
+	output << "{\"base_requests\": ";
+	WriteBaseRequests(output);
+	output << ",\n\"render_settings\": ";
+	WriteRenderSettings(output);
+	output << ",\n\"routing_settings\": ";
+	WriteRoutingSettings(output);
+	output << ",\n\"stat_requests\": ";
+	WriteStatRequests(mix, output);
+	output << "}\n";
+}
+
+size_t CityGenerator::GetStopsCount() const
+{
+	return stops_.size();
+}
+
+size_t CityGenerator::GetBusesCount() const
+{
+	return buses_.size();
+}
+
+void CityGenerator::PlaceStops(uint64_t seed)
+{
+	Random random(seed);
+	stops_.resize(options_.stops_count);
+	for (size_t stop = 0; stop < stops_.size(); ++stop)
+	{
+		const double row = static_cast<double>(stop / grid_side_) + (random.Uniform() - 0.5) * 0.6;
+		const double column = static_cast<double>(stop % grid_side_) + (random.Uniform() - 0.5) * 0.6;
+		stops_[stop].latitude = BASE_LATITUDE + row * LATITUDE_STEP;
+		stops_[stop].longitude = BASE_LONGITUDE + column * LONGITUDE_STEP;
+	}
+}
+
+void CityGenerator::BuildRoutes(uint64_t seed)
+{
+	Random random(seed);
+	buses_.resize(options_.buses_count);
+	for (BusInfo& bus : buses_)
+	{
+		const size_t length = options_.min_route_stops
+			+ random.Below(options_.max_route_stops - options_.min_route_stops + 1);
+		bus.is_round = random.Uniform() < options_.round_trip_share;
+		bus.stops.push_back(static_cast<uint32_t>(random.Below(stops_.size())));
+		while (bus.stops.size() < length)
+		{
+			uint32_t next = GetNeighbour(bus.stops.back(), random.Next());
+			// Без возврата на предыдущую остановку, если есть другой сосед
+			if (bus.stops.size() > 1 && next == bus.stops[bus.stops.size() - 2])
+			{
+				next = GetNeighbour(bus.stops.back(), random.Next());
+			}
+			bus.stops.push_back(next);
+		}
+		if (bus.is_round)
+		{
+			bus.stops.push_back(bus.stops.front());
+		}
+		for (size_t i = 0; i + 1 < bus.stops.size(); ++i)
+		{
+			AddDistance(bus.stops[i], bus.stops[i + 1], 1.15 + 0.3 * random.Uniform());
+		}
+	}
+}
+
+void CityGenerator::AddExtraDistances(uint64_t seed)
+{
+	Random random(seed);
+	const double whole = floor(options_.extra_distances_per_stop);
+	const double fraction = options_.extra_distances_per_stop - whole;
+	for (size_t stop = 0; stop < stops_.size(); ++stop)
+	{
+		const size_t count = static_cast<size_t>(whole) + (random.Uniform() < fraction ? 1 : 0);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const uint32_t from = static_cast<uint32_t>(stop);
+			AddDistance(from, GetNeighbour(from, random.Next()), 1.15 + 0.3 * random.Uniform());
+		}
+	}
+}
+
+void CityGenerator::AddDistance(uint32_t from, uint32_t to, double stretch)
+{
+	if (from == to)
+	{
+		return;
+	}
+	vector<pair<uint32_t, int>>& distances = stops_[from].distances;
+	for (const auto& [stop, distance] : distances)
+	{
+		if (stop == to)
+		{
+			return;
+		}
+	}
+	const double dy = (stops_[to].latitude - stops_[from].latitude) * METERS_PER_DEGREE;
+	const double dx = (stops_[to].longitude - stops_[from].longitude) * METERS_PER_DEGREE * LONGITUDE_SCALE;
+	distances.emplace_back(to, max(1, static_cast<int>(sqrt(dx * dx + dy * dy) * stretch)));
+}
+
+uint32_t CityGenerator::GetNeighbour(uint32_t stop, uint64_t random) const
+{
+	const long long side = static_cast<long long>(grid_side_);
+	const long long row = stop / side;
+	const long long column = stop % side;
+	const long long shifts[4][2] = { {-1, 0}, {0, 1}, {1, 0}, {0, -1} };
+	for (size_t attempt = 0; attempt < 4; ++attempt)
+	{
+		const auto& shift = shifts[(random + attempt) % 4];
+		const long long next_row = row + shift[0];
+		const long long next_column = column + shift[1];
+		const long long next = next_row * side + next_column;
+		if (next_row >= 0 && next_column >= 0 && next_column < side && next < static_cast<long long>(stops_.size()))
+		{
+			return static_cast<uint32_t>(next);
+		}
+	}
+	return stop;
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace transport::bench
+{
+
+struct CityOptions
+{
+	size_t stops_count = 1000;
+	size_t buses_count = 50;
+	size_t min_route_stops = 5;
+	size_t max_route_stops = 30;
+	// Доля кольцевых маршрутов
+	double round_trip_share = 0.5;
+	// Среднее число дорожных расстояний на остановку сверх расстояний между соседями по маршрутам
+	double extra_distances_per_stop = 1.0;
+	// render_settings
+	double map_width = 1200.0;
+	double map_height = 800.0;
+	double map_padding = 50.0;
+	size_t palette_size = 8;
+	uint64_t seed = 1;
+};
+
+// Доли типов stat-запросов нормируются на их сумму
+struct RequestMix
+{
+	size_t requests_count = 1000;
+	double stop_share = 0.45;
+	double bus_share = 0.45;
+	double map_share = 0.0;
+	double route_share = 0.1;
+	// Доля запросов Stop и Bus с именем, которого нет в базе
+	double missing_share = 0.05;
+	uint64_t seed = 2;
+};
+
+/*
+* Детерминированный генератор города: остановки стоят в узлах решётки с небольшим сдвигом,
+* маршруты — случайные блуждания по соседним узлам, дорожное расстояние на 15–45% длиннее
+* расстояния по прямой. Используется собственный генератор случайных чисел, поэтому одинаковые
+* параметры дают побайтно одинаковый JSON на любой платформе и в любой стандартной библиотеке
+*/
+class CityGenerator
+{
+public:
+	explicit CityGenerator(const CityOptions& options);
+
+	// Значения соответствующих ключей входного документа
+	void WriteBaseRequests(std::ostream& output) const;
+	void WriteRenderSettings(std::ostream& output) const;
+	// Пустой engine — движок маршрутизации по умолчанию
+	void WriteRoutingSettings(std::ostream& output, std::string_view engine = {}) const;
+	void WriteStatRequests(const RequestMix& mix, std::ostream& output) const;
+
+	// Документ для запуска без ключа: base_requests, настройки и stat_requests
+	void WriteDocument(const RequestMix& mix, std::ostream& output) const;
+
+	size_t GetStopsCount() const;
+	size_t GetBusesCount() const;
+
+private:
+	struct StopInfo
+	{
+		double latitude = 0.0;
+		double longitude = 0.0;
+		// Номер остановки и расстояние до неё в метрах
+		std::vector<std::pair<uint32_t, int>> distances;
+	};
+
+	struct BusInfo
+	{
+		std::vector<uint32_t> stops;
+		bool is_round = false;
+	};
+
+	void PlaceStops(uint64_t seed);
+	void BuildRoutes(uint64_t seed);
+	void AddExtraDistances(uint64_t seed);
+	void AddDistance(uint32_t from, uint32_t to, double stretch);
+	// Случайная соседняя по решётке остановка
+	uint32_t GetNeighbour(uint32_t stop, uint64_t random) const;
+
+	CityOptions options_;
+	size_t grid_side_ = 1;
+	std::vector<StopInfo> stops_;
+	std::vector<BusInfo> buses_;
+};
+
+} // namespace transport::bench
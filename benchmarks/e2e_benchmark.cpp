@@ -0,0 +1,316 @@
+#include "city_generator.h"
+
+#include "json.h"
+#include "json_reader.h"
+#include "metrics.h"
+#include "transport_catalogue.h"
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace transport;
+using namespace transport::bench;
+
+namespace
+{
+struct BenchmarkOptions
+{
+	vector<size_t> scales = { 1000, 100000, 1000000 };
+	// Автобусов на остановку и stat-запросов на остановку, но не меньше минимума
+	double buses_per_stop = 0.05;
+	size_t requests_count = 20000;
+	RequestMix mix;
+	// RAPTOR строит таблицы маршрутов, а не граф, и умещается в память стенда на миллионе остановок
+	string routing_engine = "raptor"s;
+	int threads = 0;
+	string workdir = "."s;
+	string label;
+	string output_path;
+	bool keep_files = false;
+};
+
+vector<size_t> ParseScales(const string& value)
+{
+	vector<size_t> scales;
+	size_t start = 0;
+	while (start < value.size())
+	{
+		size_t end = value.find(',', start);
+		if (end == string::npos)
+		{
+			end = value.size();
+		}
+		scales.push_back(stoull(value.substr(start, end - start)));
+		start = end + 1;
+	}
+	return scales;
+}
+
+BenchmarkOptions ParseOptions(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	options.mix.route_share = 0.01;
+	options.mix.map_share = 0.0001;
+	for (int i = 1; i < argc; ++i)
+	{
+		const string_view key(argv[i]);
+		if (key == "--keep-files"sv)
+		{
+			options.keep_files = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			throw invalid_argument("missing value for "s + string(key));
+		}
+		const string value(argv[++i]);
+		if (key == "--scales"sv) options.scales = ParseScales(value);
+		else if (key == "--buses-per-stop"sv) options.buses_per_stop = stod(value);
+		else if (key == "--requests"sv) options.requests_count = stoull(value);
+		else if (key == "--stop-share"sv) options.mix.stop_share = stod(value);
+		else if (key == "--bus-share"sv) options.mix.bus_share = stod(value);
+		else if (key == "--map-share"sv) options.mix.map_share = stod(value);
+		else if (key == "--route-share"sv) options.mix.route_share = stod(value);
+		else if (key == "--missing-share"sv) options.mix.missing_share = stod(value);
+		else if (key == "--routing-engine"sv) options.routing_engine = value;
+		else if (key == "--threads"sv) options.threads = stoi(value);
+		else if (key == "--workdir"sv) options.workdir = value;
+		else if (key == "--label"sv) options.label = value;
+		else if (key == "--output"sv) options.output_path = value;
+		else throw invalid_argument("unknown option "s + string(key));
+	}
+	return options;
+}
+
+double GetMaxRssMegabytes()
+{
+	rusage usage{};
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_maxrss / 1024.0;
+}
+
+template <typename Function>
+double MeasureMilliseconds(Function function)
+{
+	const auto start = chrono::steady_clock::now();
+	function();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// Файловый буфер, который суммирует время записи в файл: ответы пишутся по мере выполнения
+// запросов, поэтому запись замеряется внутри выполнения. Вложенный вызов overflow из xsputn
+// не считается повторно
+class TimedFileBuffer : public filebuf
+{
+public:
+	double GetWriteMilliseconds() const
+	{
+		return write_ms_;
+	}
+
+protected:
+	streamsize xsputn(const char* data, streamsize size) override
+	{
+		return Measure([&]
+			{
+				return filebuf::xsputn(data, size);
+			});
+	}
+
+	int_type overflow(int_type c) override
+	{
+		return Measure([&]
+			{
+				return filebuf::overflow(c);
+			});
+	}
+
+	int sync() override
+	{
+		return Measure([&]
+			{
+				return filebuf::sync();
+			});
+	}
+
+private:
+	template <typename Function>
+	auto Measure(Function function) -> decltype(function())
+	{
+		if (is_measuring_)
+		{
+			return function();
+		}
+		is_measuring_ = true;
+		const auto start = chrono::steady_clock::now();
+		auto result = function();
+		write_ms_ += chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+		is_measuring_ = false;
+		return result;
+	}
+
+	double write_ms_ = 0.0;
+	bool is_measuring_ = false;
+};
+
+// Входной документ: настройки выполнения и сгенерированный город
+void WriteInput(const CityGenerator& city, const BenchmarkOptions& options, const RequestMix& mix, ostream& output)
+{
+	output << "{\"execution_settings\": {\"metrics\": true, \"pipeline\": false";
+	if (options.threads > 0)
+	{
+		output << ", \"threads\": " << options.threads;
+	}
+	output << "},\n\"base_requests\": ";
+	city.WriteBaseRequests(output);
+	output << ",\n\"render_settings\": ";
+	city.WriteRenderSettings(output);
+	// Маршрутизатор строится при первом запросе Route, поэтому без них настройки ничего не стоят
+	output << ",\n\"routing_settings\": ";
+	city.WriteRoutingSettings(output, options.routing_engine);
+	output << ",\n\"stat_requests\": ";
+	city.WriteStatRequests(mix, output);
+	output << "}\n";
+}
+
+double GetFileMegabytes(const string& path)
+{
+	ifstream file(path, ios::binary | ios::ate);
+	return static_cast<double>(file.tellg()) / (1 << 20);
+}
+
+json::Dict RunScale(size_t stops_count, const BenchmarkOptions& options)
+{
+	CityOptions city_options;
+	city_options.stops_count = stops_count;
+	city_options.buses_count = max<size_t>(1, static_cast<size_t>(stops_count * options.buses_per_stop));
+	RequestMix mix = options.mix;
+	mix.requests_count = options.requests_count;
+
+	const string input_path = options.workdir + "/city_"s + to_string(stops_count) + ".json"s;
+	const string output_path = options.workdir + "/city_"s + to_string(stops_count) + "_out.json"s;
+	const double generate_ms = MeasureMilliseconds([&]
+		{
+			const CityGenerator city(city_options);
+			ofstream input(input_path);
+			WriteInput(city, options, mix, input);
+			if (!input)
+			{
+				throw runtime_error("failed to write "s + input_path);
+			}
+		});
+
+	metrics::GetRegistry().Reset();
+	json::Dict result;
+	{
+		TransportCatalogue tc;
+		json_reader::Reader reader(tc);
+		const double parse_ms = MeasureMilliseconds([&]
+			{
+				ifstream input(input_path);
+				reader.ReadJSON(input);
+			});
+		const double build_ms = MeasureMilliseconds([&]
+			{
+				reader.ParseRequests();
+			});
+		// Ответы пишутся прямо в файл, как в обычном запуске, и время записи входит в execute_ms
+		TimedFileBuffer output_buffer;
+		if (!output_buffer.open(output_path, ios::out | ios::trunc))
+		{
+			throw runtime_error("failed to open "s + output_path);
+		}
+		ostream output(&output_buffer);
+		const double execute_ms = MeasureMilliseconds([&]
+			{
+				reader.GetResponses(output);
+				output_buffer.close();
+			});
+		const double output_ms = output_buffer.GetWriteMilliseconds();
+
+		const json::Dict registry = metrics::GetRegistry().ToJSON();
+		const json::Dict& phases = registry.at("phases"s).AsMap();
+		const auto get_phase_ms = [&phases](const string& phase)
+		{
+			const auto it = phases.find(phase);
+			return it == phases.end() ? 0.0 : it->second.AsMap().at("total_ms"s).AsDouble();
+		};
+		const auto requests = registry.find("requests"s);
+		result = json::Dict{
+			{"stops"s, static_cast<int>(stops_count)},
+			{"buses"s, static_cast<int>(city_options.buses_count)},
+			{"stat_requests"s, static_cast<int>(mix.requests_count)},
+			{"input_mb"s, GetFileMegabytes(input_path)},
+			{"output_mb"s, GetFileMegabytes(output_path)},
+			{"generate_ms"s, generate_ms},
+			{"parse_ms"s, parse_ms},
+			{"build_ms"s, build_ms},
+			// Подготовка рендерера и маршрутизатора входит в execute_ms
+			{"prepare_ms"s, get_phase_ms("prepare"s)},
+			{"render_map_ms"s, get_phase_ms("render_map"s)},
+			{"execute_ms"s, execute_ms},
+			// Часть execute_ms
+			{"output_ms"s, output_ms},
+			{"total_ms"s, parse_ms + build_ms + execute_ms},
+			{"max_rss_mb"s, GetMaxRssMegabytes()},
+			{"requests"s, requests == registry.end() ? json::Node(json::Dict{}) : requests->second} };
+	}
+	if (!options.keep_files)
+	{
+		remove(input_path.c_str());
+		remove(output_path.c_str());
+	}
+	return result;
+}
+} // namespace
+
+/*
+* Сквозной бенчмарк: для каждого масштаба генерирует город, замеряет разбор JSON,
+* построение каталога, выполнение stat-запросов (Stop, Bus, Map и по --route-share Route) и запись ответа.
+* Результаты выводятся в JSON в stdout или в файл --output
+*/
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const BenchmarkOptions options = ParseOptions(argc, argv);
+		json::Array scales;
+		for (size_t stops_count : options.scales)
+		{
+			cerr << "stops: "sv << stops_count << "..."sv << endl;
+			scales.emplace_back(RunScale(stops_count, options));
+		}
+		json::Dict results;
+		results.emplace("benchmark"s, "e2e"s);
+		results.emplace("label"s, options.label);
+		results.emplace("threads"s, options.threads);
+		results.emplace("scales"s, move(scales));
+		const json::Document document{ move(results) };
+		if (options.output_path.empty())
+		{
+			json::Print(document, cout);
+			cout << endl;
+		}
+		else
+		{
+			ofstream output(options.output_path);
+			json::Print(document, output);
+			output << endl;
+		}
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,55 @@
+#include "city_generator.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+using namespace std;
+using namespace transport::bench;
+
+/*
+* Пишет в stdout входной документ синтетического города:
+* generate_city --stops 100000 --buses 5000 --requests 20000 --map-share 0.001 > city.json
+*/
+int main(int argc, char* argv[])
+{
+	CityOptions city;
+	RequestMix mix;
+	try
+	{
+		for (int i = 1; i < argc; i += 2)
+		{
+			const string_view key(argv[i]);
+			if (i + 1 >= argc)
+			{
+				throw invalid_argument("missing value for "s + string(key));
+			}
+			const string value(argv[i + 1]);
+			if (key == "--stops"sv) city.stops_count = stoull(value);
+			else if (key == "--buses"sv) city.buses_count = stoull(value);
+			else if (key == "--min-route-stops"sv) city.min_route_stops = stoull(value);
+			else if (key == "--max-route-stops"sv) city.max_route_stops = stoull(value);
+			else if (key == "--round-trip-share"sv) city.round_trip_share = stod(value);
+			else if (key == "--extra-distances"sv) city.extra_distances_per_stop = stod(value);
+			else if (key == "--palette-size"sv) city.palette_size = stoull(value);
+			else if (key == "--seed"sv) city.seed = stoull(value);
+			else if (key == "--requests"sv) mix.requests_count = stoull(value);
+			else if (key == "--stop-share"sv) mix.stop_share = stod(value);
+			else if (key == "--bus-share"sv) mix.bus_share = stod(value);
+			else if (key == "--map-share"sv) mix.map_share = stod(value);
+			else if (key == "--route-share"sv) mix.route_share = stod(value);
+			else if (key == "--missing-share"sv) mix.missing_share = stod(value);
+			else if (key == "--requests-seed"sv) mix.seed = stoull(value);
+			else throw invalid_argument("unknown option "s + string(key));
+		}
+		ios::sync_with_stdio(false);
+		CityGenerator(city).WriteDocument(mix, cout);
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,259 @@
+#include "city_generator.h"
+
+#include "json.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace transport;
+using namespace transport::bench;
+
+namespace
+{
+struct Options
+{
+	CityOptions city;
+	size_t lookups_count = 1000000;
+	uint64_t lookups_seed = 5;
+	// Буфер, который перезаписывается перед каждым замером, чтобы вытеснить каталог из кэшей
+	size_t flush_mb = 512;
+	size_t repetitions = 3;
+	string label;
+	string output_path;
+};
+
+Options ParseOptions(int argc, char* argv[])
+{
+	Options options;
+	options.city.stops_count = 100000;
+	options.city.buses_count = 20000;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const string_view key(argv[i]);
+		if (i + 1 >= argc)
+		{
+			throw invalid_argument("missing value for "s + string(key));
+		}
+		const string value(argv[i + 1]);
+		if (key == "--stops"sv) options.city.stops_count = stoull(value);
+		else if (key == "--buses"sv) options.city.buses_count = stoull(value);
+		else if (key == "--seed"sv) options.city.seed = stoull(value);
+		else if (key == "--lookups"sv) options.lookups_count = stoull(value);
+		else if (key == "--lookups-seed"sv) options.lookups_seed = stoull(value);
+		else if (key == "--flush-mb"sv) options.flush_mb = stoull(value);
+		else if (key == "--repetitions"sv) options.repetitions = stoull(value);
+		else if (key == "--label"sv) options.label = value;
+		else if (key == "--output"sv) options.output_path = value;
+		else throw invalid_argument("unknown option "s + string(key));
+	}
+	return options;
+}
+
+template <typename Function>
+double MeasureMilliseconds(Function function)
+{
+	const auto start = chrono::steady_clock::now();
+	function();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+double GetMedian(vector<double> values)
+{
+	nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+	return values[values.size() / 2];
+}
+
+class CacheFlusher
+{
+public:
+	explicit CacheFlusher(size_t megabytes)
+		: buffer_(megabytes << 20)
+	{
+	}
+
+	void Flush()
+	{
+		for (size_t i = 0; i < buffer_.size(); i += 64)
+		{
+			++buffer_[i];
+		}
+	}
+
+private:
+	vector<char> buffer_;
+};
+
+// Ответы пакетного и поштучного поиска должны совпадать, поэтому оба сводятся к одной сумме
+size_t GetChecksum(const vector<const sv_set*>& buses)
+{
+	size_t checksum = 0;
+	for (const sv_set* stop_buses : buses)
+	{
+		checksum = checksum * 31 + (stop_buses ? stop_buses->size() + 1 : 0);
+	}
+	return checksum;
+}
+
+size_t GetChecksum(const vector<optional<domain::RouteInfo>>& route_infos)
+{
+	size_t checksum = 0;
+	for (const optional<domain::RouteInfo>& route_info : route_infos)
+	{
+		checksum = checksum * 31 + (route_info ? route_info->n_stops + 1 : 0);
+	}
+	return checksum;
+}
+
+// Медианы поштучного и пакетного поиска одного набора имён
+template <typename Single, typename Batch>
+json::Dict Compare(CacheFlusher& flusher, size_t repetitions, Single single, Batch batch)
+{
+	vector<double> single_ms;
+	vector<double> batch_ms;
+	size_t single_checksum = 0;
+	size_t batch_checksum = 0;
+	for (size_t repetition = 0; repetition < repetitions; ++repetition)
+	{
+		flusher.Flush();
+		single_ms.push_back(MeasureMilliseconds([&]
+			{
+				single_checksum = single();
+			}));
+		flusher.Flush();
+		batch_ms.push_back(MeasureMilliseconds([&]
+			{
+				batch_checksum = batch();
+			}));
+	}
+	if (single_checksum != batch_checksum)
+	{
+		throw logic_error("batch lookup results differ from single lookups"s);
+	}
+	const double single_median = GetMedian(single_ms);
+	const double batch_median = GetMedian(batch_ms);
+	return json::Dict{
+		{"single_ms"s, single_median},
+		{"batch_ms"s, batch_median},
+		{"speedup"s, single_median / batch_median} };
+}
+} // namespace
+
+/*
+* Сравнивает поштучный и пакетный поиск RequestHandler на синтетическом городе
+* (по умолчанию 100000 остановок и 20000 автобусов): --lookups случайных имён остановок
+* (GetBusesByStop и GetBusesByStops) и автобусов (GetRouteInfo и GetRouteInfos), доля 5%
+* имён отсутствует в базе. Перед каждым замером перезаписывается буфер --flush-mb мегабайт,
+* поэтому каталог читается из памяти, а не из кэшей процессора
+*/
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+		const CityGenerator city(options.city);
+		stringstream document;
+		document << "{\"base_requests\": ";
+		city.WriteBaseRequests(document);
+		document << "}";
+		TransportCatalogue tc;
+		json_reader::Reader reader(tc);
+		reader.ReadJSON(document);
+		reader.ParseRequests();
+		renderer::MapRenderer renderer({});
+		const request_handler::RequestHandler handler(tc, renderer, nullopt);
+
+		mt19937_64 random(options.lookups_seed);
+		vector<string> stop_names;
+		vector<string> bus_names;
+		stop_names.reserve(options.lookups_count);
+		bus_names.reserve(options.lookups_count);
+		for (size_t i = 0; i < options.lookups_count; ++i)
+		{
+			const bool is_missing = random() % 20 == 0;
+			stop_names.push_back(is_missing ? "Missing stop "s + to_string(i)
+				: tc.GetStops()[random() % tc.GetStops().size()].name);
+			bus_names.push_back(is_missing ? "Missing bus "s + to_string(i)
+				: tc.GetBuses()[random() % tc.GetBuses().size()].name);
+		}
+		const vector<string_view> stops(stop_names.begin(), stop_names.end());
+		const vector<string_view> buses(bus_names.begin(), bus_names.end());
+
+		CacheFlusher flusher(options.flush_mb);
+		cerr << "stops..."sv << endl;
+		json::Dict stops_result = Compare(flusher, options.repetitions,
+			[&]
+			{
+				vector<const sv_set*> results;
+				results.reserve(stops.size());
+				for (string_view name : stops)
+				{
+					results.push_back(handler.GetBusesByStop(name));
+				}
+				return GetChecksum(results);
+			},
+			[&]
+			{
+				vector<const sv_set*> results;
+				handler.GetBusesByStops(stops, results);
+				return GetChecksum(results);
+			});
+		cerr << "buses..."sv << endl;
+		json::Dict buses_result = Compare(flusher, options.repetitions,
+			[&]
+			{
+				vector<optional<domain::RouteInfo>> results;
+				results.reserve(buses.size());
+				for (string_view name : buses)
+				{
+					results.push_back(handler.GetRouteInfo(name));
+				}
+				return GetChecksum(results);
+			},
+			[&]
+			{
+				vector<optional<domain::RouteInfo>> results;
+				handler.GetRouteInfos(buses, results);
+				return GetChecksum(results);
+			});
+
+		json::Dict results{
+			{"benchmark"s, "lookup"s},
+			{"label"s, options.label},
+			{"stops"s, static_cast<int>(city.GetStopsCount())},
+			{"buses"s, static_cast<int>(city.GetBusesCount())},
+			{"lookups"s, static_cast<int>(options.lookups_count)},
+			{"buses_by_stop"s, move(stops_result)},
+			{"route_info"s, move(buses_result)} };
+		const json::Document result_document{ move(results) };
+		if (options.output_path.empty())
+		{
+			json::Print(result_document, cout);
+			cout << endl;
+		}
+		else
+		{
+			ofstream output(options.output_path);
+			json::Print(result_document, output);
+			output << endl;
+		}
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,553 @@
+#include "city_generator.h"
+
+#include "geo.h"
+#include "json.h"
+#include "svg.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace transport::bench;
+
+// Все выделения памяти процесса проходят через счётчик: из него берётся allocs/op
+namespace
+{
+atomic<uint64_t> allocations_count{ 0 };
+
+void* Allocate(size_t size)
+{
+	allocations_count.fetch_add(1, memory_order_relaxed);
+	if (void* pointer = malloc(size == 0 ? 1 : size))
+	{
+		return pointer;
+	}
+	throw bad_alloc();
+}
+} // namespace
+
+void* operator new(size_t size)
+{
+	return Allocate(size);
+}
+
+void* operator new[](size_t size)
+{
+	return Allocate(size);
+}
+
+void operator delete(void* pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void* pointer) noexcept
+{
+	free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept
+{
+	free(pointer);
+}
+
+namespace
+{
+struct Options
+{
+	string filter;
+	double min_time_ms = 200.0;
+	int repetitions = 5;
+	string label;
+	string output_path;
+	string baseline_path;
+	// Допустимый рост ns/op относительно базовой линии
+	double threshold = 0.1;
+};
+
+struct Result
+{
+	string name;
+	double ns_per_op = 0.0;
+	double mb_per_s = 0.0;
+	double allocs_per_op = 0.0;
+	uint64_t iterations = 0;
+};
+
+// Поток, который только считает байты: форматирование замеряется без роста буфера
+class CountingBuffer : public streambuf
+{
+public:
+	size_t GetSize() const
+	{
+		return size_ + (pptr() - pbase());
+	}
+
+protected:
+	int_type overflow(int_type c) override
+	{
+		size_ += pptr() - pbase();
+		setp(buffer_, buffer_ + sizeof(buffer_));
+		if (!traits_type::eq_int_type(c, traits_type::eof()))
+		{
+			sputc(traits_type::to_char_type(c));
+		}
+		return traits_type::not_eof(c);
+	}
+
+private:
+	char buffer_[4096];
+	size_t size_ = 0;
+};
+
+// Не даёт компилятору выбросить результат замеряемой функции
+template <typename Value>
+void DoNotOptimize(const Value& value)
+{
+	asm volatile("" : : "r,m"(value) : "memory");
+}
+
+/*
+* Каждая операция повторяется, пока замер не займёт min_time_ms; из repetitions
+* замеров берётся медиана ns/op. bytes_per_op — объём данных одной операции для MB/s
+*/
+class Harness
+{
+public:
+	explicit Harness(const Options& options)
+		: options_(options)
+	{
+	}
+
+	void Run(const string& name, size_t bytes_per_op, const function<void()>& operation)
+	{
+		if (!options_.filter.empty() && name.find(options_.filter) == string::npos)
+		{
+			return;
+		}
+		operation();
+		uint64_t iterations = 1;
+		while (MeasureNanoseconds(operation, iterations) < options_.min_time_ms * 1e6 && iterations < (1ULL << 40))
+		{
+			iterations *= 2;
+		}
+		vector<double> samples;
+		uint64_t allocations = 0;
+		for (int repetition = 0; repetition < max(1, options_.repetitions); ++repetition)
+		{
+			const uint64_t allocations_before = allocations_count.load(memory_order_relaxed);
+			samples.push_back(MeasureNanoseconds(operation, iterations) / iterations);
+			allocations += allocations_count.load(memory_order_relaxed) - allocations_before;
+		}
+		sort(samples.begin(), samples.end());
+
+		Result result;
+		result.name = name;
+		result.ns_per_op = samples[samples.size() / 2];
+		result.mb_per_s = bytes_per_op == 0 ? 0.0 : bytes_per_op / result.ns_per_op * 1e9 / (1 << 20);
+		result.allocs_per_op = static_cast<double>(allocations) / (iterations * samples.size());
+		result.iterations = iterations;
+		cerr << fixed << setprecision(1) << name << ": "sv << result.ns_per_op << " ns/op, "sv << result.mb_per_s << " MB/s, "sv
+			<< setprecision(2) << result.allocs_per_op << " allocs/op"sv << defaultfloat << endl;
+		results_.push_back(move(result));
+	}
+
+	const vector<Result>& GetResults() const
+	{
+		return results_;
+	}
+
+private:
+	static double MeasureNanoseconds(const function<void()>& operation, uint64_t iterations)
+	{
+		const auto start = chrono::steady_clock::now();
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			operation();
+		}
+		return chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+	}
+
+	const Options& options_;
+	vector<Result> results_;
+};
+
+Options ParseOptions(int argc, char* argv[])
+{
+	Options options;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const string_view key(argv[i]);
+		if (i + 1 >= argc)
+		{
+			throw invalid_argument("missing value for "s + string(key));
+		}
+		const string value(argv[i + 1]);
+		if (key == "--filter"sv) options.filter = value;
+		else if (key == "--min-time-ms"sv) options.min_time_ms = stod(value);
+		else if (key == "--repetitions"sv) options.repetitions = stoi(value);
+		else if (key == "--label"sv) options.label = value;
+		else if (key == "--output"sv) options.output_path = value;
+		else if (key == "--baseline"sv) options.baseline_path = value;
+		else if (key == "--threshold"sv) options.threshold = stod(value);
+		else throw invalid_argument("unknown option "s + string(key));
+	}
+	return options;
+}
+
+// Остановки синтетического города: массив словарей с координатами и расстояниями
+string MakeCoordinatesFixture()
+{
+	CityOptions city;
+	city.stops_count = 2000;
+	city.buses_count = 100;
+	ostringstream output;
+	CityGenerator(city).WriteBaseRequests(output);
+	return output.str();
+}
+
+// Длинные строки с кириллицей, экранированными символами и разметкой
+string MakeUnicodeFixture()
+{
+	const string phrase = "Улица Академика Королёва, \\\"Останкино\\\" — ТЦ <Золотой Вавилон> & парк\\n"s;
+	string fixture = "["s;
+	for (int i = 0; i < 500; ++i)
+	{
+		fixture += (i == 0 ? "\""s : ",\n\""s);
+		for (int j = 0; j < 8; ++j)
+		{
+			fixture += phrase;
+		}
+		fixture += to_string(i) + "\""s;
+	}
+	return fixture + "]"s;
+}
+
+vector<svg::Point> MakePolylinePoints(size_t line, size_t points_count)
+{
+	vector<svg::Point> points;
+	for (size_t point = 0; point < points_count; ++point)
+	{
+		points.emplace_back(50.0 + (point * 7919 + line * 104729) % 110000 / 100.0,
+			50.0 + (point * 6271 + line * 130363) % 70000 / 100.0);
+	}
+	return points;
+}
+
+svg::Point GetLabelPosition(size_t label)
+{
+	return { 20.0 + label % 1000 * 1.17, 20.0 + label / 1000 * 3.31 };
+}
+
+const svg::Color LINE_COLOR{ "green"s };
+const svg::Color UNDERLAYER_COLOR{ svg::Rgba(255, 255, 255, 0.85) };
+const svg::Color LABEL_COLOR{ "black"s };
+const svg::Color CIRCLE_COLOR{ "white"s };
+
+svg::Document MakePolylinesFixture(size_t polylines_count, size_t points_count)
+{
+	svg::Document document;
+	for (size_t line = 0; line < polylines_count; ++line)
+	{
+		svg::Polyline polyline;
+		for (svg::Point point : MakePolylinePoints(line, points_count))
+		{
+			polyline.AddPoint(point);
+		}
+		polyline.SetStrokeColor(LINE_COLOR).SetFillColor(svg::NoneColor).SetStrokeWidth(14)
+			.SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+		document.Add(move(polyline));
+	}
+	return document;
+}
+
+// Подписи остановок с подложкой и круги, как на карте MapRenderer
+svg::Document MakeLabelsFixture(size_t labels_count)
+{
+	svg::Document document;
+	for (size_t label = 0; label < labels_count; ++label)
+	{
+		svg::Text text;
+		text.SetPosition(GetLabelPosition(label)).SetOffset({ 7, -3 }).SetFontSize(20).SetFontFamily("Verdana"s)
+			.SetData("Остановка "s + to_string(label));
+		svg::Text underlayer = text;
+		underlayer.SetFillColor(UNDERLAYER_COLOR).SetStrokeColor(UNDERLAYER_COLOR)
+			.SetStrokeWidth(3).SetStrokeLineCap(svg::StrokeLineCap::ROUND).SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+		text.SetFillColor(LABEL_COLOR);
+		document.Add(move(underlayer));
+		document.Add(move(text));
+		document.Add(svg::Circle().SetCenter(GetLabelPosition(label)).SetRadius(5).SetFillColor(CIRCLE_COLOR));
+	}
+	return document;
+}
+
+// Те же ломаные, что у MakePolylinesFixture, через svg::Writer
+void WritePolylines(const vector<vector<svg::Point>>& lines, svg::Writer& writer)
+{
+	svg::PathAttrs attrs;
+	attrs.fill_color = &svg::NoneColor;
+	attrs.stroke_color = &LINE_COLOR;
+	attrs.stroke_width = 14;
+	attrs.stroke_linecap = svg::StrokeLineCap::ROUND;
+	attrs.stroke_linejoin = svg::StrokeLineJoin::ROUND;
+	writer.BeginDocument();
+	for (const vector<svg::Point>& line : lines)
+	{
+		writer.WritePolyline(line, attrs);
+	}
+	writer.EndDocument();
+}
+
+// Те же подписи, что у MakeLabelsFixture, через svg::Writer
+void WriteLabels(const vector<string>& labels, svg::Writer& writer)
+{
+	svg::PathAttrs underlayer;
+	underlayer.fill_color = &UNDERLAYER_COLOR;
+	underlayer.stroke_color = &UNDERLAYER_COLOR;
+	underlayer.stroke_width = 3;
+	underlayer.stroke_linecap = svg::StrokeLineCap::ROUND;
+	underlayer.stroke_linejoin = svg::StrokeLineJoin::ROUND;
+	svg::PathAttrs fill;
+	fill.fill_color = &LABEL_COLOR;
+	svg::PathAttrs circle;
+	circle.fill_color = &CIRCLE_COLOR;
+	writer.BeginDocument();
+	for (size_t label = 0; label < labels.size(); ++label)
+	{
+		svg::TextAttrs text;
+		text.position = GetLabelPosition(label);
+		text.offset = { 7, -3 };
+		text.font_size = 20;
+		text.font_family = "Verdana"sv;
+		writer.WriteText(text, labels[label], underlayer);
+		writer.WriteText(text, labels[label], fill);
+		writer.WriteCircle(text.position, 5, circle);
+	}
+	writer.EndDocument();
+}
+
+vector<geo::Coordinates> MakeCoordinates(size_t count)
+{
+	vector<geo::Coordinates> coordinates;
+	coordinates.reserve(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		coordinates.push_back({ 55.5 + (i * 7919 % 10007) * 0.00004, 37.3 + (i * 6271 % 10009) * 0.00006 });
+	}
+	return coordinates;
+}
+
+void RunBenchmarks(Harness& harness)
+{
+	const string coordinates_json = MakeCoordinatesFixture();
+	const string unicode_json = MakeUnicodeFixture();
+	for (const auto& [name, fixture] : { pair{ "json::Load coordinates"s, &coordinates_json },
+		pair{ "json::Load unicode_strings"s, &unicode_json } })
+	{
+		harness.Run(name, fixture->size(), [&fixture = *fixture]
+			{
+				istringstream input(fixture);
+				DoNotOptimize(json::Load(input));
+			});
+	}
+	for (const auto& [name, fixture] : { pair{ "json::Print coordinates"s, &coordinates_json },
+		pair{ "json::Print unicode_strings"s, &unicode_json } })
+	{
+		istringstream input(*fixture);
+		const json::Document document = json::Load(input);
+		CountingBuffer counter;
+		ostream output(&counter);
+		json::Print(document, output);
+		harness.Run(name, counter.GetSize(), [&document]
+			{
+				CountingBuffer buffer;
+				ostream output(&buffer);
+				json::Print(document, output);
+				DoNotOptimize(buffer);
+			});
+	}
+
+	const svg::Document polylines = MakePolylinesFixture(100, 1000);
+	const svg::Document labels = MakeLabelsFixture(5000);
+	for (const auto& [name, document] : { pair{ "svg::Document::Render polylines"s, &polylines },
+		pair{ "svg::Document::Render labels"s, &labels } })
+	{
+		CountingBuffer counter;
+		ostream output(&counter);
+		document->Render(output);
+		harness.Run(name, counter.GetSize(), [&document = *document]
+			{
+				CountingBuffer buffer;
+				ostream output(&buffer);
+				document.Render(output);
+				DoNotOptimize(buffer);
+			});
+	}
+
+	vector<vector<svg::Point>> lines;
+	for (size_t line = 0; line < 100; ++line)
+	{
+		lines.push_back(MakePolylinePoints(line, 1000));
+	}
+	vector<string> label_texts;
+	for (size_t label = 0; label < 5000; ++label)
+	{
+		label_texts.push_back("Остановка "s + to_string(label));
+	}
+	string svg_buffer;
+	for (const auto& [name, write] : { pair{ "svg::Writer polylines"s, function<void(svg::Writer&)>([&lines](svg::Writer& writer)
+			{
+				WritePolylines(lines, writer);
+			}) },
+		pair{ "svg::Writer labels"s, function<void(svg::Writer&)>([&label_texts](svg::Writer& writer)
+			{
+				WriteLabels(label_texts, writer);
+			}) } })
+	{
+		svg_buffer.clear();
+		svg::Writer writer(svg_buffer);
+		write(writer);
+		// Буфер переиспользуется между операциями, как в кэше карты
+		harness.Run(name, svg_buffer.size(), [&svg_buffer, &write = write]
+			{
+				svg_buffer.clear();
+				svg::Writer writer(svg_buffer);
+				write(writer);
+				DoNotOptimize(svg_buffer);
+			});
+	}
+
+	const string plain_label = "Остановка Улица Академика Королёва 12"s;
+	const string markup_label = "\"Бар\" <Пивная & Ко> 'у Петровича' — Улица Академика Королёва"s;
+	for (const auto& [name, label] : { pair{ "svg::Text::SetData plain"s, &plain_label },
+		pair{ "svg::Text::SetData markup"s, &markup_label } })
+	{
+		svg::Text text;
+		harness.Run(name, label->size(), [&text, &label = *label]
+			{
+				text.SetData(label);
+				DoNotOptimize(text);
+			});
+	}
+
+	const vector<geo::Coordinates> coordinates = MakeCoordinates(4096);
+	size_t index = 0;
+	harness.Run("geo::ComputeDistance"s, 0, [&coordinates, &index]
+		{
+			const double distance = geo::ComputeDistance(coordinates[index], coordinates[(index + 1) & 4095]);
+			index = (index + 1) & 4095;
+			DoNotOptimize(distance);
+		});
+}
+
+json::Document MakeReport(const Options& options, const vector<Result>& results)
+{
+	json::Dict benchmarks;
+	for (const Result& result : results)
+	{
+		json::Dict entry;
+		entry.emplace("ns_per_op"s, result.ns_per_op);
+		entry.emplace("mb_per_s"s, result.mb_per_s);
+		entry.emplace("allocs_per_op"s, result.allocs_per_op);
+		entry.emplace("iterations"s, static_cast<double>(result.iterations));
+		benchmarks.emplace(result.name, move(entry));
+	}
+	json::Dict report;
+	report.emplace("benchmark"s, "micro"s);
+	report.emplace("label"s, options.label);
+	report.emplace("results"s, move(benchmarks));
+	return json::Document{ move(report) };
+}
+
+// Сравнивает с базовой линией; возвращает число регрессий
+int CompareWithBaseline(const Options& options, const vector<Result>& results)
+{
+	ifstream input(options.baseline_path);
+	if (!input)
+	{
+		throw runtime_error("failed to open baseline "s + options.baseline_path);
+	}
+	const json::Document document = json::Load(input);
+	const json::Dict& baseline = document.GetRoot().AsMap().at("results"s).AsMap();
+	int regressions = 0;
+	for (const Result& result : results)
+	{
+		const auto it = baseline.find(result.name);
+		if (it == baseline.end())
+		{
+			cout << result.name << ": no baseline"sv << endl;
+			continue;
+		}
+		const double baseline_ns = it->second.AsMap().at("ns_per_op"s).AsDouble();
+		const double baseline_allocs = it->second.AsMap().at("allocs_per_op"s).AsDouble();
+		const double change = baseline_ns == 0 ? 0.0 : result.ns_per_op / baseline_ns - 1.0;
+		// Число выделений почти не зависит от шума замера: регрессия — рост в среднем на половину выделения за операцию
+		const bool is_slower = change > options.threshold;
+		const bool allocates_more = result.allocs_per_op > baseline_allocs + 0.5;
+		cout << result.name << ": "sv << baseline_ns << " -> "sv << result.ns_per_op << " ns/op ("sv
+			<< (change >= 0 ? "+"sv : ""sv) << change * 100 << "%), allocs/op "sv << baseline_allocs << " -> "sv
+			<< result.allocs_per_op;
+		if (is_slower || allocates_more)
+		{
+			cout << "  REGRESSION"sv;
+			++regressions;
+		}
+		cout << endl;
+	}
+	return regressions;
+}
+} // namespace
+
+/*
+* Микробенчмарки горячих функций json, svg и geo. Результаты в JSON выводятся в stdout
+* или в файл --output, который затем можно передать как --baseline: тогда вместо отчёта
+* выводится сравнение, а при регрессиях программа завершается с кодом 2
+*/
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+		Harness harness(options);
+		RunBenchmarks(harness);
+		const json::Document report = MakeReport(options, harness.GetResults());
+		if (!options.output_path.empty())
+		{
+			ofstream output(options.output_path);
+			json::Print(report, output);
+			output << endl;
+		}
+		if (!options.baseline_path.empty())
+		{
+			return CompareWithBaseline(options, harness.GetResults()) == 0 ? 0 : 2;
+		}
+		if (options.output_path.empty())
+		{
+			json::Print(report, cout);
+			cout << endl;
+		}
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
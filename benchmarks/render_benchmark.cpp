@@ -0,0 +1,236 @@
+#include "city_generator.h"
+
+#include "json.h"
+#include "json_reader.h"
+#include "map_renderer.h"
+#include "request_handler.h"
+#include "svg.h"
+#include "transport_catalogue.h"
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace transport;
+using namespace transport::bench;
+
+namespace
+{
+struct Options
+{
+	CityOptions city;
+	size_t repetitions = 5;
+	double simplify_tolerance = 0;
+	bool hide_overlapping_labels = false;
+	string label;
+	string output_path;
+};
+
+Options ParseOptions(int argc, char* argv[])
+{
+	Options options;
+	options.city.stops_count = 50000;
+	options.city.buses_count = 2500;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const string_view key(argv[i]);
+		if (i + 1 >= argc)
+		{
+			throw invalid_argument("missing value for "s + string(key));
+		}
+		const string value(argv[i + 1]);
+		if (key == "--stops"sv) options.city.stops_count = stoull(value);
+		else if (key == "--buses"sv) options.city.buses_count = stoull(value);
+		else if (key == "--min-route-stops"sv) options.city.min_route_stops = stoull(value);
+		else if (key == "--max-route-stops"sv) options.city.max_route_stops = stoull(value);
+		else if (key == "--seed"sv) options.city.seed = stoull(value);
+		else if (key == "--repetitions"sv) options.repetitions = stoull(value);
+		else if (key == "--simplify-tolerance"sv) options.simplify_tolerance = stod(value);
+		else if (key == "--hide-overlapping-labels"sv) options.hide_overlapping_labels = value == "true"sv;
+		else if (key == "--label"sv) options.label = value;
+		else if (key == "--output"sv) options.output_path = value;
+		else throw invalid_argument("unknown option "s + string(key));
+	}
+	if (options.repetitions == 0)
+	{
+		throw invalid_argument("--repetitions must be positive"s);
+	}
+	return options;
+}
+
+template <typename Function>
+double MeasureMilliseconds(Function function)
+{
+	const auto start = chrono::steady_clock::now();
+	function();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+double GetMedian(vector<double> values)
+{
+	nth_element(values.begin(), values.begin() + values.size() / 2, values.end());
+	return values[values.size() / 2];
+}
+
+// Считает записанные байты и отбрасывает их, чтобы замер не включал запись на диск
+class CountingBuffer : public streambuf
+{
+public:
+	size_t GetSize() const
+	{
+		return size_;
+	}
+
+protected:
+	streamsize xsputn(const char*, streamsize count) override
+	{
+		size_ += static_cast<size_t>(count);
+		return count;
+	}
+	int_type overflow(int_type character) override
+	{
+		if (!traits_type::eq_int_type(character, traits_type::eof()))
+		{
+			++size_;
+		}
+		return traits_type::not_eof(character);
+	}
+
+private:
+	size_t size_ = 0;
+};
+
+// Те же настройки, что CityGenerator::WriteRenderSettings пишет во входной документ
+renderer::RenderSettings MakeRenderSettings(const Options& options)
+{
+	renderer::RenderSettings settings;
+	settings.width = options.city.map_width;
+	settings.height = options.city.map_height;
+	settings.padding = options.city.map_padding;
+	settings.line_width = 4;
+	settings.stop_radius = 3;
+	settings.bus_label_font_size = 14;
+	settings.bus_label_offset = { 7, 15 };
+	settings.stop_label_font_size = 12;
+	settings.stop_label_offset = { 7, -3 };
+	settings.underlayer_color = svg::Rgba{ 255, 255, 255, 0.85 };
+	settings.underlayer_width = 3;
+	settings.color_palette = { svg::Color("green"s), svg::Rgb{ 255, 160, 0 }, svg::Color("red"s),
+		svg::Rgba{ 120, 60, 200, 0.8 }, svg::Color("blue"s), svg::Color("brown"s), svg::Rgb{ 30, 200, 160 },
+		svg::Color("purple"s) };
+	settings.simplify_tolerance = options.simplify_tolerance;
+	settings.hide_overlapping_labels = options.hide_overlapping_labels;
+	return settings;
+}
+
+json::Dict MakeResult(const vector<double>& milliseconds, size_t bytes)
+{
+	const double median = GetMedian(milliseconds);
+	const double megabytes = static_cast<double>(bytes) / (1 << 20);
+	return json::Dict{
+		{"median_ms"s, median},
+		{"min_ms"s, *min_element(milliseconds.begin(), milliseconds.end())},
+		{"output_mb"s, megabytes},
+		{"mb_per_s"s, megabytes / (median / 1000)} };
+}
+} // namespace
+
+/*
+* Замеряет отрисовку полной карты на синтетическом городе (по умолчанию 50000 остановок
+* и 2500 автобусов): генерацию SVG через RequestHandler::RenderMap и ответ на запрос Map
+* (PrintMap — SVG с экранированием в строку JSON). Каждый повтор выполняется новым
+* RequestHandler, поэтому кэши карты и плиток не используются; вывод отбрасывается
+*/
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+		const CityGenerator city(options.city);
+		stringstream document;
+		document << "{\"base_requests\": ";
+		city.WriteBaseRequests(document);
+		document << "}";
+		TransportCatalogue tc;
+		json_reader::Reader reader(tc);
+		reader.ReadJSON(document);
+		reader.ParseRequests();
+		// Как Reader::FillValidBuses: на карте только автобусы с остановками
+		sv_set valid_buses;
+		for (const domain::Bus& bus : tc.GetBuses())
+		{
+			if (!bus.stops.empty())
+			{
+				valid_buses.insert(bus.name);
+			}
+		}
+		const renderer::MapRenderer renderer(MakeRenderSettings(options));
+
+		vector<double> svg_ms;
+		vector<double> map_ms;
+		size_t svg_bytes = 0;
+		size_t map_bytes = 0;
+		for (size_t repetition = 0; repetition < options.repetitions; ++repetition)
+		{
+			{
+				const request_handler::RequestHandler handler(tc, renderer, nullopt);
+				svg_bytes = 0;
+				svg::Writer writer([&svg_bytes](string_view svg_part)
+					{
+						svg_bytes += svg_part.size();
+					});
+				svg_ms.push_back(MeasureMilliseconds([&]
+					{
+						handler.RenderMap(valid_buses, writer);
+					}));
+			}
+			{
+				const request_handler::RequestHandler handler(tc, renderer, nullopt);
+				CountingBuffer buffer;
+				ostream output(&buffer);
+				map_ms.push_back(MeasureMilliseconds([&]
+					{
+						handler.PrintMap(valid_buses, output);
+					}));
+				map_bytes = buffer.GetSize();
+			}
+		}
+
+		json::Dict results{
+			{"benchmark"s, "render"s},
+			{"label"s, options.label},
+			{"stops"s, static_cast<int>(city.GetStopsCount())},
+			{"buses"s, static_cast<int>(valid_buses.size())},
+			{"simplify_tolerance"s, options.simplify_tolerance},
+			{"hide_overlapping_labels"s, options.hide_overlapping_labels},
+			{"repetitions"s, static_cast<int>(options.repetitions)},
+			{"render_svg"s, MakeResult(svg_ms, svg_bytes)},
+			{"print_map"s, MakeResult(map_ms, map_bytes)} };
+		const json::Document result_document{ move(results) };
+		if (options.output_path.empty())
+		{
+			json::Print(result_document, cout);
+			cout << endl;
+		}
+		else
+		{
+			ofstream output(options.output_path);
+			json::Print(result_document, output);
+			output << endl;
+		}
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,237 @@
+#include "city_generator.h"
+
+#include "json.h"
+#include "json_reader.h"
+#include "raptor_router.h"
+#include "transport_catalogue.h"
+#include "transport_router.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace std;
+using namespace transport;
+using namespace transport::bench;
+using namespace transport::router;
+
+namespace
+{
+struct Options
+{
+	CityOptions city;
+	size_t queries_count = 2000;
+	uint64_t queries_seed = 3;
+	string label;
+	string output_path;
+};
+
+Options ParseOptions(int argc, char* argv[])
+{
+	Options options;
+	options.city.stops_count = 5000;
+	options.city.buses_count = 1000;
+	options.city.max_route_stops = 50;
+	for (int i = 1; i < argc; i += 2)
+	{
+		const string_view key(argv[i]);
+		if (i + 1 >= argc)
+		{
+			throw invalid_argument("missing value for "s + string(key));
+		}
+		const string value(argv[i + 1]);
+		if (key == "--stops"sv) options.city.stops_count = stoull(value);
+		else if (key == "--buses"sv) options.city.buses_count = stoull(value);
+		else if (key == "--min-route-stops"sv) options.city.min_route_stops = stoull(value);
+		else if (key == "--max-route-stops"sv) options.city.max_route_stops = stoull(value);
+		else if (key == "--round-trip-share"sv) options.city.round_trip_share = stod(value);
+		else if (key == "--seed"sv) options.city.seed = stoull(value);
+		else if (key == "--queries"sv) options.queries_count = stoull(value);
+		else if (key == "--queries-seed"sv) options.queries_seed = stoull(value);
+		else if (key == "--label"sv) options.label = value;
+		else if (key == "--output"sv) options.output_path = value;
+		else throw invalid_argument("unknown option "s + string(key));
+	}
+	return options;
+}
+
+template <typename Function>
+double MeasureMilliseconds(Function function)
+{
+	const auto start = chrono::steady_clock::now();
+	function();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+double GetPercentile(vector<double> values, double percentile)
+{
+	if (values.empty())
+	{
+		return 0.0;
+	}
+	const size_t index = min(values.size() - 1, static_cast<size_t>(percentile * values.size()));
+	nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+// Результат движка: время построения, задержки запросов и самое быстрое время каждого маршрута
+struct EngineRun
+{
+	double build_ms = 0.0;
+	vector<double> latencies_us;
+	vector<optional<double>> total_times;
+	size_t settled_count = 0;
+};
+
+template <typename Router, typename Query>
+EngineRun RunEngine(const TransportCatalogue& tc, const RoutingSettings& settings,
+	const vector<pair<const domain::Stop*, const domain::Stop*>>& queries, Query query)
+{
+	EngineRun run;
+	unique_ptr<Router> router;
+	run.build_ms = MeasureMilliseconds([&]
+		{
+			router = make_unique<Router>(tc, settings);
+		});
+	run.latencies_us.reserve(queries.size());
+	run.total_times.reserve(queries.size());
+	for (const auto& [from, to] : queries)
+	{
+		optional<RouteResult> route;
+		run.latencies_us.push_back(MeasureMilliseconds([&]
+			{
+				route = query(*router, from, to);
+			}) * 1000.0);
+		run.total_times.push_back(route ? optional(route->total_time) : nullopt);
+		run.settled_count += route ? route->settled_count : 0;
+	}
+	return run;
+}
+
+json::Dict ToJSON(const EngineRun& run, const EngineRun& reference)
+{
+	// Движки ищут один и тот же самый быстрый маршрут, поэтому времена должны совпадать
+	size_t found_count = 0;
+	size_t mismatches_count = 0;
+	for (size_t i = 0; i < run.total_times.size(); ++i)
+	{
+		found_count += run.total_times[i].has_value();
+		const optional<double>& time = run.total_times[i];
+		const optional<double>& expected = reference.total_times[i];
+		if (time.has_value() != expected.has_value() || (time && abs(*time - *expected) > 1e-6))
+		{
+			++mismatches_count;
+		}
+	}
+	double queries_ms = 0.0;
+	for (double latency : run.latencies_us)
+	{
+		queries_ms += latency / 1000.0;
+	}
+	json::Dict result{
+		{"build_ms"s, run.build_ms},
+		{"queries_ms"s, queries_ms},
+		{"p50_us"s, GetPercentile(run.latencies_us, 0.5)},
+		{"p99_us"s, GetPercentile(run.latencies_us, 0.99)},
+		{"found"s, static_cast<int>(found_count)},
+		{"mismatches"s, static_cast<int>(mismatches_count)} };
+	// Вершины графа, извлечённые из очереди; RAPTOR их не считает
+	if (run.settled_count > 0)
+	{
+		result.emplace("settled"s, static_cast<double>(run.settled_count));
+	}
+	return result;
+}
+} // namespace
+
+/*
+* Сравнивает движки маршрутизации на одном синтетическом городе: граф с Дейкстрой, граф с A*
+* и RAPTOR получают одни и те же пары остановок в одном потоке. Для каждого движка выводятся
+* время построения, суммарное время и перцентили задержки запросов, а также число ответов,
+* время которых не совпало с графом без A* (должно быть 0)
+*/
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+		const CityGenerator city(options.city);
+		stringstream document;
+		document << "{\"base_requests\": ";
+		city.WriteBaseRequests(document);
+		document << "}";
+		TransportCatalogue tc;
+		json_reader::Reader reader(tc);
+		reader.ReadJSON(document);
+		reader.ParseRequests();
+
+		RoutingSettings settings;
+		settings.bus_wait_time = 6;
+		settings.bus_velocity = 40;
+		mt19937_64 random(options.queries_seed);
+		vector<pair<const domain::Stop*, const domain::Stop*>> queries;
+		queries.reserve(options.queries_count);
+		for (size_t i = 0; i < options.queries_count; ++i)
+		{
+			const domain::Stop* from = &tc.GetStops()[random() % tc.GetStops().size()];
+			const domain::Stop* to = &tc.GetStops()[random() % tc.GetStops().size()];
+			queries.emplace_back(from, to);
+		}
+
+		cerr << "graph..."sv << endl;
+		const EngineRun graph = RunEngine<TransportRouter>(tc, settings, queries,
+			[](const TransportRouter& router, const domain::Stop* from, const domain::Stop* to)
+			{
+				return router.BuildRoute(from, to, false);
+			});
+		cerr << "graph with A*..."sv << endl;
+		const EngineRun astar = RunEngine<TransportRouter>(tc, settings, queries,
+			[](const TransportRouter& router, const domain::Stop* from, const domain::Stop* to)
+			{
+				return router.BuildRoute(from, to, true);
+			});
+		cerr << "raptor..."sv << endl;
+		const EngineRun raptor = RunEngine<RaptorRouter>(tc, settings, queries,
+			[](const RaptorRouter& router, const domain::Stop* from, const domain::Stop* to)
+			{
+				vector<RouteResult> routes = router.BuildRoutes(from, to);
+				return routes.empty() ? nullopt : optional(move(routes.back()));
+			});
+
+		json::Dict results{
+			{"benchmark"s, "routing"s},
+			{"label"s, options.label},
+			{"stops"s, static_cast<int>(city.GetStopsCount())},
+			{"buses"s, static_cast<int>(city.GetBusesCount())},
+			{"queries"s, static_cast<int>(queries.size())},
+			{"graph"s, ToJSON(graph, graph)},
+			{"graph_astar"s, ToJSON(astar, graph)},
+			{"raptor"s, ToJSON(raptor, graph)} };
+		const json::Document result_document{ move(results) };
+		if (options.output_path.empty())
+		{
+			json::Print(result_document, cout);
+			cout << endl;
+		}
+		else
+		{
+			ofstream output(options.output_path);
+			json::Print(result_document, output);
+			output << endl;
+		}
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
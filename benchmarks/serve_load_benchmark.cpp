@@ -0,0 +1,452 @@
+#include "city_generator.h"
+
+#include "json.h"
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+extern char** environ;
+
+using namespace std;
+using namespace transport::bench;
+
+namespace
+{
+struct BenchmarkOptions
+{
+	// Путь к собранной программе transport_catalogue
+	string binary_path;
+	CityOptions city;
+	RequestMix mix;
+	vector<size_t> clients = { 1, 16, 64 };
+	int threads = 4;
+	string workdir = "."s;
+	string label;
+	string output_path;
+	bool keep_files = false;
+};
+
+vector<size_t> ParseList(const string& value)
+{
+	vector<size_t> list;
+	size_t start = 0;
+	while (start < value.size())
+	{
+		size_t end = value.find(',', start);
+		if (end == string::npos)
+		{
+			end = value.size();
+		}
+		list.push_back(stoull(value.substr(start, end - start)));
+		start = end + 1;
+	}
+	return list;
+}
+
+BenchmarkOptions ParseOptions(int argc, char* argv[])
+{
+	BenchmarkOptions options;
+	options.city.stops_count = 10000;
+	options.city.buses_count = 1000;
+	options.mix.requests_count = 20000;
+	for (int i = 1; i < argc; ++i)
+	{
+		const string_view key(argv[i]);
+		if (key == "--keep-files"sv)
+		{
+			options.keep_files = true;
+			continue;
+		}
+		if (i + 1 >= argc)
+		{
+			throw invalid_argument("missing value for "s + string(key));
+		}
+		const string value(argv[++i]);
+		if (key == "--binary"sv) options.binary_path = value;
+		else if (key == "--stops"sv) options.city.stops_count = stoull(value);
+		else if (key == "--buses"sv) options.city.buses_count = stoull(value);
+		else if (key == "--seed"sv) options.city.seed = stoull(value);
+		else if (key == "--requests"sv) options.mix.requests_count = stoull(value);
+		else if (key == "--stop-share"sv) options.mix.stop_share = stod(value);
+		else if (key == "--bus-share"sv) options.mix.bus_share = stod(value);
+		else if (key == "--map-share"sv) options.mix.map_share = stod(value);
+		else if (key == "--route-share"sv) options.mix.route_share = stod(value);
+		else if (key == "--missing-share"sv) options.mix.missing_share = stod(value);
+		else if (key == "--requests-seed"sv) options.mix.seed = stoull(value);
+		else if (key == "--clients"sv) options.clients = ParseList(value);
+		else if (key == "--threads"sv) options.threads = stoi(value);
+		else if (key == "--workdir"sv) options.workdir = value;
+		else if (key == "--label"sv) options.label = value;
+		else if (key == "--output"sv) options.output_path = value;
+		else throw invalid_argument("unknown option "s + string(key));
+	}
+	if (options.binary_path.empty())
+	{
+		throw invalid_argument("--binary is required"s);
+	}
+	return options;
+}
+
+template <typename Function>
+double MeasureMilliseconds(Function function)
+{
+	const auto start = chrono::steady_clock::now();
+	function();
+	return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+double GetPercentile(vector<double> values, double percentile)
+{
+	if (values.empty())
+	{
+		return 0.0;
+	}
+	const size_t index = min(values.size() - 1, static_cast<size_t>(percentile * values.size()));
+	nth_element(values.begin(), values.begin() + index, values.end());
+	return values[index];
+}
+
+// Запускает программу; при непустом input_path её stdin читается из файла
+pid_t Spawn(const vector<string>& arguments, const string& input_path)
+{
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	if (!input_path.empty())
+	{
+		posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, input_path.c_str(), O_RDONLY, 0);
+	}
+	vector<char*> argv;
+	for (const string& argument : arguments)
+	{
+		argv.push_back(const_cast<char*>(argument.c_str()));
+	}
+	argv.push_back(nullptr);
+	pid_t pid = 0;
+	const int error = posix_spawn(&pid, arguments[0].c_str(), &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (error != 0)
+	{
+		throw runtime_error("failed to start "s + arguments[0] + ": "s + strerror(error));
+	}
+	return pid;
+}
+
+void WaitSuccess(pid_t pid, const string& what)
+{
+	int status = 0;
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		throw runtime_error(what + " failed"s);
+	}
+}
+
+// Пиковый RSS процесса из /proc/<pid>/status
+double GetPeakRssMegabytes(pid_t pid)
+{
+	ifstream status("/proc/"s + to_string(pid) + "/status"s);
+	for (string line; getline(status, line);)
+	{
+		if (line.rfind("VmHWM:"s, 0) == 0)
+		{
+			return stod(line.substr(line.find_first_of("0123456789"s))) / 1024.0;
+		}
+	}
+	return 0.0;
+}
+
+int TryConnect(const string& socket_path)
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (socket_path.size() >= sizeof(address.sun_path))
+	{
+		throw invalid_argument("socket path is too long: "s + socket_path);
+	}
+	strcpy(address.sun_path, socket_path.c_str());
+	int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if (fd < 0)
+	{
+		throw runtime_error("socket: "s + strerror(errno));
+	}
+	if (connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+// Ждёт, пока сервер загрузит базу и начнёт принимать соединения
+void WaitForServer(pid_t pid, const string& socket_path)
+{
+	for (;;)
+	{
+		int fd = TryConnect(socket_path);
+		if (fd >= 0)
+		{
+			close(fd);
+			return;
+		}
+		int status = 0;
+		if (waitpid(pid, &status, WNOHANG) == pid)
+		{
+			throw runtime_error("server exited before accepting connections"s);
+		}
+		this_thread::sleep_for(chrono::milliseconds(20));
+	}
+}
+
+// Запросы генератора по одному в строке: json::Print выводит их с отступами,
+// а переводы строк внутри строковых значений экранируются
+vector<string> MakeRequestLines(const CityGenerator& city, const RequestMix& mix)
+{
+	stringstream stat_requests;
+	city.WriteStatRequests(mix, stat_requests);
+	const json::Document requests = json::Load(stat_requests);
+	vector<string> lines;
+	for (const json::Node& request : requests.GetRoot().AsArray())
+	{
+		ostringstream printed;
+		json::Print(json::Document{ request }, printed);
+		string line;
+		for (char c : printed.str())
+		{
+			if (c != '\n')
+			{
+				line += c;
+			}
+		}
+		lines.push_back(move(line));
+	}
+	return lines;
+}
+
+// Ответ на запрос с номером id: "request_id", за которым не следует другая цифра
+bool IsResponseTo(const string& response, size_t id)
+{
+	const string key = "\"request_id\": "s + to_string(id);
+	const size_t position = response.find(key);
+	return position != string::npos && (position + key.size() == response.size()
+		|| !isdigit(static_cast<unsigned char>(response[position + key.size()])));
+}
+
+// Закрытый цикл одного клиента: следующий запрос отправляется после ответа на предыдущий
+vector<double> RunClient(const string& socket_path, const vector<string>& lines, size_t first, size_t step)
+{
+	int fd = TryConnect(socket_path);
+	if (fd < 0)
+	{
+		throw runtime_error("failed to connect to "s + socket_path);
+	}
+	vector<double> latencies_us;
+	string buffer;
+	char chunk[1 << 16];
+	for (size_t id = first; id < lines.size(); id += step)
+	{
+		const string request = lines[id] + '\n';
+		const auto start = chrono::steady_clock::now();
+		for (size_t sent = 0; sent < request.size();)
+		{
+			const ssize_t result = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+			if (result < 0)
+			{
+				close(fd);
+				throw runtime_error("send: "s + strerror(errno));
+			}
+			sent += result;
+		}
+		size_t line_end;
+		while ((line_end = buffer.find('\n')) == string::npos)
+		{
+			const ssize_t result = recv(fd, chunk, sizeof(chunk), 0);
+			if (result <= 0)
+			{
+				close(fd);
+				throw runtime_error("connection closed by server"s);
+			}
+			buffer.append(chunk, result);
+		}
+		latencies_us.push_back(chrono::duration<double, micro>(chrono::steady_clock::now() - start).count());
+		if (!IsResponseTo(buffer.substr(0, line_end), id))
+		{
+			close(fd);
+			throw runtime_error("unexpected response to request "s + to_string(id));
+		}
+		buffer.erase(0, line_end + 1);
+	}
+	close(fd);
+	return latencies_us;
+}
+
+json::Dict RunClients(const string& socket_path, const vector<string>& lines, size_t clients_count)
+{
+	vector<vector<double>> latencies(clients_count);
+	vector<string> errors(clients_count);
+	const double elapsed_ms = MeasureMilliseconds([&]
+		{
+			vector<thread> clients;
+			for (size_t client = 0; client < clients_count; ++client)
+			{
+				clients.emplace_back([&, client]
+					{
+						try
+						{
+							latencies[client] = RunClient(socket_path, lines, client, clients_count);
+						}
+						catch (const exception& e)
+						{
+							errors[client] = e.what();
+						}
+					});
+			}
+			for (thread& client : clients)
+			{
+				client.join();
+			}
+		});
+	vector<double> all_latencies;
+	for (size_t client = 0; client < clients_count; ++client)
+	{
+		if (!errors[client].empty())
+		{
+			throw runtime_error(errors[client]);
+		}
+		all_latencies.insert(all_latencies.end(), latencies[client].begin(), latencies[client].end());
+	}
+	return json::Dict{
+		{"clients"s, static_cast<int>(clients_count)},
+		{"requests"s, static_cast<int>(all_latencies.size())},
+		{"elapsed_ms"s, elapsed_ms},
+		{"throughput_rps"s, all_latencies.size() / (elapsed_ms / 1000.0)},
+		{"p50_us"s, GetPercentile(all_latencies, 0.5)},
+		{"p99_us"s, GetPercentile(all_latencies, 0.99)},
+		{"p999_us"s, GetPercentile(all_latencies, 0.999)} };
+}
+
+json::Dict RunBenchmark(const BenchmarkOptions& options)
+{
+	const string make_base_path = options.workdir + "/serve_make_base.json"s;
+	const string base_path = options.workdir + "/serve_base.db"s;
+	const string config_path = options.workdir + "/serve_config.json"s;
+	const string socket_path = options.workdir + "/serve.sock"s;
+
+	const CityGenerator city(options.city);
+	{
+		ofstream make_base(make_base_path);
+		make_base << "{\"serialization_settings\": {\"file\": \"" << base_path << "\"},\n\"base_requests\": ";
+		city.WriteBaseRequests(make_base);
+		make_base << ",\n\"render_settings\": ";
+		city.WriteRenderSettings(make_base);
+		make_base << ",\n\"routing_settings\": ";
+		city.WriteRoutingSettings(make_base);
+		make_base << "}\n";
+		ofstream config(config_path);
+		config << "{\"serialization_settings\": {\"file\": \"" << base_path << "\"}, \"server_settings\": {\"socket\": \""
+			<< socket_path << "\"}, \"execution_settings\": {\"threads\": " << options.threads << "}}\n";
+		if (!make_base || !config)
+		{
+			throw runtime_error("failed to write files to "s + options.workdir);
+		}
+	}
+	const double make_base_ms = MeasureMilliseconds([&]
+		{
+			WaitSuccess(Spawn({ options.binary_path, "make_base"s }, make_base_path), "make_base"s);
+		});
+	const vector<string> lines = MakeRequestLines(city, options.mix);
+
+	const pid_t server = Spawn({ options.binary_path, "serve"s, config_path }, ""s);
+	json::Array runs;
+	double startup_ms = 0.0;
+	double peak_rss_mb = 0.0;
+	try
+	{
+		startup_ms = MeasureMilliseconds([&]
+			{
+				WaitForServer(server, socket_path);
+			});
+		for (size_t clients_count : options.clients)
+		{
+			cerr << "clients: "sv << clients_count << "..."sv << endl;
+			runs.emplace_back(RunClients(socket_path, lines, clients_count));
+		}
+		peak_rss_mb = GetPeakRssMegabytes(server);
+	}
+	catch (...)
+	{
+		kill(server, SIGKILL);
+		waitpid(server, nullptr, 0);
+		throw;
+	}
+	kill(server, SIGTERM);
+	WaitSuccess(server, "serve"s);
+
+	if (!options.keep_files)
+	{
+		remove(make_base_path.c_str());
+		remove(base_path.c_str());
+		remove(config_path.c_str());
+	}
+	return json::Dict{
+		{"benchmark"s, "serve_load"s},
+		{"label"s, options.label},
+		{"stops"s, static_cast<int>(city.GetStopsCount())},
+		{"buses"s, static_cast<int>(city.GetBusesCount())},
+		{"threads"s, options.threads},
+		{"make_base_ms"s, make_base_ms},
+		{"startup_ms"s, startup_ms},
+		{"server_peak_rss_mb"s, peak_rss_mb},
+		{"runs"s, move(runs)} };
+}
+} // namespace
+
+/*
+* Нагрузочный бенчмарк режима serve: генерирует город, сохраняет базу через make_base,
+* запускает transport_catalogue serve на Unix-сокете и для каждого числа клиентов из --clients
+* отправляет одни и те же --requests запросов генератора в закрытом цикле (каждый клиент ждёт
+* ответа перед следующим запросом). Выводятся пропускная способность и задержки p50/p99/p99.9
+*/
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const BenchmarkOptions options = ParseOptions(argc, argv);
+		const json::Document document{ RunBenchmark(options) };
+		if (options.output_path.empty())
+		{
+			json::Print(document, cout);
+			cout << endl;
+		}
+		else
+		{
+			ofstream output(options.output_path);
+			json::Print(document, output);
+			output << endl;
+		}
+	}
+	catch (const exception& e)
+	{
+		cerr << e.what() << '\n';
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,153 @@
+#include "city_generator.h"
+
+#include "json_reader.h"
+#include "transport_catalogue.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace transport;
+using namespace transport::bench;
+
+namespace
+{
+const size_t PARALLEL_THREADS_COUNT = 4;
+
+void Check(bool condition, const string& message)
+{
+	if (!condition)
+	{
+		throw logic_error(message);
+	}
+}
+
+string GetStopName(size_t stop)
+{
+	return "Stop "s + to_string(stop);
+}
+
+// stat_requests генератора, дополненные запросами, которых он не пишет: Matrix, Isochrone, MapTile,
+// повторами Stop, Bus и Map и запросами к отсутствующим остановкам
+string MakeStatRequests(const CityGenerator& city, const RequestMix& mix)
+{
+	ostringstream generated;
+	city.WriteStatRequests(mix, generated);
+	string stat_requests = generated.str();
+	stat_requests.resize(stat_requests.rfind(']'));
+
+	ostringstream extra;
+	int id = static_cast<int>(mix.requests_count);
+	const size_t stops_count = city.GetStopsCount();
+	for (size_t i = 0; i < 8; ++i)
+	{
+		const size_t stop = i * stops_count / 8;
+		extra << ",\n{\"id\": " << id++ << ", \"type\": \"Matrix\", \"from\": [\"" << GetStopName(stop)
+			<< "\", \"" << GetStopName(stops_count - 1 - stop) << "\"], \"to\": [\"" << GetStopName(stop / 2)
+			<< "\", \"" << GetStopName((stop + stops_count / 3) % stops_count) << "\", \""
+			<< GetStopName(stops_count / 2) << "\"]}";
+		extra << ",\n{\"id\": " << id++ << ", \"type\": \"Isochrone\", \"from\": \"" << GetStopName(stop)
+			<< "\", \"max_time\": " << 10 + 5 * i << '}';
+		extra << ",\n{\"id\": " << id++ << ", \"type\": \"MapTile\", \"zoom\": " << i % 3 << ", \"x\": " << i % 2
+			<< ", \"y\": " << i / 4 << '}';
+		extra << ",\n{\"id\": " << id++ << ", \"type\": \"Stop\", \"name\": \"" << GetStopName(stop) << "\"}";
+		extra << ",\n{\"id\": " << id++ << ", \"type\": \"Bus\", \"name\": \"Bus " << i << "\"}";
+	}
+	extra << ",\n{\"id\": " << id++ << ", \"type\": \"Map\"}";
+	extra << ",\n{\"id\": " << id++ << ", \"type\": \"Matrix\", \"from\": [\"Missing stop\"], \"to\": [\""
+		<< GetStopName(0) << "\"]}";
+	extra << ",\n{\"id\": " << id++ << ", \"type\": \"Isochrone\", \"from\": \"Missing stop\", \"max_time\": 30}";
+	extra << ",\n{\"id\": " << id++ << ", \"type\": \"Route\", \"from\": \"" << GetStopName(0)
+		<< "\", \"to\": \"Missing stop\"}";
+	// Повтор всех добавленных запросов: вторые ответы должны совпасть с первыми при любом числе потоков
+	const string extra_requests = extra.str();
+	stat_requests += extra_requests;
+	stat_requests += extra_requests;
+	return stat_requests + "\n]"s;
+}
+
+// Документ с execution_settings в начале и stat_requests в конце, как требует режим pipeline
+string MakeDocument(const CityGenerator& city, const string& execution_settings, const string& stat_requests)
+{
+	ostringstream document;
+	document << "{\"execution_settings\": " << execution_settings << ",\n\"base_requests\": ";
+	city.WriteBaseRequests(document);
+	document << ",\n\"render_settings\": ";
+	city.WriteRenderSettings(document);
+	document << ",\n\"routing_settings\": ";
+	city.WriteRoutingSettings(document);
+	document << ",\n\"stat_requests\": " << stat_requests << "}\n";
+	return document.str();
+}
+
+string Execute(const string& document, bool can_stream_stat_requests)
+{
+	TransportCatalogue tc;
+	json_reader::Reader reader(tc);
+	istringstream input(document);
+	reader.ReadJSON(input, can_stream_stat_requests);
+	reader.ParseRequests();
+	ostringstream output;
+	reader.GetResponses(output);
+	return output.str();
+}
+
+void CheckSameOutput(const CityGenerator& city, const string& stat_requests)
+{
+	const string expected = Execute(MakeDocument(city, "{\"threads\": 1}"s, stat_requests), false);
+	Check(expected.find("\"request_id\"") != string::npos, "serial output has no responses"s);
+
+	const string threads = to_string(PARALLEL_THREADS_COUNT);
+	const vector<string> execution_settings{
+		"{\"threads\": "s + threads + "}"s,
+		"{\"threads\": "s + threads + ", \"precompute_responses\": true}"s,
+		"{\"threads\": "s + threads + ", \"precompute_responses\": false}"s,
+		"{\"threads\": "s + threads + ", \"deduplicate_requests\": false}"s,
+		"{\"threads\": "s + threads + ", \"cache_map\": false}"s,
+		"{\"threads\": "s + threads + ", \"pipeline\": true}"s,
+		"{\"threads\": 1, \"pipeline\": true}"s };
+	for (const string& settings : execution_settings)
+	{
+		for (int run = 0; run < 3; ++run)
+		{
+			const string actual = Execute(MakeDocument(city, settings, stat_requests), true);
+			Check(actual == expected, "output with execution_settings "s + settings + " differs from threads=1"s);
+		}
+	}
+}
+} // namespace
+
+/*
+* Выполняет один и тот же пакет stat-запросов всех типов с детерминированным ответом
+* (без Stats и Memory) последовательно и на пуле потоков, с конвейером, предвычислением ответов,
+* дедупликацией и кэшем карты и без них, и сравнивает выводы побайтно.
+* Каждая параллельная конфигурация запускается несколько раз. Код возврата 0 — все выводы совпали
+*/
+int main()
+{
+	try
+	{
+		CityOptions options;
+		options.stops_count = 1500;
+		options.buses_count = 150;
+		options.max_route_stops = 30;
+		const CityGenerator city(options);
+		RequestMix mix;
+		mix.requests_count = 1500;
+		mix.stop_share = 0.4;
+		mix.bus_share = 0.4;
+		mix.map_share = 0.005;
+		mix.route_share = 0.2;
+		CheckSameOutput(city, MakeStatRequests(city, mix));
+	}
+	catch (const exception& e)
+	{
+		cerr << "FAILED: "sv << e.what() << '\n';
+		return 1;
+	}
+	cerr << "OK\n"sv;
+	return 0;
+}
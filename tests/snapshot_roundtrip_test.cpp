@@ -0,0 +1,150 @@
+#include "city_generator.h"
+
+#include "compressed_snapshot.h"
+#include "json_reader.h"
+#include "serialization.h"
+#include "transport_catalogue.h"
+
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+using namespace transport;
+using namespace transport::bench;
+using namespace transport::serialization;
+
+namespace
+{
+void Check(bool condition, const string& message)
+{
+	if (!condition)
+	{
+		throw logic_error(message);
+	}
+}
+
+bool operator==(const domain::RouteInfo& lhs, const domain::RouteInfo& rhs)
+{
+	return lhs.n_stops == rhs.n_stops && lhs.n_unique_stops == rhs.n_unique_stops
+		&& lhs.real_length == rhs.real_length && lhs.curvature == rhs.curvature;
+}
+
+vector<string_view> GetBusNames(const TransportCatalogue& tc, const domain::Stop* stop)
+{
+	const sv_set* buses = tc.GetStopToBuses(stop);
+	return buses ? vector<string_view>(buses->begin(), buses->end()) : vector<string_view>{};
+}
+
+// Каталог из снимка отвечает на Stop и Bus так же, как исходный: RouteInfo совпадает побитово,
+// потому что сжатый формат либо квантует координаты без потерь, либо хранит их как есть
+void CheckSameAnswers(const TransportCatalogue& expected, const TransportCatalogue& actual, const string& format)
+{
+	Check(actual.GetStops().size() == expected.GetStops().size(), format + ": stops count differs"s);
+	Check(actual.GetBuses().size() == expected.GetBuses().size(), format + ": buses count differs"s);
+	Check(actual.GetDistances().size() == expected.GetDistances().size(), format + ": distances count differs"s);
+	for (const domain::Bus& bus : expected.GetBuses())
+	{
+		const domain::Bus* loaded = actual.SearchBus(bus.name);
+		Check(loaded, format + ": bus "s + bus.name + " is missing"s);
+		Check(actual.GetRouteInfo(loaded) == expected.GetRouteInfo(&bus),
+			format + ": RouteInfo of bus "s + bus.name + " differs"s);
+	}
+	for (const domain::Stop& stop : expected.GetStops())
+	{
+		const domain::Stop* loaded = actual.SearchStop(stop.name);
+		Check(loaded, format + ": stop "s + stop.name + " is missing"s);
+		Check(loaded->coordinates == stop.coordinates, format + ": coordinates of stop "s + stop.name + " differ"s);
+		Check(GetBusNames(actual, loaded) == GetBusNames(expected, &stop),
+			format + ": buses of stop "s + stop.name + " differ"s);
+	}
+}
+
+void CheckSameSettings(const SnapshotSettings& expected, const SnapshotSettings& actual, const string& format)
+{
+	Check(renderer::MapRenderer(actual.render_settings).GetSettingsHash()
+		== renderer::MapRenderer(expected.render_settings).GetSettingsHash(), format + ": render settings differ"s);
+	Check(actual.routing_settings.has_value() == expected.routing_settings.has_value(),
+		format + ": routing settings differ"s);
+	if (expected.routing_settings)
+	{
+		Check(actual.routing_settings->bus_wait_time == expected.routing_settings->bus_wait_time
+			&& actual.routing_settings->bus_velocity == expected.routing_settings->bus_velocity,
+			format + ": routing settings differ"s);
+	}
+}
+
+void CheckRoundTrip(const CityOptions& options, bool has_raw_coordinates)
+{
+	const CityGenerator city(options);
+	stringstream document;
+	document << "{\"base_requests\": ";
+	city.WriteBaseRequests(document);
+	document << "}";
+	TransportCatalogue tc;
+	json_reader::Reader reader(tc);
+	reader.ReadJSON(document);
+	reader.ParseRequests();
+	// Координата, которая не квантуется с шагом 1e-7 без потерь, переводит сжатый снимок на запись как есть
+	if (has_raw_coordinates)
+	{
+		tc.AddStop("Raw coordinates stop"s, { 55.123456789123, 37.987654321987 });
+	}
+
+	SnapshotSettings settings;
+	settings.render_settings.width = options.map_width;
+	settings.render_settings.height = options.map_height;
+	settings.render_settings.underlayer_color = svg::Rgba{ 255, 255, 255, 0.85 };
+	settings.render_settings.color_palette = { svg::Color("green"s), svg::Rgb{ 255, 160, 0 }, svg::Rgba{ 1, 2, 3, 0.5 } };
+	settings.render_settings.simplify_tolerance = 0.5;
+	settings.routing_settings = router::RoutingSettings{};
+	settings.routing_settings->bus_wait_time = 6;
+	settings.routing_settings->bus_velocity = 40;
+
+	stringstream binary;
+	SaveCatalogue(tc, settings, binary);
+	TransportCatalogue binary_tc;
+	CheckSameSettings(settings, LoadCatalogue(binary, binary_tc), "binary"s);
+	CheckSameAnswers(tc, binary_tc, "binary"s);
+
+	stringstream compressed;
+	SaveCompressedCatalogue(tc, settings, compressed);
+	TransportCatalogue compressed_tc;
+	CheckSameSettings(settings, LoadCompressedCatalogue(compressed, compressed_tc), "compressed"s);
+	CheckSameAnswers(tc, compressed_tc, "compressed"s);
+	// Оба формата загружены из одной базы и должны давать одни и те же ответы
+	CheckSameAnswers(binary_tc, compressed_tc, "compressed against binary"s);
+}
+} // namespace
+
+/*
+* Сохраняет синтетический город в двоичный и сжатый снимки, загружает оба и сравнивает
+* RouteInfo каждого автобуса и список автобусов каждой остановки с исходным каталогом и между собой.
+* Проверяются координаты, квантуемые без потерь, и запись координат как есть.
+* Код возврата 0 — все проверки прошли
+*/
+int main()
+{
+	try
+	{
+		CityOptions options;
+		options.stops_count = 3000;
+		options.buses_count = 300;
+		CheckRoundTrip(options, false);
+		CheckRoundTrip(options, true);
+		options.stops_count = 200;
+		options.buses_count = 40;
+		options.round_trip_share = 0.0;
+		options.seed = 7;
+		CheckRoundTrip(options, false);
+	}
+	catch (const exception& e)
+	{
+		cerr << "FAILED: "sv << e.what() << '\n';
+		return 1;
+	}
+	cerr << "OK\n"sv;
+	return 0;
+}
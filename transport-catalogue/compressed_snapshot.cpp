@@ -0,0 +1,532 @@
+#include "compressed_snapshot.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+using namespace transport;
+using namespace transport::serialization;
+using namespace domain;
+
+namespace
+{
+const char COMPRESSED_MAGIC[4] = { 'T', 'C', 'C', 'Z' };
+const uint32_t COMPRESSED_VERSION = 2;
+const size_t STREAM_BUFFER_SIZE = 1 << 16;
+// Числа элементов и длины читаются из файла, поэтому память выделяется не больше
+// чем на столько элементов вперёд: повреждённый снимок заканчивается раньше
+const uint64_t MAX_RESERVED_COUNT = 1 << 16;
+
+// Шаг квантования координат: 1e-7 градуса — около сантиметра
+const double COORDINATE_SCALE = 1e7;
+
+enum class CoordinateEncoding : uint8_t
+{
+	FIXED_POINT,
+	RAW
+};
+
+// Флаги маршрута
+const uint64_t BUS_IS_ROUND = 1;
+const uint64_t BUS_IS_MIRRORED = 2;
+
+uint64_t ZigZagEncode(int64_t value)
+{
+	return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t ZigZagDecode(uint64_t value)
+{
+	return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+class StreamWriter
+{
+public:
+	explicit StreamWriter(ostream& output)
+		: output_(output)
+	{
+		buffer_.reserve(STREAM_BUFFER_SIZE);
+	}
+
+	~StreamWriter()
+	{
+		Flush();
+	}
+
+	void WriteVarint(uint64_t value)
+	{
+		while (value >= 0x80)
+		{
+			buffer_.push_back(static_cast<char>(value | 0x80));
+			value >>= 7;
+		}
+		buffer_.push_back(static_cast<char>(value));
+		FlushIfFull();
+	}
+
+	void WriteSigned(int64_t value)
+	{
+		WriteVarint(ZigZagEncode(value));
+	}
+
+	void WriteBytes(const char* data, size_t size)
+	{
+		buffer_.insert(buffer_.end(), data, data + size);
+		FlushIfFull();
+	}
+
+	void WriteDouble(double value)
+	{
+		WriteBytes(reinterpret_cast<const char*>(&value), sizeof(value));
+	}
+
+	void Flush()
+	{
+		output_.write(buffer_.data(), buffer_.size());
+		buffer_.clear();
+	}
+
+private:
+	void FlushIfFull()
+	{
+		if (buffer_.size() >= STREAM_BUFFER_SIZE)
+		{
+			Flush();
+		}
+	}
+
+	ostream& output_;
+	vector<char> buffer_;
+};
+
+// Читает поток блоками фиксированного размера
+class StreamReader
+{
+public:
+	explicit StreamReader(istream& input)
+		: input_(input), buffer_(STREAM_BUFFER_SIZE)
+	{
+	}
+
+	uint64_t ReadVarint()
+	{
+		uint64_t value = 0;
+		for (int shift = 0; shift < 64; shift += 7)
+		{
+			uint8_t byte = ReadByte();
+			value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+			if (!(byte & 0x80))
+			{
+				return value;
+			}
+		}
+		throw SerializationError("malformed varint in compressed snapshot"s);
+	}
+
+	int64_t ReadSigned()
+	{
+		return ZigZagDecode(ReadVarint());
+	}
+
+	// Дописывает size байт к str, увеличивая строку по мере чтения
+	void AppendBytes(string& str, uint64_t size)
+	{
+		while (size > 0)
+		{
+			const size_t offset = str.size();
+			const size_t chunk = min(size, MAX_RESERVED_COUNT);
+			str.resize(offset + chunk);
+			ReadBytes(str.data() + offset, chunk);
+			size -= chunk;
+		}
+	}
+
+	void ReadBytes(char* data, size_t size)
+	{
+		while (size > 0)
+		{
+			if (position_ == end_)
+			{
+				Refill();
+			}
+			size_t chunk = min(size, end_ - position_);
+			memcpy(data, buffer_.data() + position_, chunk);
+			position_ += chunk;
+			data += chunk;
+			size -= chunk;
+		}
+	}
+
+	double ReadDouble()
+	{
+		double value;
+		ReadBytes(reinterpret_cast<char*>(&value), sizeof(value));
+		return value;
+	}
+
+private:
+	uint8_t ReadByte()
+	{
+		if (position_ == end_)
+		{
+			Refill();
+		}
+		return static_cast<uint8_t>(buffer_[position_++]);
+	}
+
+	void Refill()
+	{
+		input_.read(buffer_.data(), buffer_.size());
+		position_ = 0;
+		end_ = input_.gcount();
+		if (end_ == 0)
+		{
+			throw SerializationError("unexpected end of snapshot"s);
+		}
+	}
+
+	istream& input_;
+	vector<char> buffer_;
+	size_t position_ = 0;
+	size_t end_ = 0;
+};
+
+// Слова имени; соединение их через пробел в точности восстанавливает имя
+vector<string_view> SplitName(string_view name)
+{
+	vector<string_view> words;
+	while (true)
+	{
+		size_t space = name.find(' ');
+		words.push_back(name.substr(0, space));
+		if (space == string_view::npos)
+		{
+			return words;
+		}
+		name.remove_prefix(space + 1);
+	}
+}
+
+class NameDictionary
+{
+public:
+	void AddName(string_view name)
+	{
+		for (string_view word : SplitName(name))
+		{
+			word_ids_.emplace(word, 0);
+		}
+	}
+
+	// Слова в порядке сортировки с общим с предыдущим словом префиксом
+	void Write(StreamWriter& writer)
+	{
+		vector<string_view> words;
+		words.reserve(word_ids_.size());
+		for (const auto& [word, id] : word_ids_)
+		{
+			words.push_back(word);
+		}
+		sort(words.begin(), words.end());
+
+		writer.WriteVarint(words.size());
+		string_view previous;
+		for (size_t id = 0; id < words.size(); ++id)
+		{
+			string_view word = words[id];
+			word_ids_[word] = id;
+			size_t prefix = 0;
+			while (prefix < previous.size() && prefix < word.size() && previous[prefix] == word[prefix])
+			{
+				++prefix;
+			}
+			writer.WriteVarint(prefix);
+			writer.WriteVarint(word.size() - prefix);
+			writer.WriteBytes(word.data() + prefix, word.size() - prefix);
+			previous = word;
+		}
+	}
+
+	void WriteName(StreamWriter& writer, string_view name) const
+	{
+		vector<string_view> words = SplitName(name);
+		writer.WriteVarint(words.size());
+		for (string_view word : words)
+		{
+			writer.WriteVarint(word_ids_.at(word));
+		}
+	}
+
+private:
+	unordered_map<string_view, uint64_t> word_ids_;
+};
+
+vector<string> ReadDictionary(StreamReader& reader)
+{
+	const uint64_t words_count = reader.ReadVarint();
+	vector<string> words;
+	words.reserve(min(words_count, MAX_RESERVED_COUNT));
+	for (uint64_t id = 0; id < words_count; ++id)
+	{
+		uint64_t prefix = reader.ReadVarint();
+		uint64_t suffix = reader.ReadVarint();
+		if (id == 0 ? prefix != 0 : prefix > words.back().size())
+		{
+			throw SerializationError("malformed dictionary in compressed snapshot"s);
+		}
+		string word = id == 0 ? string() : words.back().substr(0, prefix);
+		reader.AppendBytes(word, suffix);
+		words.push_back(move(word));
+	}
+	return words;
+}
+
+string ReadName(StreamReader& reader, const vector<string>& words)
+{
+	string name;
+	uint64_t words_count = reader.ReadVarint();
+	for (uint64_t i = 0; i < words_count; ++i)
+	{
+		uint64_t id = reader.ReadVarint();
+		if (id >= words.size())
+		{
+			throw SerializationError("word index is out of range"s);
+		}
+		if (i > 0)
+		{
+			name += ' ';
+		}
+		name += words[id];
+	}
+	return name;
+}
+
+int64_t Quantize(double coordinate)
+{
+	return llround(coordinate * COORDINATE_SCALE);
+}
+
+// Деление, а не умножение на 1e-7: так восстанавливается ближайшее к десятичной записи число
+double Dequantize(int64_t value)
+{
+	return value / COORDINATE_SCALE;
+}
+
+bool IsQuantizationExact(const deque<Stop>& stops)
+{
+	return all_of(stops.begin(), stops.end(), [](const Stop& stop)
+		{
+			const auto [lat, lng] = stop.coordinates;
+			return abs(lat) <= 180.0 && abs(lng) <= 180.0
+				&& Dequantize(Quantize(lat)) == lat && Dequantize(Quantize(lng)) == lng;
+		});
+}
+
+// Маршрут, который читается одинаково в обе стороны, хранится первой половиной
+bool IsMirrored(const vector<const Stop*>& stops)
+{
+	return stops.size() >= 3 && stops.size() % 2 == 1 && equal(stops.begin(), stops.begin() + stops.size() / 2, stops.rbegin());
+}
+} // namespace
+
+void transport::serialization::SaveCompressedCatalogue(const TransportCatalogue& tc, const SnapshotSettings& settings,
+	ostream& output)
+{
+	output.write(COMPRESSED_MAGIC, sizeof(COMPRESSED_MAGIC));
+	output.write(reinterpret_cast<const char*>(&COMPRESSED_VERSION), sizeof(COMPRESSED_VERSION));
+	// Настройки идут перед сжатыми данными, чтобы читатель разобрал их прямо из потока
+	SaveSettings(settings, output);
+
+	const deque<Stop>& stops = tc.GetStops();
+	const deque<Bus>& buses = tc.GetBuses();
+	unordered_map<const Stop*, int64_t> stop_to_index;
+	NameDictionary dictionary;
+	for (const Stop& stop : stops)
+	{
+		stop_to_index.emplace(&stop, stop_to_index.size());
+		dictionary.AddName(stop.name);
+	}
+	for (const Bus& bus : buses)
+	{
+		dictionary.AddName(bus.name);
+	}
+
+	StreamWriter writer(output);
+	dictionary.Write(writer);
+
+	const CoordinateEncoding encoding = IsQuantizationExact(stops) ? CoordinateEncoding::FIXED_POINT : CoordinateEncoding::RAW;
+	writer.WriteVarint(stops.size());
+	writer.WriteVarint(static_cast<uint8_t>(encoding));
+	int64_t previous_lat = 0;
+	int64_t previous_lng = 0;
+	for (const Stop& stop : stops)
+	{
+		dictionary.WriteName(writer, stop.name);
+		if (encoding == CoordinateEncoding::FIXED_POINT)
+		{
+			int64_t lat = Quantize(stop.coordinates.lat);
+			int64_t lng = Quantize(stop.coordinates.lng);
+			writer.WriteSigned(lat - previous_lat);
+			writer.WriteSigned(lng - previous_lng);
+			previous_lat = lat;
+			previous_lng = lng;
+		}
+		else
+		{
+			writer.WriteDouble(stop.coordinates.lat);
+			writer.WriteDouble(stop.coordinates.lng);
+		}
+	}
+
+	// Расстояния сгруппированы по начальной остановке и упорядочены по конечной
+	vector<vector<pair<int64_t, int>>> distances(stops.size());
+	for (const auto& [stop_pair, distance] : tc.GetDistances())
+	{
+		distances[stop_to_index.at(stop_pair.first)].emplace_back(stop_to_index.at(stop_pair.second), distance);
+	}
+	for (size_t from = 0; from < distances.size(); ++from)
+	{
+		sort(distances[from].begin(), distances[from].end());
+		writer.WriteVarint(distances[from].size());
+		int64_t previous_to = from;
+		for (const auto& [to, distance] : distances[from])
+		{
+			writer.WriteSigned(to - previous_to);
+			writer.WriteSigned(distance);
+			previous_to = to;
+		}
+	}
+
+	writer.WriteVarint(buses.size());
+	for (const Bus& bus : buses)
+	{
+		dictionary.WriteName(writer, bus.name);
+		bool is_mirrored = IsMirrored(bus.stops);
+		writer.WriteVarint((bus.is_round ? BUS_IS_ROUND : 0) | (is_mirrored ? BUS_IS_MIRRORED : 0));
+		size_t stored_count = is_mirrored ? bus.stops.size() / 2 + 1 : bus.stops.size();
+		writer.WriteVarint(stored_count);
+		int64_t previous_stop = 0;
+		for (size_t i = 0; i < stored_count; ++i)
+		{
+			int64_t stop = stop_to_index.at(bus.stops[i]);
+			writer.WriteSigned(stop - previous_stop);
+			previous_stop = stop;
+		}
+	}
+
+	writer.Flush();
+	if (!output)
+	{
+		throw SerializationError("failed to write snapshot"s);
+	}
+}
+
+SnapshotSettings transport::serialization::LoadCompressedCatalogue(istream& input, TransportCatalogue& tc)
+{
+	char magic[sizeof(COMPRESSED_MAGIC)];
+	uint32_t version = 0;
+	if (!input.read(magic, sizeof(magic)) || memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) != 0)
+	{
+		throw SerializationError("not a compressed catalogue snapshot"s);
+	}
+	if (!input.read(reinterpret_cast<char*>(&version), sizeof(version)) || version != COMPRESSED_VERSION)
+	{
+		throw SerializationError("unsupported snapshot version"s);
+	}
+	SnapshotSettings settings = LoadSettings(input);
+
+	StreamReader reader(input);
+	const vector<string> words = ReadDictionary(reader);
+
+	const uint64_t stops_count = reader.ReadVarint();
+	vector<const Stop*> stops;
+	stops.reserve(min(stops_count, MAX_RESERVED_COUNT));
+	const uint64_t encoding = reader.ReadVarint();
+	if (encoding > static_cast<uint8_t>(CoordinateEncoding::RAW))
+	{
+		throw SerializationError("unknown coordinate encoding in snapshot"s);
+	}
+	int64_t lat = 0;
+	int64_t lng = 0;
+	for (uint64_t i = 0; i < stops_count; ++i)
+	{
+		string name = ReadName(reader, words);
+		geo::Coordinates coordinates;
+		if (encoding == static_cast<uint8_t>(CoordinateEncoding::FIXED_POINT))
+		{
+			lat += reader.ReadSigned();
+			lng += reader.ReadSigned();
+			coordinates = { Dequantize(lat), Dequantize(lng) };
+		}
+		else
+		{
+			coordinates.lat = reader.ReadDouble();
+			coordinates.lng = reader.ReadDouble();
+		}
+		tc.AddStop(name, coordinates);
+		stops.push_back(&tc.GetStops().back());
+	}
+	auto get_stop = [&stops](int64_t index)
+	{
+		if (index < 0 || static_cast<uint64_t>(index) >= stops.size())
+		{
+			throw SerializationError("stop index is out of range"s);
+		}
+		return stops[index];
+	};
+
+	for (size_t from = 0; from < stops.size(); ++from)
+	{
+		uint64_t distances_count = reader.ReadVarint();
+		int64_t to = from;
+		for (uint64_t i = 0; i < distances_count; ++i)
+		{
+			to += reader.ReadSigned();
+			tc.SetDistanceBetweenStops(stops[from], get_stop(to), static_cast<int>(reader.ReadSigned()));
+		}
+	}
+
+	uint64_t buses_count = reader.ReadVarint();
+	for (uint64_t i = 0; i < buses_count; ++i)
+	{
+		string name = ReadName(reader, words);
+		uint64_t flags = reader.ReadVarint();
+		uint64_t stored_count = reader.ReadVarint();
+		if ((flags & BUS_IS_MIRRORED) && stored_count == 0)
+		{
+			throw SerializationError("malformed route in compressed snapshot"s);
+		}
+		vector<const Stop*> bus_stops;
+		unordered_set<string_view> unique_stops;
+		int64_t stop = 0;
+		for (uint64_t j = 0; j < stored_count; ++j)
+		{
+			stop += reader.ReadSigned();
+			bus_stops.push_back(get_stop(stop));
+			unique_stops.insert(bus_stops.back()->name);
+		}
+		if (flags & BUS_IS_MIRRORED)
+		{
+			for (size_t j = stored_count - 1; j-- > 0;)
+			{
+				bus_stops.push_back(bus_stops[j]);
+			}
+		}
+		tc.AddBus(name, move(bus_stops), unique_stops, flags & BUS_IS_ROUND);
+	}
+
+	return settings;
+}
+
+bool transport::serialization::IsCompressedSnapshot(const string& path)
+{
+	ifstream input(path, ios::binary);
+	char magic[sizeof(COMPRESSED_MAGIC)];
+	return input.read(magic, sizeof(magic)) && memcmp(magic, COMPRESSED_MAGIC, sizeof(magic)) == 0;
+}
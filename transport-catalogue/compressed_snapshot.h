@@ -0,0 +1,30 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "serialization.h"
+
+#include <iostream>
+#include <string>
+
+namespace transport::serialization
+{
+
+/*
+* Сжатый снимок базы для долговременного хранения множества версий каталога.
+* Имена остановок и автобусов разбиваются на слова по пробелам и хранятся номерами
+* слов из общего словаря (словарь отсортирован и записан с общими префиксами).
+* Координаты квантуются с шагом 1e-7 градуса и записываются разностями от предыдущей
+* остановки; если квантование хотя бы одной координаты неточно, все координаты пишутся
+* как есть. Последовательности остановок маршрутов и расстояния хранятся разностями
+* номеров в varint, у маршрутов-палиндромов — только первая половина.
+* Чтение потоковое: файл разбирается блоками без загрузки целиком в память
+*/
+void SaveCompressedCatalogue(const TransportCatalogue& tc, const SnapshotSettings& settings, std::ostream& output);
+
+// Заполняет пустой каталог tc из сжатого снимка и возвращает сохранённые настройки
+SnapshotSettings LoadCompressedCatalogue(std::istream& input, TransportCatalogue& tc);
+
+// Проверяет, начинается ли файл с сигнатуры сжатого снимка
+bool IsCompressedSnapshot(const std::string& path);
+
+} // namespace transport::serialization
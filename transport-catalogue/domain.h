@@ -12,6 +12,8 @@ struct Stop
 {
 	std::string name;
 	geo::Coordinates coordinates;
+	// Порядковый номер остановки в каталоге
+	size_t id;
 };
 
 struct Bus
@@ -20,6 +22,8 @@ struct Bus
 	std::vector<const Stop*> stops;
 	std::unordered_set<std::string_view> unique_stops;
 	bool is_round;
+	// Порядковый номер автобуса в каталоге
+	size_t id;
 };
 
 struct RouteInfo
@@ -276,6 +276,41 @@ Node LoadNode(istream& input)
 	}
 }
 
+// Передаёт write участки строки без изменений и escape-последовательности вместо спецсимволов
+template <typename Write>
+void EscapeString(string_view str, Write write)
+{
+	size_t plain_begin = 0;
+	for (size_t i = 0; i < str.size(); ++i)
+	{
+		string_view escaped;
+		switch (str[i])
+		{
+		case '\n':
+			escaped = "\\n"sv;
+			break;
+		case '\r':
+			escaped = "\\r"sv;
+			break;
+		case '\t':
+			escaped = "\\t"sv;
+			break;
+		case '\\':
+			escaped = "\\\\"sv;
+			break;
+		case '"':
+			escaped = "\\\""sv;
+			break;
+		default:
+			continue;
+		}
+		write(str.substr(plain_begin, i - plain_begin));
+		write(escaped);
+		plain_begin = i + 1;
+	}
+	write(str.substr(plain_begin));
+}
+
 }  // namespace
 
 bool Node::operator==(const Node& rhs) const
@@ -408,7 +443,7 @@ bool Node::IsString() const
 	return false;
 }
 
-NodeJSON Node::GetNode() const
+const NodeJSON& Node::GetNode() const
 {
 	return node_json_;
 }
@@ -438,7 +473,7 @@ void NodePrinter::operator()(nullptr_t) const
 	out << "null"s;
 }
 
-void NodePrinter::operator()(Array array) const
+void NodePrinter::operator()(const Array& array) const
 {
 	out << "["s;
 	bool is_first = true;
@@ -458,7 +493,7 @@ void NodePrinter::operator()(Array array) const
 	out << "\n"s << string(cur_indent, ' ') << "]"s;
 }
 
-void NodePrinter::operator()(Dict dict) const
+void NodePrinter::operator()(const Dict& dict) const
 {
 	out << string(cur_indent, ' ') << "{"s;
 	bool is_first = true;
@@ -493,32 +528,10 @@ void NodePrinter::operator()(double value) const
 	out << value;
 }
 
-void NodePrinter::operator()(string str) const
+void NodePrinter::operator()(const string& str) const
 {
 	out << '"';
-	for (char c : str)
-	{
-		switch (c)
-		{
-		case '\n':
-			out << '\\' << 'n';
-			break;
-		case '\r':
-			out << '\\' << 'r';
-			break;
-		case '\t':
-			out << '\\' << 't';
-			break;
-		case '\\':
-			out << '\\' << '\\';
-			break;
-		case '\"':
-			out << '\\' << '"';
-			break;
-		default:
-			out << c;
-		}
-	}
+	PrintEscaped(str, out);
 	out << '"';
 }
 
@@ -527,10 +540,91 @@ Document Load(istream& input)
 	return Document{ LoadNode(input) };
 }
 
+DictStream::DictStream(istream& input)
+	: input_(input)
+{
+	char c;
+	if (!(input_ >> c) || c != '{')
+	{
+		throw ParsingError("Failed to read dict from stream"s);
+	}
+}
+
+optional<string> DictStream::NextKey()
+{
+	is_array_started_ = false;
+	char c;
+	if (!(input_ >> c))
+	{
+		throw ParsingError("Failed to read dict from stream"s);
+	}
+	if (c == '}')
+	{
+		return nullopt;
+	}
+	if (c == ',')
+	{
+		input_ >> c;
+	}
+	if (c != '"')
+	{
+		throw ParsingError("Failed to read dict key from stream"s);
+	}
+	string key = LoadString(input_).AsString();
+	input_ >> c;
+	return key;
+}
+
+Node DictStream::LoadValue()
+{
+	return LoadNode(input_);
+}
+
+optional<Node> DictStream::NextArrayElement()
+{
+	char c;
+	if (!is_array_started_)
+	{
+		if (!(input_ >> c) || c != '[')
+		{
+			throw ParsingError("Failed to read array from stream"s);
+		}
+		is_array_started_ = true;
+	}
+	if (!(input_ >> c))
+	{
+		throw ParsingError("Failed to read array from stream"s);
+	}
+	if (c == ']')
+	{
+		return nullopt;
+	}
+	if (c != ',')
+	{
+		input_.putback(c);
+	}
+	return LoadNode(input_);
+}
+
 void Print(const Document& doc, std::ostream& output, int cur_indent)
 {
-	NodeJSON node_json = doc.GetRoot().GetNode();
-	visit(NodePrinter{ output, cur_indent }, node_json);
+	visit(NodePrinter{ output, cur_indent }, doc.GetRoot().GetNode());
+}
+
+void PrintEscaped(string_view str, ostream& output)
+{
+	EscapeString(str, [&output](string_view part)
+		{
+			output.write(part.data(), part.size());
+		});
+}
+
+void AppendEscaped(string_view str, string& output)
+{
+	EscapeString(str, [&output](string_view part)
+		{
+			output.append(part);
+		});
 }
 
 }  // namespace json
\ No newline at end of file
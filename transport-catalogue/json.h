@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <map>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <variant>
 
@@ -48,7 +50,7 @@ public:
 	bool IsPureDouble() const;
 	bool IsString() const;
 
-	NodeJSON GetNode() const;
+	const NodeJSON& GetNode() const;
 
 private:
 	NodeJSON node_json_;
@@ -75,18 +77,46 @@ struct NodePrinter
 	const int indent_value = 4;
 
 	void operator()(nullptr_t) const;
-	void operator()(Array array) const;
-	void operator()(Dict dict) const;
+	void operator()(const Array& array) const;
+	void operator()(const Dict& dict) const;
 	void operator()(bool value) const;
 	void operator()(int value) const;
 	void operator()(double value) const;
-	void operator()(std::string) const;
+	void operator()(const std::string& str) const;
 };
 
 Document Load(std::istream& input);
 
+/*
+* Поэлементное чтение документа-словаря: значения ключей загружаются по одному,
+* а значение-массив можно читать по элементам, не загружая его целиком
+*/
+class DictStream
+{
+public:
+	// Читает открывающую скобку словаря
+	explicit DictStream(std::istream& input);
+
+	// Следующий ключ или nullopt в конце словаря
+	std::optional<std::string> NextKey();
+	// Значение текущего ключа целиком
+	Node LoadValue();
+	// Следующий элемент значения-массива текущего ключа или nullopt в конце массива
+	std::optional<Node> NextArrayElement();
+
+private:
+	std::istream& input_;
+	bool is_array_started_ = false;
+};
+
 void Print(const Document& doc, std::ostream& output, int cur_indent = 0);
 
+// Выводит символы строки с экранированием, как в строковом значении JSON, но без кавычек.
+// Экранируются только символы ASCII, поэтому строку UTF-8 можно выводить по частям
+void PrintEscaped(std::string_view str, std::ostream& output);
+// То же, с дописыванием в конец строки output
+void AppendEscaped(std::string_view str, std::string& output);
+
 template<typename Type>
 Node::Node(Type value)
 	: node_json_(std::move(value))
@@ -1,22 +1,188 @@
 #include "json_reader.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <future>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 using namespace std;
 using namespace transport::json_reader;
 using namespace transport::domain;
 using namespace transport::request_handler;
+using namespace transport::router;
 using namespace renderer;
 using namespace json;
 
-void Reader::ReadJSON(istream& input)
+namespace
 {
-	Document document = Load(input);
-	requests_ = document.GetRoot().AsMap();
+// Запросов в пакете конвейера и пакетов в каждой из его очередей
+const size_t PIPELINE_BATCH_SIZE = 256;
+const size_t PIPELINE_QUEUE_CAPACITY = 16;
+
+RequestKind GetRequestKind(string_view type)
+{
+	if (type == "Stop"sv)
+	{
+		return RequestKind::STOP;
+	}
+	if (type == "Bus"sv)
+	{
+		return RequestKind::BUS;
+	}
+	if (type == "Map"sv)
+	{
+		return RequestKind::MAP;
+	}
+	if (type == "MapTile"sv)
+	{
+		return RequestKind::MAP_TILE;
+	}
+	if (type == "Route"sv)
+	{
+		return RequestKind::ROUTE;
+	}
+	if (type == "Isochrone"sv)
+	{
+		return RequestKind::ISOCHRONE;
+	}
+	if (type == "Matrix"sv)
+	{
+		return RequestKind::MATRIX;
+	}
+	if (type == "Stats"sv)
+	{
+		return RequestKind::STATS;
+	}
+	if (type == "Memory"sv)
+	{
+		return RequestKind::MEMORY;
+	}
+	return RequestKind::UNKNOWN;
+}
+
+// Литерал, а не string: имя используется и как имя интервала трассировки
+const char* GetRequestKindName(RequestKind kind)
+{
+	switch (kind)
+	{
+	case RequestKind::STOP:
+		return "Stop";
+	case RequestKind::BUS:
+		return "Bus";
+	case RequestKind::MAP:
+		return "Map";
+	case RequestKind::MAP_TILE:
+		return "MapTile";
+	case RequestKind::ROUTE:
+		return "Route";
+	case RequestKind::ISOCHRONE:
+		return "Isochrone";
+	case RequestKind::MATRIX:
+		return "Matrix";
+	case RequestKind::STATS:
+		return "Stats";
+	case RequestKind::MEMORY:
+		return "Memory";
+	case RequestKind::UNKNOWN:
+		break;
+	}
+	return "Unknown";
+}
+
+// Запросы, которым нужен полный каталог; Stop и Bus отвечаются и из отображаемого снимка
+bool IsCatalogueRequest(RequestKind kind)
+{
+	return kind == RequestKind::MAP || kind == RequestKind::MAP_TILE || kind == RequestKind::ROUTE
+		|| kind == RequestKind::ISOCHRONE || kind == RequestKind::MATRIX;
+}
+
+transport::metrics::Histogram& GetPhaseHistogram(const string& phase)
+{
+	return transport::metrics::GetRegistry().GetHistogram("phases"s, phase);
+}
+
+// json::Print всегда выводит с отступами: перед вложенным значением отступ стоит в той же строке,
+// что и ключ, а элементы массивов начинаются с новой строки. Вне строк JSON переводы строк
+// удаляются вместе с отступом, а серии пробелов сжимаются до одного (как после ':' в ответах).
+// Внутри строк переводы строк экранированы, а пробелы сохраняются как есть
+string ToSingleLine(const string& text)
+{
+	string line;
+	line.reserve(text.size());
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		if (text[i] == '"')
+		{
+			// Строка копируется целиком до закрывающей кавычки; экранированные символы пропускаются
+			size_t end = i + 1;
+			while ((end = text.find_first_of("\"\\"sv, end)) != string::npos && text[end] == '\\')
+			{
+				end += 2;
+			}
+			end = min(end, text.size() - 1);
+			line.append(text, i, end - i + 1);
+			i = end;
+		}
+		else if (text[i] == '\n' || text[i] == ' ')
+		{
+			size_t last_space = i;
+			while (last_space + 1 < text.size() && text[last_space + 1] == ' ')
+			{
+				++last_space;
+			}
+			if (text[i] == ' ' && (last_space + 1 == text.size() || text[last_space + 1] != '\n'))
+			{
+				line += ' ';
+			}
+			i = last_space;
+		}
+		else
+		{
+			line += text[i];
+		}
+	}
+	return line;
+}
+} // namespace
+
+void Reader::ReadJSON(istream& input, bool can_stream_stat_requests)
+{
+	// Включён ли сбор метрик, известно лишь после разбора, поэтому время замеряется всегда
+	const auto start = chrono::steady_clock::now();
+	auto document = make_unique<DictStream>(input);
+	requests_.clear();
+	stat_requests_stream_.reset();
+	while (optional<string> key = document->NextKey())
+	{
+		if (can_stream_stat_requests && *key == "stat_requests"s && GetExecutionFlag("pipeline"s, false))
+		{
+			stat_requests_stream_ = move(document);
+			break;
+		}
+		Node value = document->LoadValue();
+		requests_.emplace(move(*key), move(value));
+	}
+	const auto end = chrono::steady_clock::now();
+	if (GetExecutionFlag("metrics"s, false))
+	{
+		metrics::GetRegistry().Enable(true);
+		GetPhaseHistogram("parse_json"s).Record(chrono::duration_cast<chrono::nanoseconds>(end - start).count());
+	}
+	if (requests_.count("execution_settings"s) && requests_.at("execution_settings"s).AsMap().count("trace"s))
+	{
+		trace::Tracer::Enable(requests_.at("execution_settings"s).AsMap().at("trace"s).AsString());
+		trace::Tracer::AddSpan("parse_json", "phase", start, end);
+	}
 }
 
 void Reader::ParseRequests()
 {
+	metrics::ScopedTimer timer(GetPhaseHistogram("build_catalogue"s));
+	trace::Span span("build_catalogue");
 	Queries queries = ParseBaseRequests(requests_.at("base_requests"s));
 	unordered_map<string_view, const Dict*> distances_info;
 	for (const Node* stop_query : queries.stop_queries)
@@ -43,14 +209,405 @@ void Reader::ParseRequests()
 		auto [stops, unique_stops] = GetStops(query_dict.at("stops"s).AsArray(), is_round);
 		tc_.AddBus(bus_name, stops, unique_stops, is_round);
 	}
+	settings_.render_settings = ParseRenderSettings();
+	settings_.routing_settings = ParseRoutingSettings();
 }
 
 void Reader::GetResponses(ostream& output)
 {
-	RenderSettings render_settings = ParseRenderSettings();
-	MapRenderer renderer(render_settings);
-	RequestHandler handler(tc_, renderer);
-	ExecuteStatRequests(requests_.at("stat_requests"s), handler, output);
+	PrepareStatRequests();
+	metrics::ScopedTimer timer(GetPhaseHistogram("execute"s));
+	trace::Span span("execute");
+	if (stat_requests_stream_)
+	{
+		StreamStatRequests(output);
+		return;
+	}
+	vector<StatRequest> requests = CompileStatRequests(requests_.at("stat_requests"s).AsArray());
+	output << "[\n"s;
+	size_t duplicates_count = ExecuteStatRequestBatch(requests, output);
+	output << "\n]"s;
+	PrintExecutionStats(requests.size(), duplicates_count);
+}
+
+size_t Reader::ExecuteStatRequestBatch(vector<StatRequest>& requests, ostream& output)
+{
+	size_t duplicates_count = 0;
+	if (GetExecutionFlag("deduplicate_requests"s, true))
+	{
+		duplicates_count = MarkDuplicateRequests(requests);
+	}
+	metrics::GetRegistry().GetCounter("stat_requests"s).Add(requests.size());
+	metrics::GetRegistry().GetCounter("deduplicated_requests"s).Add(duplicates_count);
+	if (thread_pool_)
+	{
+		ExecuteStatRequestsParallel(requests, *handler_, output);
+	}
+	else
+	{
+		ExecuteStatRequests(requests, *handler_, output);
+	}
+	return duplicates_count;
+}
+
+void Reader::StreamStatRequests(ostream& output)
+{
+	concurrent::SpscQueue<Array> parsed_batches(PIPELINE_QUEUE_CAPACITY);
+	concurrent::SpscQueue<string> response_batches(PIPELINE_QUEUE_CAPACITY);
+	size_t requests_count = 0;
+	size_t duplicates_count = 0;
+	exception_ptr execution_error;
+	thread executor([this, &parsed_batches, &response_batches, &requests_count, &duplicates_count, &execution_error]
+		{
+			try
+			{
+				bool is_first = true;
+				while (optional<Array> batch = parsed_batches.Pop())
+				{
+					trace::Span span("execute_batch");
+					vector<StatRequest> requests = CompileStatRequests(*batch);
+					ostringstream batch_output;
+					if (!is_first)
+					{
+						batch_output << ",\n"s;
+					}
+					is_first = false;
+					duplicates_count += ExecuteStatRequestBatch(requests, batch_output);
+					requests_count += requests.size();
+					if (!response_batches.Push(batch_output.str()))
+					{
+						break;
+					}
+				}
+			}
+			catch (...)
+			{
+				execution_error = current_exception();
+				// Разбор прекращается на следующем пакете
+				parsed_batches.Close();
+			}
+			response_batches.Close();
+		});
+
+	output << "[\n"s;
+	thread writer([&output, &response_batches]
+		{
+			while (optional<string> batch = response_batches.Pop())
+			{
+				trace::Span span("write_batch");
+				output << *batch;
+				output.flush();
+			}
+		});
+
+	exception_ptr parsing_error;
+	try
+	{
+		Array batch;
+		bool is_stopped = false;
+		while (optional<Node> query = stat_requests_stream_->NextArrayElement())
+		{
+			// Ответ на Map может занимать мегабайты, поэтому он завершает пакет
+			const bool is_map = query->IsMap() && query->AsMap().count("type"s)
+				&& query->AsMap().at("type"s) == "Map"s;
+			batch.push_back(move(*query));
+			if (batch.size() == PIPELINE_BATCH_SIZE || is_map)
+			{
+				if (!parsed_batches.Push(move(batch)))
+				{
+					is_stopped = true;
+					break;
+				}
+				batch = Array{};
+			}
+		}
+		if (!is_stopped && !batch.empty())
+		{
+			parsed_batches.Push(move(batch));
+		}
+		if (!is_stopped && stat_requests_stream_->NextKey())
+		{
+			throw invalid_argument("stat_requests must be the last key when execution_settings.pipeline is enabled"s);
+		}
+	}
+	catch (...)
+	{
+		parsing_error = current_exception();
+	}
+	parsed_batches.Close();
+	executor.join();
+	writer.join();
+	stat_requests_stream_.reset();
+
+	if (execution_error)
+	{
+		rethrow_exception(execution_error);
+	}
+	if (parsing_error)
+	{
+		rethrow_exception(parsing_error);
+	}
+	output << "\n]"s;
+	PrintExecutionStats(requests_count, duplicates_count);
+}
+
+void Reader::PrintExecutionStats(size_t requests_count, size_t duplicates_count) const
+{
+	if (GetExecutionFlag("print_stats"s, false))
+	{
+		clog << "stat_requests: "sv << requests_count << ", duplicates: "sv << duplicates_count
+			<< ", dedup ratio: "sv << (requests_count == 0 ? 0.0 : static_cast<double>(duplicates_count) / requests_count)
+			<< endl;
+	}
+}
+
+void Reader::PrepareStatRequests(int response_indent)
+{
+	metrics::ScopedTimer timer(GetPhaseHistogram("prepare"s));
+	trace::Span span("prepare");
+	response_indent_ = response_indent;
+	for (size_t kind = 0; kind < REQUEST_KINDS_COUNT; ++kind)
+	{
+		request_histograms_[kind] = &metrics::GetRegistry().GetHistogram("requests"s,
+			GetRequestKindName(static_cast<RequestKind>(kind)));
+	}
+	if (mapped_)
+	{
+		// Запросы сервера и конвейера заранее неизвестны, поэтому каталог строится при первом
+		// запросе, которому он нужен; пакет без таких запросов обходится без каталога
+		is_mapped_only_ = !requests_.count("stat_requests"s)
+			|| none_of(requests_.at("stat_requests"s).AsArray().begin(), requests_.at("stat_requests"s).AsArray().end(),
+				[](const Node& query)
+				{
+					return IsCatalogueRequest(GetRequestKind(query.AsMap().at("type"s).AsString()));
+				});
+		if (!is_mapped_only_)
+		{
+			MaterializeMappedBase();
+		}
+	}
+	renderer_ = make_unique<MapRenderer>(settings_.render_settings);
+	handler_ = make_unique<RequestHandler>(tc_, *renderer_, settings_.routing_settings);
+	// Неразвёрнутый отображаемый снимок отвечает на Stop и Bus сам
+	if (IsResponsePrecomputationEnabled() && !is_mapped_only_)
+	{
+		response_fragments_ = make_unique<ResponseFragments>(tc_, response_indent_);
+	}
+	is_map_cached_ = IsMapCacheEnabled();
+	if (GetExecutionThreadsCount() > 1)
+	{
+		thread_pool_ = make_unique<concurrent::ThreadPool>(GetExecutionThreadsCount());
+	}
+}
+
+string Reader::ExecuteStatRequestLine(const string& line)
+{
+	optional<int> id;
+	try
+	{
+		istringstream input(line);
+		Document document = Load(input);
+		const Dict& query_dict = document.GetRoot().AsMap();
+		if (query_dict.count("id"s) && query_dict.at("id"s).IsInt())
+		{
+			id = query_dict.at("id"s).AsInt();
+		}
+		ostringstream output;
+		ExecuteStatRequest(CompileStatRequest(query_dict), *handler_, output);
+		if (output.tellp() > 0)
+		{
+			return ToSingleLine(output.str());
+		}
+	}
+	catch (const exception&)
+	{
+	}
+	// Ответ нужен на каждую строку, поэтому неразобранный запрос или запрос неизвестного типа — ошибка
+	metrics::GetRegistry().GetCounter("invalid_requests"s).Add();
+	ostringstream output;
+	Print(Document{ Dict{ {"error_message"s, "invalid request"s}, {"request_id"s, id ? Node(*id) : Node()} } }, output);
+	return ToSingleLine(output.str());
+}
+
+transport::server::ServerSettings Reader::ParseServerSettings() const
+{
+	transport::server::ServerSettings settings;
+	settings.threads_count = GetExecutionThreadsCount();
+	if (requests_.count("server_settings"s))
+	{
+		const Dict& server_settings = requests_.at("server_settings"s).AsMap();
+		if (server_settings.count("socket"s))
+		{
+			settings.socket_path = server_settings.at("socket"s).AsString();
+		}
+		if (server_settings.count("max_line_length"s))
+		{
+			const int max_line_length = server_settings.at("max_line_length"s).AsInt();
+			if (max_line_length <= 0)
+			{
+				throw invalid_argument("server_settings.max_line_length must be positive"s);
+			}
+			settings.max_line_length = static_cast<size_t>(max_line_length);
+		}
+	}
+	return settings;
+}
+
+void Reader::SaveBase() const
+{
+	metrics::ScopedTimer timer(GetPhaseHistogram("save_base"s));
+	trace::Span span("save_base");
+	ofstream output(GetSerializationFile(), ios::binary);
+	if (!output)
+	{
+		throw runtime_error("failed to open "s + GetSerializationFile());
+	}
+	const Dict& serialization_settings = requests_.at("serialization_settings"s).AsMap();
+	const string format = serialization_settings.count("format"s) ? serialization_settings.at("format"s).AsString() : ""s;
+	if (format == "mapped"s)
+	{
+		serialization::SaveMappedCatalogue(tc_, settings_, output);
+	}
+	else if (format == "compressed"s)
+	{
+		serialization::SaveCompressedCatalogue(tc_, settings_, output);
+	}
+	else
+	{
+		serialization::SaveCatalogue(tc_, settings_, output);
+	}
+}
+
+void Reader::LoadBase()
+{
+	metrics::ScopedTimer timer(GetPhaseHistogram("load_base"s));
+	trace::Span span("load_base");
+	if (serialization::IsMappedSnapshot(GetSerializationFile()))
+	{
+		mapped_ = make_unique<serialization::MappedCatalogue>(GetSerializationFile());
+		settings_ = mapped_->GetSettings();
+		return;
+	}
+	ifstream input(GetSerializationFile(), ios::binary);
+	if (!input)
+	{
+		throw runtime_error("failed to open "s + GetSerializationFile());
+	}
+	if (serialization::IsCompressedSnapshot(GetSerializationFile()))
+	{
+		settings_ = serialization::LoadCompressedCatalogue(input, tc_);
+	}
+	else
+	{
+		settings_ = serialization::LoadCatalogue(input, tc_);
+	}
+	FillValidBuses();
+}
+
+void Reader::ApplyPatch() const
+{
+	metrics::ScopedTimer timer(GetPhaseHistogram("apply_patch"s));
+	trace::Span span("apply_patch");
+	if (!serialization::IsMappedSnapshot(GetSerializationFile()))
+	{
+		throw serialization::SerializationError("patches can be applied to mapped snapshots only"s);
+	}
+	serialization::MappedCatalogue base(GetSerializationFile());
+	serialization::CataloguePatch patch = ParsePatchRequests(requests_.at("patch_requests"s).AsArray());
+
+	// Новый снимок пишется во временный файл и подменяет результат целиком,
+	// поэтому выходной файл может совпадать с исходным
+	const string& output_file = requests_.at("patch_settings"s).AsMap().at("file"s).AsString();
+	const string temp_file = output_file + ".tmp"s;
+	{
+		ofstream output(temp_file, ios::binary);
+		if (!output)
+		{
+			throw runtime_error("failed to open "s + temp_file);
+		}
+		serialization::ApplyPatch(base, patch, output);
+	}
+	if (rename(temp_file.c_str(), output_file.c_str()) != 0)
+	{
+		throw runtime_error("failed to replace "s + output_file);
+	}
+}
+
+transport::serialization::CataloguePatch Reader::ParsePatchRequests(const Array& patch_requests) const
+{
+	serialization::CataloguePatch patch;
+	for (const Node& query : patch_requests)
+	{
+		const Dict& query_dict = query.AsMap();
+		bool is_removed = query_dict.count("removed"s) && query_dict.at("removed"s).AsBool();
+		if (query_dict.at("type"s) == "Stop"s)
+		{
+			serialization::StopPatch stop_patch;
+			stop_patch.name = query_dict.at("name"s).AsString();
+			stop_patch.is_removed = is_removed;
+			if (query_dict.count("latitude"s))
+			{
+				stop_patch.coordinates = geo::Coordinates{ query_dict.at("latitude"s).AsDouble(),
+					query_dict.at("longitude"s).AsDouble() };
+			}
+			if (query_dict.count("road_distances"s))
+			{
+				for (const auto& [to_stop, distance] : query_dict.at("road_distances"s).AsMap())
+				{
+					stop_patch.road_distances.emplace_back(to_stop, distance.AsInt());
+				}
+			}
+			patch.stops.push_back(move(stop_patch));
+		}
+		else if (query_dict.at("type"s) == "Bus"s)
+		{
+			serialization::BusPatch bus_patch;
+			bus_patch.name = query_dict.at("name"s).AsString();
+			bus_patch.is_removed = is_removed;
+			if (!is_removed)
+			{
+				bus_patch.is_round = query_dict.at("is_roundtrip"s).AsBool();
+				for (const Node& stop_node : query_dict.at("stops"s).AsArray())
+				{
+					bus_patch.stops.push_back(stop_node.AsString());
+				}
+				if (!bus_patch.is_round)
+				{
+					for (int i = bus_patch.stops.size() - 2; i >= 0; --i)
+					{
+						bus_patch.stops.push_back(bus_patch.stops[i]);
+					}
+				}
+			}
+			patch.buses.push_back(move(bus_patch));
+		}
+	}
+	return patch;
+}
+
+void Reader::MaterializeMappedBase()
+{
+	// Materialize проверяет снимок до изменения каталога, поэтому после исключения
+	// следующий вызов начнёт с пустого каталога
+	call_once(materialize_flag_, [this]
+		{
+			metrics::ScopedTimer timer(GetPhaseHistogram("materialize_base"s));
+			trace::Span span("materialize_base");
+			mapped_->Materialize(tc_);
+			FillValidBuses();
+			is_catalogue_ready_.store(true, memory_order_release);
+		});
+}
+
+void Reader::FillValidBuses()
+{
+	for (const Bus& bus : tc_.GetBuses())
+	{
+		if (!bus.stops.empty())
+		{
+			valid_buses_.insert(bus.name);
+		}
+	}
 }
 
 Queries Reader::ParseBaseRequests(const Node& base_requests)
@@ -94,90 +651,609 @@ pair<vector<const Stop*>, unordered_set<string_view>> Reader::GetStops(const Arr
 	return { stops, unique_stops };
 }
 
-void Reader::ExecuteStatRequests(const Node& stat_requests, const RequestHandler& handler, ostream& output)
+vector<StatRequest> Reader::CompileStatRequests(const Array& stat_requests) const
 {
-	output << "[\n"s;
-	bool is_first = true;
-	for (const Node& query : stat_requests.AsArray())
+	const bool is_mapped_only = is_mapped_only_;
+	vector<StatRequest> requests;
+	requests.reserve(stat_requests.size());
+	for (const Node& query : stat_requests)
+	{
+		requests.push_back(CompileStatRequest(query.AsMap(), is_mapped_only));
+	}
+	if (!is_mapped_only)
+	{
+		ResolveStatRequestObjects(requests);
+	}
+	return requests;
+}
+
+void Reader::ResolveStatRequestObjects(vector<StatRequest>& requests) const
+{
+	vector<size_t> stop_requests;
+	vector<string_view> stop_names;
+	vector<size_t> bus_requests;
+	vector<string_view> bus_names;
+	for (size_t i = 0; i < requests.size(); ++i)
 	{
-		if (is_first)
+		if (requests[i].kind == RequestKind::STOP)
 		{
-			is_first = false;
+			stop_requests.push_back(i);
+			stop_names.push_back(requests[i].query->at("name"s).AsString());
 		}
-		else
+		else if (requests[i].kind == RequestKind::BUS)
+		{
+			bus_requests.push_back(i);
+			bus_names.push_back(requests[i].query->at("name"s).AsString());
+		}
+	}
+
+	vector<const Stop*> stops;
+	tc_.SearchStops(stop_names, stops);
+	for (size_t i = 0; i < stops.size(); ++i)
+	{
+		if (stops[i])
+		{
+			requests[stop_requests[i]].object_id = stops[i]->id;
+		}
+	}
+	vector<const Bus*> buses;
+	tc_.SearchBuses(bus_names, buses);
+	for (size_t i = 0; i < buses.size(); ++i)
+	{
+		if (buses[i])
+		{
+			requests[bus_requests[i]].object_id = buses[i]->id;
+		}
+	}
+}
+
+StatRequest Reader::CompileStatRequest(const Dict& query_dict, bool resolve_object) const
+{
+	StatRequest request;
+	request.query = &query_dict;
+	request.kind = GetRequestKind(query_dict.at("type"s).AsString());
+	if (request.kind == RequestKind::UNKNOWN)
+	{
+		return request;
+	}
+	request.id = query_dict.at("id"s).AsInt();
+	if (!resolve_object)
+	{
+		return request;
+	}
+	// Неразвёрнутый отображаемый снимок отвечает по номерам своих записей
+	const bool is_mapped_only = is_mapped_only_;
+	if (request.kind == RequestKind::STOP)
+	{
+		const string& stop_name = query_dict.at("name"s).AsString();
+		if (is_mapped_only)
+		{
+			request.object_id = mapped_->FindStop(stop_name).value_or(OBJECT_NOT_FOUND);
+		}
+		else if (const Stop* stop = tc_.SearchStop(stop_name))
+		{
+			request.object_id = stop->id;
+		}
+	}
+	else if (request.kind == RequestKind::BUS)
+	{
+		const string& bus_name = query_dict.at("name"s).AsString();
+		if (is_mapped_only)
+		{
+			request.object_id = mapped_->FindBus(bus_name).value_or(OBJECT_NOT_FOUND);
+		}
+		else if (const Bus* bus = tc_.SearchBus(bus_name))
+		{
+			request.object_id = bus->id;
+		}
+	}
+	return request;
+}
+
+size_t Reader::MarkDuplicateRequests(vector<StatRequest>& requests) const
+{
+	// Ключ — тип запроса и номер объекта; все ненайденные имена одного типа дают одинаковый ответ
+	unordered_map<uint64_t, uint32_t> first_requests;
+	size_t duplicates_count = 0;
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		StatRequest& request = requests[i];
+		// Без кэша карта пишется в ответ потоком, не занимая памяти, поэтому каждый повтор Map
+		// отрисовывается заново и не считается повтором
+		const bool is_shared_map = request.kind == RequestKind::MAP && is_map_cached_;
+		if (request.kind != RequestKind::STOP && request.kind != RequestKind::BUS && !is_shared_map)
+		{
+			continue;
+		}
+		const uint64_t key = (static_cast<uint64_t>(request.kind) << 32) | request.object_id;
+		auto [it, is_inserted] = first_requests.emplace(key, static_cast<uint32_t>(i));
+		if (!is_inserted)
+		{
+			request.duplicate_of = it->second;
+			requests[it->second].has_duplicates = true;
+			++duplicates_count;
+		}
+	}
+	return duplicates_count;
+}
+
+bool Reader::IsSharedWithinBatch(const StatRequest& request) const
+{
+	return (request.kind == RequestKind::STOP || request.kind == RequestKind::BUS) && !response_fragments_
+		&& (request.has_duplicates || request.duplicate_of != NOT_DUPLICATE);
+}
+
+void Reader::ExecuteStatRequests(const vector<StatRequest>& requests, const RequestHandler& handler, ostream& output)
+{
+	ResponseArena shared_responses;
+	unordered_map<uint32_t, size_t> shared_fragments;
+	for (size_t i = 0; i < requests.size(); ++i)
+	{
+		if (i > 0)
 		{
 			output << ",\n";
 		}
-		const Dict& query_dict = query.AsMap();
-		if (query_dict.at("type"s).AsString() == "Stop"s)
+		const StatRequest& request = requests[i];
+		if (!IsSharedWithinBatch(request))
 		{
-			ExecuteStopRequest(query_dict, handler, output);
+			ExecuteStatRequest(request, handler, output);
 		}
-		else if (query_dict.at("type"s).AsString() == "Bus"s)
+		else if (request.duplicate_of != NOT_DUPLICATE)
 		{
-			ExecuteBusRequest(query_dict, handler, output);
+			shared_responses.Write(shared_fragments.at(request.duplicate_of), request.id, output);
 		}
-		else if (query_dict.at("type"s).AsString() == "Map"s)
+		else
 		{
-			ExecuteMapRequest(query_dict, handler, output);
+			ostringstream response;
+			ExecuteStatRequest(request, handler, response);
+			const string text = response.str();
+			output << text;
+			shared_fragments[static_cast<uint32_t>(i)] = shared_responses.Add(text, request.id);
 		}
 	}
-	output << "\n]"s;
 }
 
-void Reader::ExecuteStopRequest(const Dict& query_dict, const RequestHandler& handler, ostream& output)
+void Reader::ExecuteStatRequestsParallel(const vector<StatRequest>& requests, const RequestHandler& handler,
+	ostream& output)
+{
+	// Запросы делятся на блоки с запасом по числу потоков, чтобы тяжёлые запросы (Route)
+	// распределялись между потоками; каждый ответ печатается в собственный буфер.
+	// Matrix сам распараллеливается на том же пуле, а Map пишется в output без буфера,
+	// поэтому они выполняются в вызывающем потоке
+	const size_t chunk_size = max<size_t>(1, requests.size() / (thread_pool_->GetThreadsCount() * 8));
+	vector<future<vector<string>>> chunks;
+	for (size_t begin = 0; begin < requests.size(); begin += chunk_size)
+	{
+		const size_t end = min(requests.size(), begin + chunk_size);
+		chunks.push_back(thread_pool_->Submit([this, &requests, &handler, begin, end]
+			{
+				trace::Span span("execute_chunk");
+				vector<string> responses(end - begin);
+				for (size_t i = begin; i < end; ++i)
+				{
+					// Повторы выводятся из ответа первого запроса при сборке результата
+					const bool is_batch_duplicate = requests[i].duplicate_of != NOT_DUPLICATE
+						&& IsSharedWithinBatch(requests[i]);
+					if (requests[i].kind != RequestKind::MATRIX && requests[i].kind != RequestKind::MAP
+						&& !is_batch_duplicate)
+					{
+						ostringstream response;
+						ExecuteStatRequest(requests[i], handler, response);
+						responses[i - begin] = response.str();
+					}
+				}
+				return responses;
+			}));
+	}
+
+	ResponseArena shared_responses;
+	unordered_map<uint32_t, size_t> shared_fragments;
+	try
+	{
+		size_t index = 0;
+		for (auto& chunk : chunks)
+		{
+			for (const string& response : chunk.get())
+			{
+				if (index > 0)
+				{
+					output << ",\n";
+				}
+				const uint32_t request_index = static_cast<uint32_t>(index++);
+				const StatRequest& request = requests[request_index];
+				if (request.kind == RequestKind::MATRIX || request.kind == RequestKind::MAP)
+				{
+					ExecuteStatRequest(request, handler, output);
+				}
+				else if (IsSharedWithinBatch(request) && request.duplicate_of != NOT_DUPLICATE)
+				{
+					shared_responses.Write(shared_fragments.at(request.duplicate_of), request.id, output);
+				}
+				else
+				{
+					output << response;
+					if (IsSharedWithinBatch(request))
+					{
+						shared_fragments[request_index] = shared_responses.Add(response, request.id);
+					}
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+		// Оставшиеся блоки ссылаются на запросы и обработчик, поэтому их нужно дождаться
+		for (auto& chunk : chunks)
+		{
+			if (chunk.valid())
+			{
+				chunk.wait();
+			}
+		}
+		throw;
+	}
+}
+
+void Reader::ExecuteStatRequest(const StatRequest& request, const RequestHandler& handler, ostream& output)
+{
+	metrics::ScopedTimer timer(*request_histograms_[static_cast<size_t>(request.kind)]);
+	trace::Span span(GetRequestKindName(request.kind), "request", request.id);
+	if (is_mapped_only_ && IsCatalogueRequest(request.kind))
+	{
+		MaterializeMappedBase();
+	}
+	switch (request.kind)
+	{
+	case RequestKind::STOP:
+		ExecuteStopRequest(request, output);
+		break;
+	case RequestKind::BUS:
+		ExecuteBusRequest(request, output);
+		break;
+	case RequestKind::MAP:
+		ExecuteMapRequest(request, handler, output);
+		break;
+	case RequestKind::MAP_TILE:
+		ExecuteMapTileRequest(*request.query, handler, output);
+		break;
+	case RequestKind::ROUTE:
+		ExecuteRouteRequest(*request.query, handler, output);
+		break;
+	case RequestKind::ISOCHRONE:
+		ExecuteIsochroneRequest(*request.query, handler, output);
+		break;
+	case RequestKind::MATRIX:
+		ExecuteMatrixRequest(*request.query, handler, output);
+		break;
+	case RequestKind::STATS:
+		ExecuteStatsRequest(request, output);
+		break;
+	case RequestKind::MEMORY:
+		ExecuteMemoryRequest(request, output);
+		break;
+	case RequestKind::UNKNOWN:
+		break;
+	}
+}
+
+void Reader::ExecuteStopRequest(const StatRequest& request, ostream& output)
+{
+	int current_indent = response_indent_;
+	if (request.object_id == OBJECT_NOT_FOUND)
+	{
+		Print(Document{ Dict{ {"request_id"s, request.id}, {"error_message"s , "not found"s} } }, output, current_indent);
+		return;
+	}
+	if (response_fragments_)
+	{
+		response_fragments_->WriteStopResponse(request.object_id, request.id, output);
+		return;
+	}
+	Dict response;
+	if (is_mapped_only_)
+	{
+		sv_set buses;
+		for (uint32_t bus : mapped_->GetStopBuses(request.object_id))
+		{
+			buses.insert(mapped_->GetBusName(bus));
+		}
+		response = MakeStopResponse(&buses);
+	}
+	else
+	{
+		response = MakeStopResponse(tc_.GetStopToBuses(&tc_.GetStops()[request.object_id]));
+	}
+	response["request_id"s] = request.id;
+	Print(Document{ move(response) }, output, current_indent);
+}
+
+void Reader::ExecuteBusRequest(const StatRequest& request, ostream& output)
+{
+	int current_indent = response_indent_;
+	if (request.object_id == OBJECT_NOT_FOUND)
+	{
+		Print(Document{ Dict{ {"request_id"s, request.id}, {"error_message"s , "not found"s} } }, output, current_indent);
+		return;
+	}
+	if (response_fragments_)
+	{
+		response_fragments_->WriteBusResponse(request.object_id, request.id, output);
+		return;
+	}
+	Dict response = MakeBusResponse(is_mapped_only_
+		? mapped_->GetRouteInfo(request.object_id)
+		: tc_.GetRouteInfo(&tc_.GetBuses()[request.object_id]));
+	response["request_id"s] = request.id;
+	Print(Document{ move(response) }, output, current_indent);
+}
+
+void Reader::ExecuteStatsRequest(const StatRequest& request, ostream& output)
+{
+	int current_indent = response_indent_;
+	Print(Document{ Dict{ {"metrics"s, metrics::GetRegistry().ToJSON()}, {"request_id"s, request.id} } },
+		output, current_indent);
+}
+
+void Reader::PrintMetrics(ostream& output) const
+{
+	if (metrics::GetRegistry().IsEnabled())
+	{
+		Print(Document{ metrics::GetRegistry().ToJSON() }, output);
+		output << endl;
+	}
+}
+
+void Reader::ExecuteMemoryRequest(const StatRequest& request, ostream& output) const
+{
+	int current_indent = response_indent_;
+	Print(Document{ Dict{ {"memory"s, GetMemoryReport()}, {"request_id"s, request.id} } }, output, current_indent);
+}
+
+void Reader::PrintMemoryReport(ostream& output) const
+{
+	if (GetExecutionFlag("memory_report"s, false))
+	{
+		Print(Document{ GetMemoryReport() }, output);
+		output << endl;
+	}
+}
+
+Dict Reader::GetMemoryReport() const
+{
+	// Каталог, который ещё строится из отображаемого снимка, читать нельзя
+	vector<memory::Usage> usages;
+	if (!mapped_ || is_catalogue_ready_.load(memory_order_acquire))
+	{
+		usages = tc_.GetMemoryUsage();
+	}
+	memory::UsageCounter requests("requests_"s);
+	usages.push_back(requests.AddJson(requests_).Get());
+	if (response_fragments_)
+	{
+		usages.push_back(response_fragments_->GetMemoryUsage());
+	}
+	return memory::ToJSON(usages);
+}
+
+void Reader::ExecuteMapRequest(const StatRequest& request, const RequestHandler& handler, ostream& output)
+{
+	int current_indent = response_indent_;
+	int key_indent = current_indent + 4;
+	// Карта выводится строковым литералом в том же формате, что и json::Print
+	output << string(current_indent, ' ') << "{\n"s << string(key_indent, ' ') << "\"map\": "s;
+	if (is_map_cached_)
+	{
+		output << handler.GetRenderedMap(valid_buses_)->json;
+	}
+	else
+	{
+		handler.PrintMap(valid_buses_, output);
+	}
+	output << ",\n"s << string(key_indent, ' ') << "\"request_id\": "s << request.id << "\n"s
+		<< string(current_indent, ' ') << "}"s;
+}
+
+void Reader::ExecuteMapTileRequest(const Dict& query_dict, const RequestHandler& handler, ostream& output)
 {
-	Array buses_array;
 	int id = query_dict.at("id"s).AsInt();
-	const string& stop_name = query_dict.at("name"s).AsString();
-	const sv_set* buses = handler.GetBusesByStop(stop_name);
-	int current_indent = 4;
-	if (!tc_.SearchStop(stop_name))
+	int current_indent = response_indent_;
+	shared_ptr<const TileIndex> tile_index = handler.GetTileIndex(valid_buses_);
+	optional<Viewport> viewport;
+	if (query_dict.count("bbox"s))
 	{
-		Print(Document{ Dict{ {"request_id"s, id}, {"error_message"s , "not found"s} } }, output, current_indent);
+		const Dict& bbox = query_dict.at("bbox"s).AsMap();
+		viewport = MakeBoundsViewport(tile_index->GetRenderSettings(), tile_index->GetProjector(),
+			{ bbox.at("min_lat"s).AsDouble(), bbox.at("min_lng"s).AsDouble() },
+			{ bbox.at("max_lat"s).AsDouble(), bbox.at("max_lng"s).AsDouble() });
 	}
 	else
 	{
-		if (buses)
+		viewport = MakeTileViewport(tile_index->GetRenderSettings(), query_dict.at("zoom"s).AsInt(),
+			query_dict.at("x"s).AsInt(), query_dict.at("y"s).AsInt());
+	}
+	if (!viewport)
+	{
+		Print(Document{ Dict{ {"request_id"s, id}, {"error_message"s , "not found"s} } }, output, current_indent);
+		return;
+	}
+	int key_indent = current_indent + 4;
+	// Плитка пишется в ответ потоком, как карта Map без кэша
+	output << string(current_indent, ' ') << "{\n"s << string(key_indent, ' ') << "\"map\": \""s;
+	svg::Writer writer([&output](string_view svg_part)
 		{
-			for (string_view bus_name : *buses)
+			PrintEscaped(svg_part, output);
+		});
+	tile_index->WriteTile(*viewport, writer);
+	output << "\",\n"s << string(key_indent, ' ') << "\"request_id\": "s << id << "\n"s
+		<< string(current_indent, ' ') << "}"s;
+}
+
+void Reader::ExecuteMatrixRequest(const Dict& query_dict, const RequestHandler& handler, ostream& output)
+{
+	int id = query_dict.at("id"s).AsInt();
+	int current_indent = response_indent_;
+	vector<const Stop*> sources = FindStops(query_dict.at("from"s).AsArray(), handler);
+	auto targets = make_shared<const vector<const Stop*>>(FindStops(query_dict.at("to"s).AsArray(), handler));
+	bool is_found = all_of(sources.begin(), sources.end(), [](const Stop* stop) { return stop; })
+		&& all_of(targets->begin(), targets->end(), [](const Stop* stop) { return stop; });
+	if (!settings_.routing_settings || !is_found)
+	{
+		Print(Document{ Dict{ {"request_id"s, id}, {"error_message"s , "not found"s} } }, output, current_indent);
+		return;
+	}
+
+	// Каждая строка матрицы — отдельный поиск из одной остановки, граф разделяется между потоками.
+	// Пул создаётся в PrepareStatRequests; без него строки считаются по очереди при выводе
+	vector<future<vector<optional<double>>>> rows;
+	rows.reserve(sources.size());
+	for (const Stop* source : sources)
+	{
+		auto compute_row = [&handler, source, targets]
 			{
-				buses_array.emplace_back(string{ bus_name });
-			}
+				return handler.GetTravelTimes(source, *targets);
+			};
+		rows.push_back(thread_pool_ ? thread_pool_->Submit(move(compute_row))
+			: async(launch::deferred, move(compute_row)));
+	}
+
+	// Строки выводятся по мере готовности в порядке источников, в том же формате, что и json::Print
+	int key_indent = current_indent + 4;
+	int row_indent = key_indent + 4;
+	output << string(current_indent, ' ') << "{\n"s << string(key_indent, ' ') << "\"matrix\": ["s;
+	bool is_first = true;
+	for (auto& row_future : rows)
+	{
+		Array row;
+		for (const optional<double>& time : row_future.get())
+		{
+			row.push_back(time ? Node(*time) : Node());
 		}
-		Print(Document{ Dict{ {"buses"s, buses_array}, {"request_id"s, id} } }, output, current_indent);
+		output << (is_first ? "\n"s : ",\n"s) << string(row_indent, ' ');
+		is_first = false;
+		Print(Document{ move(row) }, output, row_indent);
 	}
+	output << "\n"s << string(key_indent, ' ') << "],\n"s
+		<< string(key_indent, ' ') << "\"request_id\": "s << id << "\n"s
+		<< string(current_indent, ' ') << "}"s;
 }
 
-void Reader::ExecuteBusRequest(const Dict& query_dict, const RequestHandler& handler, ostream& output)
+void Reader::ExecuteRouteRequest(const Dict& query_dict, const RequestHandler& handler, ostream& output)
 {
 	int id = query_dict.at("id"s).AsInt();
-	const string& bus_name = query_dict.at("name"s).AsString();
-	optional<RouteInfo> route_info = handler.GetRouteInfo(bus_name);
-	int current_indent = 4;
-	if (!route_info)
+	int current_indent = response_indent_;
+	const Stop* from = handler.GetStop(query_dict.at("from"s).AsString());
+	const Stop* to = handler.GetStop(query_dict.at("to"s).AsString());
+	vector<RouteResult> routes;
+	RoutingEngine engine = RoutingEngine::GRAPH;
+	if (settings_.routing_settings)
+	{
+		engine = settings_.routing_settings->engine;
+		if (query_dict.count("engine"s))
+		{
+			engine = GetRoutingEngine(query_dict.at("engine"s).AsString());
+		}
+		bool use_astar = settings_.routing_settings->use_astar;
+		if (query_dict.count("astar"s))
+		{
+			use_astar = query_dict.at("astar"s).AsBool();
+		}
+		if (from && to)
+		{
+			routes = handler.GetRoutes(from, to, engine, use_astar);
+		}
+	}
+	if (routes.empty())
 	{
 		Print(Document{ Dict{ {"request_id"s, id}, {"error_message"s , "not found"s} } }, output, current_indent);
+		return;
 	}
-	else
+
+	// Последний вариант самый быстрый; для RAPTOR дополнительно выводится весь Парето-набор
+	Dict route_dict = GetRouteDict(routes.back());
+	route_dict.erase("transfer_count"s);
+	route_dict["request_id"s] = id;
+	if (engine == RoutingEngine::GRAPH && query_dict.count("instrumentation"s)
+		&& query_dict.at("instrumentation"s).AsBool())
 	{
-		Print(Document{ Dict{
-			{"curvature"s, route_info->curvature},
-			{"request_id"s, id},
-			{"route_length"s, route_info->real_length},
-			{"stop_count"s, route_info->n_stops},
-			{"unique_stop_count"s, route_info->n_unique_stops} } }, output, current_indent);
+		route_dict["settled_count"s] = static_cast<int>(routes.back().settled_count);
 	}
+	if (engine == RoutingEngine::RAPTOR)
+	{
+		Array alternatives;
+		for (const RouteResult& route : routes)
+		{
+			alternatives.emplace_back(GetRouteDict(route));
+		}
+		route_dict["alternatives"s] = move(alternatives);
+	}
+	Print(Document{ move(route_dict) }, output, current_indent);
 }
 
-void Reader::ExecuteMapRequest(const Dict& query_dict, const RequestHandler& handler, ostream& output)
+void Reader::ExecuteIsochroneRequest(const Dict& query_dict, const RequestHandler& handler, ostream& output)
 {
 	int id = query_dict.at("id"s).AsInt();
-	svg::Document svg_document = handler.RenderMap(valid_buses_);
-	ostringstream map_out;
-	svg_document.Render(map_out);
-	int current_indent = 4;
-	Print(Document{ Dict{ {"map"s, map_out.str()}, {"request_id"s , id} } }, output, current_indent);
+	int current_indent = response_indent_;
+	const Stop* from = handler.GetStop(query_dict.at("from"s).AsString());
+	if (!settings_.routing_settings || !from)
+	{
+		Print(Document{ Dict{ {"request_id"s, id}, {"error_message"s , "not found"s} } }, output, current_indent);
+		return;
+	}
+	double max_time = query_dict.at("max_time"s).AsDouble();
+	vector<pair<const Stop*, double>> reachable_stops = handler.GetReachableStops(from, max_time);
+
+	Array stops_array;
+	for (const auto& [stop, time] : reachable_stops)
+	{
+		stops_array.emplace_back(Dict{ {"stop_name"s, stop->name}, {"time"s, time} });
+	}
+	Dict response{ {"request_id"s, id}, {"stops"s, move(stops_array)} };
+	if (query_dict.count("render"s) && query_dict.at("render"s).AsBool())
+	{
+		string map;
+		svg::Writer writer(map);
+		handler.RenderIsochrone(valid_buses_, reachable_stops, writer);
+		response["map"s] = move(map);
+	}
+	Print(Document{ move(response) }, output, current_indent);
+}
+
+Dict Reader::GetRouteDict(const RouteResult& route) const
+{
+	Array items;
+	for (const RouteItem& item : route.items)
+	{
+		if (item.bus)
+		{
+			items.emplace_back(Dict{
+				{"bus"s, item.bus->name},
+				{"span_count"s, item.span_count},
+				{"time"s, item.time},
+				{"type"s, "Bus"s} });
+		}
+		else
+		{
+			items.emplace_back(Dict{
+				{"stop_name"s, item.stop->name},
+				{"time"s, item.time},
+				{"type"s, "Wait"s} });
+		}
+	}
+	return Dict{
+		{"items"s, move(items)},
+		{"total_time"s, route.total_time},
+		{"transfer_count"s, route.transfer_count} };
+}
+
+vector<const Stop*> Reader::FindStops(const Array& names, const RequestHandler& handler) const
+{
+	vector<const Stop*> stops;
+	stops.reserve(names.size());
+	for (const Node& name : names)
+	{
+		stops.push_back(handler.GetStop(name.AsString()));
+	}
+	return stops;
 }
 
 RenderSettings Reader::ParseRenderSettings()
@@ -208,9 +1284,124 @@ RenderSettings Reader::ParseRenderSettings()
 	{
 		render_settings.color_palette.emplace_back(GetColor(color_node));
 	}
+	if (render_settings_dict.count("simplify_tolerance"s))
+	{
+		render_settings.simplify_tolerance = render_settings_dict.at("simplify_tolerance"s).AsDouble();
+	}
+	if (render_settings_dict.count("hide_overlapping_labels"s))
+	{
+		render_settings.hide_overlapping_labels = render_settings_dict.at("hide_overlapping_labels"s).AsBool();
+	}
 	return render_settings;
 }
 
+optional<RoutingSettings> Reader::ParseRoutingSettings() const
+{
+	if (!requests_.count("routing_settings"s))
+	{
+		return nullopt;
+	}
+	const Dict& routing_settings_dict = requests_.at("routing_settings"s).AsMap();
+	RoutingSettings routing_settings;
+	routing_settings.bus_wait_time = routing_settings_dict.at("bus_wait_time"s).AsInt();
+	routing_settings.bus_velocity = routing_settings_dict.at("bus_velocity"s).AsDouble();
+	if (routing_settings_dict.count("engine"s))
+	{
+		routing_settings.engine = GetRoutingEngine(routing_settings_dict.at("engine"s).AsString());
+	}
+	if (routing_settings_dict.count("astar"s))
+	{
+		routing_settings.use_astar = routing_settings_dict.at("astar"s).AsBool();
+	}
+	return routing_settings;
+}
+
+RoutingEngine Reader::GetRoutingEngine(const string& engine_name) const
+{
+	if (engine_name == "raptor"s)
+	{
+		return RoutingEngine::RAPTOR;
+	}
+	else if (engine_name == "graph"s)
+	{
+		return RoutingEngine::GRAPH;
+	}
+	throw invalid_argument("unknown routing engine: "s + engine_name);
+}
+
+bool Reader::IsResponsePrecomputationEnabled() const
+{
+	if (requests_.count("execution_settings"s))
+	{
+		const Dict& execution_settings = requests_.at("execution_settings"s).AsMap();
+		if (execution_settings.count("precompute_responses"s))
+		{
+			return execution_settings.at("precompute_responses"s).AsBool();
+		}
+	}
+	// Серверу запросы заранее неизвестны; в пакетном режиме подготовка окупается,
+	// если запросов Stop и Bus не меньше, чем остановок и автобусов
+	if (!requests_.count("stat_requests"s))
+	{
+		return true;
+	}
+	const Array& stat_requests = requests_.at("stat_requests"s).AsArray();
+	size_t lookups_count = count_if(stat_requests.begin(), stat_requests.end(), [](const Node& query)
+		{
+			const string& type = query.AsMap().at("type"s).AsString();
+			return type == "Stop"s || type == "Bus"s;
+		});
+	return lookups_count >= tc_.GetStops().size() + tc_.GetBuses().size();
+}
+
+bool Reader::IsMapCacheEnabled() const
+{
+	// Серверу и конвейеру запросы заранее неизвестны; в пакетном режиме единственная карта
+	// не кэшируется, а пишется в ответ потоком
+	bool default_value = true;
+	if (requests_.count("stat_requests"s))
+	{
+		const Array& stat_requests = requests_.at("stat_requests"s).AsArray();
+		default_value = count_if(stat_requests.begin(), stat_requests.end(), [](const Node& query)
+			{
+				return query.AsMap().at("type"s).AsString() == "Map"s;
+			}) > 1;
+	}
+	return GetExecutionFlag("cache_map"s, default_value);
+}
+
+bool Reader::GetExecutionFlag(const string& key, bool default_value) const
+{
+	if (requests_.count("execution_settings"s))
+	{
+		const Dict& execution_settings = requests_.at("execution_settings"s).AsMap();
+		if (execution_settings.count(key))
+		{
+			return execution_settings.at(key).AsBool();
+		}
+	}
+	return default_value;
+}
+
+size_t Reader::GetExecutionThreadsCount() const
+{
+	if (!requests_.count("execution_settings"s) || !requests_.at("execution_settings"s).AsMap().count("threads"s))
+	{
+		return max(1u, thread::hardware_concurrency());
+	}
+	int threads = requests_.at("execution_settings"s).AsMap().at("threads"s).AsInt();
+	if (threads < 1)
+	{
+		throw invalid_argument("execution_settings.threads must be positive"s);
+	}
+	return threads;
+}
+
+const string& Reader::GetSerializationFile() const
+{
+	return requests_.at("serialization_settings"s).AsMap().at("file"s).AsString();
+}
+
 svg::Color Reader::GetColor(json::Node color_node) const
 {
 	if (color_node.IsArray())
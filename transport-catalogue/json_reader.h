@@ -4,6 +4,25 @@
 #include "json.h"
 #include "request_handler.h"
 #include "map_renderer.h"
+#include "transport_router.h"
+#include "thread_pool.h"
+#include "serialization.h"
+#include "mapped_catalogue.h"
+#include "compressed_snapshot.h"
+#include "snapshot_patch.h"
+#include "server.h"
+#include "response_fragments.h"
+#include "spsc_queue.h"
+#include "metrics.h"
+#include "trace.h"
+#include "memory_usage.h"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
 
 namespace transport::json_reader
 {
@@ -14,6 +33,41 @@ struct Queries
 	std::vector<const json::Node*> bus_queries;
 };
 
+enum class RequestKind : uint8_t
+{
+	STOP,
+	BUS,
+	MAP,
+	MAP_TILE,
+	ROUTE,
+	ISOCHRONE,
+	MATRIX,
+	STATS,
+	MEMORY,
+	UNKNOWN
+};
+
+inline const size_t REQUEST_KINDS_COUNT = static_cast<size_t>(RequestKind::UNKNOWN) + 1;
+
+inline const uint32_t OBJECT_NOT_FOUND = std::numeric_limits<uint32_t>::max();
+inline const uint32_t NOT_DUPLICATE = std::numeric_limits<uint32_t>::max();
+
+// Stat-запрос, разобранный до выполнения: тип и имя остановки или автобуса
+// проверяются один раз, а остальные параметры читаются из исходного словаря
+struct StatRequest
+{
+	RequestKind kind = RequestKind::UNKNOWN;
+	int id = 0;
+	// Для Stop и Bus — domain::Stop::id (domain::Bus::id) или номер записи неразвёрнутого
+	// отображаемого снимка; OBJECT_NOT_FOUND, если имени нет в базе
+	uint32_t object_id = OBJECT_NOT_FOUND;
+	const json::Dict* query = nullptr;
+	// Номер первого запроса пакета с тем же типом и объектом, ответ которого повторяется
+	uint32_t duplicate_of = NOT_DUPLICATE;
+	// На ответ этого запроса ссылаются следующие запросы пакета
+	bool has_duplicates = false;
+};
+
 class Reader
 {
 public:
@@ -21,28 +75,121 @@ public:
 		: tc_(tc)
 	{
 	}
-	void ReadJSON(std::istream& input);
+	// С can_stream_stat_requests и execution_settings.pipeline чтение останавливается на
+	// stat_requests: эти запросы разбираются по мере выполнения в GetResponses
+	void ReadJSON(std::istream& input, bool can_stream_stat_requests = false);
 	void ParseRequests();
 	void GetResponses(std::ostream& output);
+	// Готовит рендерер и обработчик запросов к выполнению stat-запросов; маршрутизаторы
+	// строятся обработчиком при первом запросе Route, Matrix или Isochrone.
+	// response_indent — отступ каждого ответа: 4 внутри массива ответов, 0 в режиме serve
+	void PrepareStatRequests(int response_indent = 4);
+	// Отвечает одной строкой JSON на запрос, записанный одной строкой (режим serve).
+	// Может вызываться из нескольких потоков после PrepareStatRequests(0)
+	std::string ExecuteStatRequestLine(const std::string& line);
+	// Путь к сокету и предельная длина строки-запроса из server_settings, число потоков из execution_settings
+	server::ServerSettings ParseServerSettings() const;
+	// Выводит снимок метрик в JSON, если execution_settings.metrics включает их сбор
+	void PrintMetrics(std::ostream& output) const;
+	// Выводит в JSON память контейнеров каталога, документа запросов и готовых ответов,
+	// если включён execution_settings.memory_report
+	void PrintMemoryReport(std::ostream& output) const;
+	// Сохраняет базу в файл из serialization_settings (режим make_base).
+	// При "format": "mapped" записывается снимок, читаемый через mmap без десериализации
+	void SaveBase() const;
+	// Загружает базу из файла serialization_settings вместо base_requests (режим process_requests).
+	// Отображаемый снимок только подключается; каталог строится, лишь если его требуют запросы
+	void LoadBase();
+	// Применяет patch_requests к отображаемому снимку из serialization_settings
+	// и сохраняет результат в файл patch_settings (режим apply_patch)
+	void ApplyPatch() const;
 
 private:
 	Queries ParseBaseRequests(const json::Node& base_requests);
 	std::pair<std::vector<const domain::Stop*>, std::unordered_set<std::string_view>>
 		GetStops(const json::Array& stops_array, bool is_round) const;
-	void ExecuteStatRequests(const json::Node& stat_requests,
+	// Переводит stat_requests в StatRequest; вызывается после PrepareStatRequests
+	std::vector<StatRequest> CompileStatRequests(const json::Array& stat_requests) const;
+	// Без resolve_object имя остановки или автобуса не ищется и object_id остаётся OBJECT_NOT_FOUND
+	StatRequest CompileStatRequest(const json::Dict& query_dict, bool resolve_object = true) const;
+	// Находит объекты запросов Stop и Bus пакетным поиском каталога
+	void ResolveStatRequestObjects(std::vector<StatRequest>& requests) const;
+	// Связывает повторные запросы Stop, Bus и, при кэше карты, Map с первым таким запросом пакета;
+	// возвращает число повторов
+	size_t MarkDuplicateRequests(std::vector<StatRequest>& requests) const;
+	// Ответ повторяется внутри пакета и не может быть взят из уже готовых ответов
+	// (ResponseFragments, кэш карты), поэтому выводится из буфера пакета
+	bool IsSharedWithinBatch(const StatRequest& request) const;
+	// Выполняет пакет запросов без обрамляющих скобок массива; возвращает число повторов в пакете
+	size_t ExecuteStatRequestBatch(std::vector<StatRequest>& requests, std::ostream& output);
+	// Конвейер для stat_requests, оставшихся во входном потоке: разбор, выполнение
+	// и вывод идут в отдельных потоках и обмениваются пакетами через ограниченные очереди
+	void StreamStatRequests(std::ostream& output);
+	void PrintExecutionStats(size_t requests_count, size_t duplicates_count) const;
+	void ExecuteStatRequests(const std::vector<StatRequest>& requests,
+		const transport::request_handler::RequestHandler& handler, std::ostream& output);
+	// Выполняет запросы на пуле потоков; ответы выводятся в исходном порядке и совпадают с последовательным режимом
+	void ExecuteStatRequestsParallel(const std::vector<StatRequest>& requests,
+		const transport::request_handler::RequestHandler& handler, std::ostream& output);
+	void ExecuteStatRequest(const StatRequest& request,
+		const transport::request_handler::RequestHandler& handler, std::ostream& output);
+	void ExecuteStopRequest(const StatRequest& request, std::ostream& output);
+	void ExecuteBusRequest(const StatRequest& request, std::ostream& output);
+	void ExecuteMapRequest(const StatRequest& request,
+		const transport::request_handler::RequestHandler& handler, std::ostream& output);
+	// Плитка карты по zoom/x/y или по географической области bbox
+	void ExecuteMapTileRequest(const json::Dict& query_dict,
 		const transport::request_handler::RequestHandler& handler, std::ostream& output);
-	void ExecuteStopRequest(const json::Dict& query_dict,
+	void ExecuteStatsRequest(const StatRequest& request, std::ostream& output);
+	void ExecuteMemoryRequest(const StatRequest& request, std::ostream& output) const;
+	json::Dict GetMemoryReport() const;
+	void ExecuteMatrixRequest(const json::Dict& query_dict,
 		const transport::request_handler::RequestHandler& handler, std::ostream& output);
-	void ExecuteBusRequest(const json::Dict& query_dict,
+	void ExecuteRouteRequest(const json::Dict& query_dict,
 		const transport::request_handler::RequestHandler& handler, std::ostream& output);
-	void ExecuteMapRequest(const json::Dict& query_dict,
+	void ExecuteIsochroneRequest(const json::Dict& query_dict,
 		const transport::request_handler::RequestHandler& handler, std::ostream& output);
+	json::Dict GetRouteDict(const router::RouteResult& route) const;
+	std::vector<const domain::Stop*> FindStops(const json::Array& names,
+		const transport::request_handler::RequestHandler& handler) const;
 	renderer::RenderSettings ParseRenderSettings();
+	std::optional<router::RoutingSettings> ParseRoutingSettings() const;
+	router::RoutingEngine GetRoutingEngine(const std::string& engine_name) const;
 	svg::Color GetColor(json::Node color_node) const;
+	// Число потоков из execution_settings; по умолчанию — число ядер, 1 — последовательное выполнение
+	size_t GetExecutionThreadsCount() const;
+	// execution_settings.precompute_responses; по умолчанию включается, когда подготовка окупается
+	bool IsResponsePrecomputationEnabled() const;
+	// execution_settings.cache_map; по умолчанию карта кэшируется, если запросов Map может быть несколько
+	bool IsMapCacheEnabled() const;
+	// Логический параметр execution_settings со значением по умолчанию
+	bool GetExecutionFlag(const std::string& key, bool default_value) const;
+	const std::string& GetSerializationFile() const;
+	serialization::CataloguePatch ParsePatchRequests(const json::Array& patch_requests) const;
+	// Строит каталог из отображаемого снимка один раз; безопасно вызывать из нескольких потоков
+	void MaterializeMappedBase();
+	void FillValidBuses();
 
 	TransportCatalogue& tc_;
 	json::Dict requests_;
+	std::unique_ptr<json::DictStream> stat_requests_stream_;
+	serialization::SnapshotSettings settings_;
+	std::unique_ptr<serialization::MappedCatalogue> mapped_;
+	// Stop и Bus ищутся и отвечаются из отображаемого снимка, а не из каталога. Задаётся
+	// в PrepareStatRequests и дальше не меняется, поэтому каталог можно строить во время выполнения
+	bool is_mapped_only_ = false;
+	std::once_flag materialize_flag_;
+	std::atomic<bool> is_catalogue_ready_{ false };
 	transport::sv_set valid_buses_;
+	std::unique_ptr<renderer::MapRenderer> renderer_;
+	std::unique_ptr<transport::request_handler::RequestHandler> handler_;
+	std::unique_ptr<ResponseFragments> response_fragments_;
+	std::unique_ptr<concurrent::ThreadPool> thread_pool_;
+	// Ответ Map берётся из кэша RequestHandler; иначе карта пишется в ответ потоком при каждом запросе
+	bool is_map_cached_ = true;
+	int response_indent_ = 4;
+	// Гистограммы задержек по RequestKind, заполняются в PrepareStatRequests
+	std::array<metrics::Histogram*, REQUEST_KINDS_COUNT> request_histograms_{};
 };
 
 } // namespace transport::json_reader
\ No newline at end of file
@@ -1,18 +1,95 @@
 #include "transport_catalogue.h"
 #include "json_reader.h"
 #include "svg.h"
+#include "trace.h"
 
+#include <fstream>
 #include <iostream>
+#include <string_view>
 
 using namespace std;
 using namespace std::literals;
 using namespace transport;
 
-int main()
+void PrintUsage(ostream& stream = cerr)
 {
+	stream << "Usage: transport_catalogue [make_base|process_requests|apply_patch]\n"sv
+		<< "       transport_catalogue serve <config.json>\n"sv;
+}
+
+// Загружает базу один раз и отвечает на запросы по одному в строке из stdin или сокета
+int Serve(json_reader::Reader& reader, const char* config_path)
+{
+	ifstream config(config_path);
+	if (!config)
+	{
+		cerr << "failed to open "sv << config_path << '\n';
+		return 1;
+	}
+	reader.ReadJSON(config);
+	reader.LoadBase();
+	server::Server server(reader.ParseServerSettings(), [&reader](const string& line)
+		{
+			return reader.ExecuteStatRequestLine(line);
+		});
+	reader.PrepareStatRequests(0);
+	server.Run();
+	reader.PrintMetrics(cerr);
+	reader.PrintMemoryReport(cerr);
+	trace::Tracer::Write();
+	return 0;
+}
+
+int main(int argc, char* argv[])
+{
+	if (argc == 3 && argv[1] == "serve"sv)
+	{
+		TransportCatalogue tc;
+		json_reader::Reader reader(tc);
+		return Serve(reader, argv[2]);
+	}
+	if (argc > 2)
+	{
+		PrintUsage();
+		return 1;
+	}
+
 	TransportCatalogue tc;
 	json_reader::Reader reader(tc);
-	reader.ReadJSON(cin);
-	reader.ParseRequests();
-	reader.GetResponses(cout);
+	// stat_requests при включённом конвейере читаются по мере выполнения
+	reader.ReadJSON(cin, argc == 1 || argv[1] == "process_requests"sv);
+	if (argc == 1)
+	{
+		// Без ключа база строится и запросы обрабатываются за один запуск
+		reader.ParseRequests();
+		reader.GetResponses(cout);
+		reader.PrintMetrics(cerr);
+		reader.PrintMemoryReport(cerr);
+		trace::Tracer::Write();
+		return 0;
+	}
+
+	const string_view mode(argv[1]);
+	if (mode == "make_base"sv)
+	{
+		reader.ParseRequests();
+		reader.SaveBase();
+	}
+	else if (mode == "process_requests"sv)
+	{
+		reader.LoadBase();
+		reader.GetResponses(cout);
+	}
+	else if (mode == "apply_patch"sv)
+	{
+		reader.ApplyPatch();
+	}
+	else
+	{
+		PrintUsage();
+		return 1;
+	}
+	reader.PrintMetrics(cerr);
+	reader.PrintMemoryReport(cerr);
+	trace::Tracer::Write();
 }
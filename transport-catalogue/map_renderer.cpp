@@ -1,92 +1,133 @@
 #include "map_renderer.h"
 
+#include <functional>
+#include <sstream>
+
 using namespace std;
 using namespace svg;
 using namespace renderer;
 
-RoutePolyline::RoutePolyline(vector<Point> points, Color stroke_color, double stroke_width)
-	: points_(move(points)), stroke_color_(stroke_color), stroke_width_(stroke_width)
+namespace
+{
+const Color WHITE_COLOR{ "white"s };
+const Color BLACK_COLOR{ "black"s };
+
+void WriteLabel(Writer& writer, const RenderSettings& settings, const TextAttrs& text, string_view label,
+	const Color& color)
 {
+	PathAttrs underlayer;
+	underlayer.fill_color = &settings.underlayer_color;
+	underlayer.stroke_color = &settings.underlayer_color;
+	underlayer.stroke_width = settings.underlayer_width;
+	underlayer.stroke_linecap = StrokeLineCap::ROUND;
+	underlayer.stroke_linejoin = StrokeLineJoin::ROUND;
+	writer.WriteText(text, label, underlayer);
+	PathAttrs fill;
+	fill.fill_color = &color;
+	writer.WriteText(text, label, fill);
 }
 
-void RoutePolyline::Draw(ObjectContainer& container) const
+// Квадрат расстояния от точки до отрезка a-b
+double GetSquaredDistance(Point point, Point a, Point b)
 {
-	Polyline polyline;
-	for (Point point : points_)
+	const double dx = b.x - a.x;
+	const double dy = b.y - a.y;
+	const double length2 = dx * dx + dy * dy;
+	double t = 0;
+	if (length2 > 0)
 	{
-		polyline.AddPoint(point);
+		t = clamp(((point.x - a.x) * dx + (point.y - a.y) * dy) / length2, 0.0, 1.0);
 	}
-	container.Add(polyline.SetFillColor("none"s)
-						  .SetStrokeColor(stroke_color_)
-						  .SetStrokeWidth(stroke_width_)
-						  .SetStrokeLineCap(StrokeLineCap::ROUND)
-						  .SetStrokeLineJoin(StrokeLineJoin::ROUND));
+	const double x = a.x + t * dx - point.x;
+	const double y = a.y + t * dy - point.y;
+	return x * x + y * y;
 }
+} // namespace
 
-StopCircle::StopCircle(Point center, double radius)
-	: center_(center), radius_(radius)
+vector<Point> renderer::SimplifyPolyline(const vector<Point>& points, double tolerance)
 {
+	if (points.size() < 3 || tolerance <= 0)
+	{
+		return points;
+	}
+	vector<bool> is_kept(points.size(), false);
+	is_kept.front() = true;
+	is_kept.back() = true;
+	const double tolerance2 = tolerance * tolerance;
+	// Стек участков вместо рекурсии: у длинных маршрутов она может быть глубокой
+	vector<pair<size_t, size_t>> ranges{ { 0, points.size() - 1 } };
+	while (!ranges.empty())
+	{
+		const auto [first, last] = ranges.back();
+		ranges.pop_back();
+		double max_distance2 = 0;
+		size_t farthest = first;
+		for (size_t i = first + 1; i < last; ++i)
+		{
+			const double distance2 = GetSquaredDistance(points[i], points[first], points[last]);
+			if (distance2 > max_distance2)
+			{
+				max_distance2 = distance2;
+				farthest = i;
+			}
+		}
+		if (max_distance2 > tolerance2)
+		{
+			is_kept[farthest] = true;
+			ranges.emplace_back(first, farthest);
+			ranges.emplace_back(farthest, last);
+		}
+	}
+	vector<Point> simplified;
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		if (is_kept[i])
+		{
+			simplified.push_back(points[i]);
+		}
+	}
+	return simplified;
 }
 
-void StopCircle::Draw(ObjectContainer& container) const
+void renderer::WriteRouteLine(Writer& writer, const vector<Point>& points, const Color& stroke_color,
+	double stroke_width)
 {
-	container.Add(Circle().SetCenter(center_)
-						  .SetRadius(radius_)
-						  .SetFillColor("white"s));
+	PathAttrs attrs;
+	attrs.fill_color = &NoneColor;
+	attrs.stroke_color = &stroke_color;
+	attrs.stroke_width = stroke_width;
+	attrs.stroke_linecap = StrokeLineCap::ROUND;
+	attrs.stroke_linejoin = StrokeLineJoin::ROUND;
+	writer.WritePolyline(points, attrs);
 }
 
-
-StopName::StopName(Point pos, Point offset, uint32_t font_size, string stop_name,
-	Color underlayer_color, double stroke_width)
-	: pos_(pos), offset_(offset), font_size_(font_size), stop_name_(move(stop_name)),
-		underlayer_color_(underlayer_color), stroke_width_(stroke_width)
+void renderer::WriteStopCircle(Writer& writer, Point center, double radius)
 {
+	PathAttrs attrs;
+	attrs.fill_color = &WHITE_COLOR;
+	writer.WriteCircle(center, radius, attrs);
 }
 
-void StopName::Draw(ObjectContainer& container) const
+void renderer::WriteRouteName(Writer& writer, const RenderSettings& settings, Point position,
+	string_view route_name, const Color& route_color)
 {
-	const Text base_text =
-		Text()
-		.SetPosition(pos_)
-		.SetOffset(offset_)
-		.SetFontSize(font_size_)
-		.SetFontFamily("Verdana"s)
-		.SetData(stop_name_);
-	container.Add(Text{ base_text }
-		.SetFillColor(underlayer_color_)
-		.SetStrokeColor(underlayer_color_)
-		.SetStrokeWidth(stroke_width_)
-		.SetStrokeLineCap(StrokeLineCap::ROUND)
-		.SetStrokeLineJoin(StrokeLineJoin::ROUND));
-	container.Add(Text{ base_text }
-		.SetFillColor("black"s));
+	TextAttrs text;
+	text.position = position;
+	text.offset = settings.bus_label_offset;
+	text.font_size = settings.bus_label_font_size;
+	text.font_family = "Verdana"sv;
+	text.font_weight = "bold"sv;
+	WriteLabel(writer, settings, text, route_name, route_color);
 }
 
-RouteName::RouteName(Point pos, Point offset, uint32_t font_size, string route_name,
-	Color underlayer_color, double stroke_width, Color route_color)
-	: pos_(pos), offset_(offset), font_size_(font_size), route_name_(move(route_name)),
-	underlayer_color_(underlayer_color), stroke_width_(stroke_width), route_color_(route_color)
+void renderer::WriteStopName(Writer& writer, const RenderSettings& settings, Point position, string_view stop_name)
 {
-}
-
-void RouteName::Draw(svg::ObjectContainer& container) const
-{
-	const Text base_text =
-		Text()
-		.SetPosition(pos_)
-		.SetOffset(offset_)
-		.SetFontSize(font_size_)
-		.SetFontFamily("Verdana"s)
-		.SetFontWeight("bold"s)
-		.SetData(route_name_);
-	container.Add(Text{ base_text }
-		.SetFillColor(underlayer_color_)
-		.SetStrokeColor(underlayer_color_)
-		.SetStrokeWidth(stroke_width_)
-		.SetStrokeLineCap(StrokeLineCap::ROUND)
-		.SetStrokeLineJoin(StrokeLineJoin::ROUND));
-	container.Add(Text{ base_text }
-		.SetFillColor(route_color_));
+	TextAttrs text;
+	text.position = position;
+	text.offset = settings.stop_label_offset;
+	text.font_size = settings.stop_label_font_size;
+	text.font_family = "Verdana"sv;
+	WriteLabel(writer, settings, text, stop_name, BLACK_COLOR);
 }
 
 svg::Point renderer::SphereProjector::operator()(geo::Coordinates coords) const
@@ -99,3 +140,42 @@ RenderSettings renderer::MapRenderer::GetRenderSettings() const
 {
 	return render_settings_;
 }
+
+size_t renderer::MapRenderer::GetSettingsHash() const
+{
+	return settings_hash_;
+}
+
+size_t renderer::MapRenderer::HashRenderSettings(const RenderSettings& settings)
+{
+	// Цвета хешируются в том виде, в каком попадают в SVG
+	ostringstream colors;
+	visit(ColorPrinter{ colors }, settings.underlayer_color);
+	for (const Color& color : settings.color_palette)
+	{
+		colors << ';';
+		visit(ColorPrinter{ colors }, color);
+	}
+
+	size_t hash = 0;
+	auto combine = [&hash](auto value)
+	{
+		hash ^= std::hash<decltype(value)>{}(value) + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+	};
+	combine(settings.width);
+	combine(settings.height);
+	combine(settings.padding);
+	combine(settings.line_width);
+	combine(settings.stop_radius);
+	combine(settings.bus_label_font_size);
+	combine(settings.bus_label_offset.x);
+	combine(settings.bus_label_offset.y);
+	combine(settings.stop_label_font_size);
+	combine(settings.stop_label_offset.x);
+	combine(settings.stop_label_offset.y);
+	combine(settings.underlayer_width);
+	combine(colors.str());
+	combine(settings.simplify_tolerance);
+	combine(settings.hide_overlapping_labels);
+	return hash;
+}
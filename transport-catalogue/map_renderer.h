@@ -26,8 +26,17 @@ struct RenderSettings
 	svg::Color underlayer_color;
 	double underlayer_width;
 	std::vector<svg::Color> color_palette;
+	// Уровень детализации: допуск упрощения линий маршрутов в пикселях при текущем масштабе
+	// (0 — линии выводятся через все остановки) и скрытие подписей, перекрывающих уже выведенные
+	double simplify_tolerance = 0;
+	bool hide_overlapping_labels = false;
 };
 
+inline bool IsLevelOfDetailEnabled(const RenderSettings& settings)
+{
+	return settings.simplify_tolerance > 0 || settings.hide_overlapping_labels;
+}
+
 inline bool IsZero(double value) {
 	return std::abs(value) < EPSILON;
 }
@@ -96,90 +105,37 @@ private:
 	double zoom_coeff_ = 0;
 };
 
-class RoutePolyline : public svg::Drawable
-{
-public:
-	RoutePolyline(std::vector<svg::Point> points, svg::Color stroke_color, double stroke_width);
-
-	void Draw(svg::ObjectContainer& container) const override;
-
-private:
-	std::vector<svg::Point> points_;
-	svg::Color stroke_color_;
-	double stroke_width_;
-};
-
-class StopCircle : public svg::Drawable
-{
-public:
-	StopCircle(svg::Point center, double radius);
-
-	void Draw(svg::ObjectContainer& container) const override;
-
-private:
-	svg::Point center_;
-	double radius_;
-};
-
-class RouteName : public svg::Drawable
-{
-public:
-	RouteName(svg::Point pos, svg::Point offset, uint32_t font_size, std::string route_name,
-		svg::Color underlayer_color, double stroke_width, svg::Color route_color);
-
-	void Draw(svg::ObjectContainer& container) const override;
-
-private:
-	svg::Point pos_;
-	svg::Point offset_;
-	uint32_t font_size_;
-	std::string route_name_;
-	svg::Color underlayer_color_;
-	double stroke_width_;
-	svg::Color route_color_;
-};
-
-class StopName : public svg::Drawable
-{
-public:
-	StopName(svg::Point pos, svg::Point offset, uint32_t font_size, std::string stop_name,
-		svg::Color underlayer_color, double stroke_width);
-
-	void Draw(svg::ObjectContainer& container) const override;
+// Упрощение ломаной алгоритмом Дугласа — Пекера: остаются концы и точки, без которых линия
+// отклонится больше чем на tolerance
+std::vector<svg::Point> SimplifyPolyline(const std::vector<svg::Point>& points, double tolerance);
 
-private:
-	svg::Point pos_;
-	svg::Point offset_;
-	uint32_t font_size_;
-	std::string stop_name_;
-	svg::Color underlayer_color_;
-	double stroke_width_;
-};
+// Элементы карты в порядке атрибутов прежних svg::Polyline, Circle и Text
+void WriteRouteLine(svg::Writer& writer, const std::vector<svg::Point>& points, const svg::Color& stroke_color,
+	double stroke_width);
+void WriteStopCircle(svg::Writer& writer, svg::Point center, double radius);
+// Подпись маршрута или остановки: подложка цвета underlayer_color, затем сама надпись
+void WriteRouteName(svg::Writer& writer, const RenderSettings& settings, svg::Point position,
+	std::string_view route_name, const svg::Color& route_color);
+void WriteStopName(svg::Writer& writer, const RenderSettings& settings, svg::Point position,
+	std::string_view stop_name);
 
 class MapRenderer
 {
 public:
 	MapRenderer(RenderSettings render_settings)
-		: render_settings_(std::move(render_settings))
+		: render_settings_(std::move(render_settings)), settings_hash_(HashRenderSettings(render_settings_))
 	{
 	}
 
 	RenderSettings GetRenderSettings() const;
+	// Хеш настроек отрисовки; вместе с версией каталога служит ключом кэша карты
+	size_t GetSettingsHash() const;
 
 private:
+	static size_t HashRenderSettings(const RenderSettings& settings);
+
 	RenderSettings render_settings_;
+	size_t settings_hash_;
 };
 
-template <typename Container>
-void DrawMap(const Container& container, svg::ObjectContainer& target);
-
-template<typename Container>
-void DrawMap(const Container& container, svg::ObjectContainer& target)
-{
-	for (auto it = std::begin(container); it != std::end(container); ++it)
-	{
-		(*it)->Draw(target);
-	}
-}
-
 } // namespace renderer
\ No newline at end of file
@@ -0,0 +1,548 @@
+#include "map_tiles.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+using namespace std;
+using namespace svg;
+using namespace renderer;
+
+namespace
+{
+Rect GetPointRect(Point point)
+{
+	return { point, point };
+}
+
+Rect GetSegmentRect(Point a, Point b)
+{
+	return { { min(a.x, b.x), min(a.y, b.y) }, { max(a.x, b.x), max(a.y, b.y) } };
+}
+
+// Пустой прямоугольник: такие элементы в сетку не попадают
+Rect GetEmptyRect()
+{
+	return { { 1, 1 }, { 0, 0 } };
+}
+
+bool IsEmpty(const Rect& rect)
+{
+	return rect.min.x > rect.max.x || rect.min.y > rect.max.y;
+}
+
+Rect Expand(const Rect& rect, double margin)
+{
+	return { { rect.min.x - margin, rect.min.y - margin }, { rect.max.x + margin, rect.max.y + margin } };
+}
+
+bool Intersects(const Rect& lhs, const Rect& rhs)
+{
+	return lhs.min.x <= rhs.max.x && rhs.min.x <= lhs.max.x && lhs.min.y <= rhs.max.y && rhs.min.y <= lhs.max.y;
+}
+
+bool Contains(const Rect& rect, Point point)
+{
+	return point.x >= rect.min.x && point.x <= rect.max.x && point.y >= rect.min.y && point.y <= rect.max.y;
+}
+
+Point Interpolate(Point a, Point b, double t)
+{
+	return { a.x + (b.x - a.x) * t, a.y + (b.y - a.y) * t };
+}
+
+// Из координат полной карты в координаты SVG плитки
+Point Transform(const Viewport& viewport, Point point)
+{
+	return { (point.x - viewport.rect.min.x) * viewport.scale, (point.y - viewport.rect.min.y) * viewport.scale };
+}
+
+Rect GetBounds(const vector<Rect>& items)
+{
+	Rect bounds = GetEmptyRect();
+	for (const Rect& item : items)
+	{
+		if (IsEmpty(item))
+		{
+			continue;
+		}
+		if (IsEmpty(bounds))
+		{
+			bounds = item;
+			continue;
+		}
+		bounds.min = { min(bounds.min.x, item.min.x), min(bounds.min.y, item.min.y) };
+		bounds.max = { max(bounds.max.x, item.max.x), max(bounds.max.y, item.max.y) };
+	}
+	return bounds;
+}
+} // namespace
+
+optional<Viewport> renderer::MakeTileViewport(const RenderSettings& settings, int zoom, int x, int y)
+{
+	if (zoom < 0 || zoom > MAX_TILE_ZOOM)
+	{
+		return nullopt;
+	}
+	const double tiles_count = ldexp(1.0, zoom);
+	if (x < 0 || y < 0 || x >= tiles_count || y >= tiles_count)
+	{
+		return nullopt;
+	}
+	const double tile_width = settings.width / tiles_count;
+	const double tile_height = settings.height / tiles_count;
+	Viewport viewport;
+	viewport.rect.min = { x * tile_width, y * tile_height };
+	viewport.rect.max = { (x + 1) * tile_width, (y + 1) * tile_height };
+	viewport.scale = tiles_count;
+	return viewport;
+}
+
+optional<Viewport> renderer::MakeBoundsViewport(const RenderSettings& settings, const SphereProjector& projector,
+	geo::Coordinates min, geo::Coordinates max)
+{
+	if (min.lat >= max.lat || min.lng >= max.lng)
+	{
+		return nullopt;
+	}
+	// Долгота растёт вправо, широта — вверх
+	const Point top_left = projector({ max.lat, min.lng });
+	const Point bottom_right = projector({ min.lat, max.lng });
+	const double width = bottom_right.x - top_left.x;
+	const double height = bottom_right.y - top_left.y;
+	if (IsZero(width) || IsZero(height))
+	{
+		return nullopt;
+	}
+	Viewport viewport;
+	viewport.scale = std::min(settings.width / width, settings.height / height);
+	// Область вписывается целиком, а видимым становится весь холст width x height
+	viewport.rect.min = top_left;
+	viewport.rect.max = { top_left.x + settings.width / viewport.scale, top_left.y + settings.height / viewport.scale };
+	return viewport;
+}
+
+optional<pair<double, double>> renderer::ClipSegment(Point a, Point b, const Rect& rect)
+{
+	const double dx = b.x - a.x;
+	const double dy = b.y - a.y;
+	// Для каждой стороны: p * t <= q, пока точка a + t * (b - a) по внутреннюю сторону
+	const double p[] = { -dx, dx, -dy, dy };
+	const double q[] = { a.x - rect.min.x, rect.max.x - a.x, a.y - rect.min.y, rect.max.y - a.y };
+	double enter = 0;
+	double exit = 1;
+	for (size_t side = 0; side < 4; ++side)
+	{
+		if (p[side] == 0)
+		{
+			if (q[side] < 0)
+			{
+				return nullopt;
+			}
+			continue;
+		}
+		const double t = q[side] / p[side];
+		if (p[side] < 0)
+		{
+			enter = max(enter, t);
+		}
+		else
+		{
+			exit = std::min(exit, t);
+		}
+		if (enter > exit)
+		{
+			return nullopt;
+		}
+	}
+	return pair{ enter, exit };
+}
+
+renderer::GridIndex::GridIndex(const Rect& bounds, const vector<Rect>& items)
+	: bounds_(bounds)
+{
+	if (IsEmpty(bounds))
+	{
+		return;
+	}
+	const double width = max(bounds.max.x - bounds.min.x, EPSILON);
+	const double height = max(bounds.max.y - bounds.min.y, EPSILON);
+	const double cells = clamp<double>(static_cast<double>(items.size() / ITEMS_PER_CELL), 1, MAX_CELLS);
+	columns_ = clamp<size_t>(static_cast<size_t>(sqrt(cells * width / height)), 1, MAX_CELLS);
+	rows_ = clamp<size_t>(static_cast<size_t>(cells / columns_), 1, MAX_CELLS / columns_);
+	cell_width_ = width / columns_;
+	cell_height_ = height / rows_;
+
+	// Два прохода: число элементов в ячейках, затем раскладка по смещениям
+	cell_offsets_.assign(columns_ * rows_ + 1, 0);
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (uint32_t id = 0; id < items.size(); ++id)
+		{
+			const Rect& item = items[id];
+			if (IsEmpty(item))
+			{
+				continue;
+			}
+			const size_t last_column = GetColumn(item.max.x);
+			const size_t last_row = GetRow(item.max.y);
+			for (size_t row = GetRow(item.min.y); row <= last_row; ++row)
+			{
+				for (size_t column = GetColumn(item.min.x); column <= last_column; ++column)
+				{
+					const size_t cell = row * columns_ + column;
+					if (pass == 0)
+					{
+						++cell_offsets_[cell + 1];
+					}
+					else
+					{
+						ids_[cell_offsets_[cell]++] = id;
+					}
+				}
+			}
+		}
+		if (pass == 0)
+		{
+			for (size_t cell = 1; cell < cell_offsets_.size(); ++cell)
+			{
+				cell_offsets_[cell] += cell_offsets_[cell - 1];
+			}
+			ids_.resize(cell_offsets_.back());
+		}
+	}
+	// Второй проход сдвинул каждое смещение на начало следующей ячейки
+	for (size_t cell = cell_offsets_.size() - 1; cell > 0; --cell)
+	{
+		cell_offsets_[cell] = cell_offsets_[cell - 1];
+	}
+	cell_offsets_[0] = 0;
+}
+
+void renderer::GridIndex::Query(const Rect& rect, vector<uint32_t>& ids) const
+{
+	ids.clear();
+	if (columns_ == 0 || rect.max.x < bounds_.min.x || rect.max.y < bounds_.min.y
+		|| rect.min.x > bounds_.max.x || rect.min.y > bounds_.max.y)
+	{
+		return;
+	}
+	const size_t last_column = GetColumn(rect.max.x);
+	const size_t last_row = GetRow(rect.max.y);
+	for (size_t row = GetRow(rect.min.y); row <= last_row; ++row)
+	{
+		const size_t row_begin = row * columns_;
+		ids.insert(ids.end(), ids_.begin() + cell_offsets_[row_begin + GetColumn(rect.min.x)],
+			ids_.begin() + cell_offsets_[row_begin + last_column + 1]);
+	}
+	sort(ids.begin(), ids.end());
+	ids.erase(unique(ids.begin(), ids.end()), ids.end());
+}
+
+size_t renderer::GridIndex::GetColumn(double x) const
+{
+	return static_cast<size_t>(clamp((x - bounds_.min.x) / cell_width_, 0.0, static_cast<double>(columns_ - 1)));
+}
+
+size_t renderer::GridIndex::GetRow(double y) const
+{
+	return static_cast<size_t>(clamp((y - bounds_.min.y) / cell_height_, 0.0, static_cast<double>(rows_ - 1)));
+}
+
+renderer::TileIndex::TileIndex(RenderSettings settings, SphereProjector projector, const vector<Route>& routes,
+	vector<Stop> stops)
+	: settings_(move(settings)), projector_(projector), stops_(move(stops))
+{
+	Level full_level;
+	for (uint32_t route_id = 0; route_id < routes.size(); ++route_id)
+	{
+		const Route& route = routes[route_id];
+		route_names_.push_back(route.name);
+		full_level.route_offsets.push_back(static_cast<uint32_t>(full_level.points.size()));
+		full_level.points.insert(full_level.points.end(), route.points.begin(), route.points.end());
+		for (Point position : route.label_positions)
+		{
+			route_labels_.emplace_back(route_id, position);
+		}
+	}
+	full_level.route_offsets.push_back(static_cast<uint32_t>(full_level.points.size()));
+	IndexSegments(full_level);
+	full_level_ = make_shared<Level>(move(full_level));
+
+	for (string_view name : route_names_)
+	{
+		route_label_margin_ = max(route_label_margin_,
+			GetLabelMargin(name, settings_.bus_label_font_size, settings_.bus_label_offset));
+	}
+	for (const Stop& stop : stops_)
+	{
+		stop_label_margin_ = max(stop_label_margin_,
+			GetLabelMargin(stop.name, settings_.stop_label_font_size, settings_.stop_label_offset));
+	}
+
+	vector<Rect> items;
+	for (const auto& [route_id, position] : route_labels_)
+	{
+		items.push_back(GetPointRect(position));
+	}
+	route_labels_index_ = GridIndex(GetBounds(items), items);
+
+	items.clear();
+	for (const Stop& stop : stops_)
+	{
+		items.push_back(GetPointRect(stop.position));
+	}
+	stops_index_ = GridIndex(GetBounds(items), items);
+}
+
+void renderer::TileIndex::WriteTile(const Viewport& viewport, Writer& writer) const
+{
+	const shared_ptr<const Level> level = GetLevel(viewport);
+	vector<uint32_t> ids;
+	writer.BeginDocument();
+	WriteRouteLines(viewport, *level, writer, ids);
+	WriteRouteNames(viewport, *level, writer, ids);
+	WriteStops(viewport, writer, ids);
+	WriteStopsNames(viewport, *level, writer, ids);
+	writer.EndDocument();
+}
+
+shared_ptr<const TileIndex::Level> renderer::TileIndex::GetLevel(const Viewport& viewport) const
+{
+	if (!IsLevelOfDetailEnabled(settings_))
+	{
+		return full_level_;
+	}
+	// Плитки между степенями двойки получают уровень меньшего zoom, то есть с меньшим допуском
+	const int zoom = viewport.scale < 1 ? 0 : min(static_cast<int>(floor(log2(viewport.scale))), MAX_TILE_ZOOM);
+	lock_guard lock(levels_mutex_);
+	if (!levels_[zoom])
+	{
+		levels_[zoom] = make_shared<Level>(BuildLevel(zoom));
+	}
+	return levels_[zoom];
+}
+
+renderer::TileIndex::Level renderer::TileIndex::BuildLevel(int zoom) const
+{
+	const double scale = ldexp(1.0, zoom);
+	const Level& full_level = *full_level_;
+	Level level;
+	vector<Point> route_points;
+	for (size_t route_id = 0; route_id + 1 < full_level.route_offsets.size(); ++route_id)
+	{
+		const auto begin = full_level.points.begin() + full_level.route_offsets[route_id];
+		const auto end = full_level.points.begin() + full_level.route_offsets[route_id + 1];
+		route_points.assign(begin, end);
+		// Некольцевой маршрут возвращается по своим же точкам: обратный путь совпадает с прямым
+		if (route_points.size() % 2 == 1 && equal(begin, end, make_reverse_iterator(end), [](Point lhs, Point rhs)
+			{
+				return lhs.x == rhs.x && lhs.y == rhs.y;
+			}))
+		{
+			route_points.resize(route_points.size() / 2 + 1);
+		}
+		const vector<Point> simplified = SimplifyPolyline(route_points, settings_.simplify_tolerance / scale);
+		level.route_offsets.push_back(static_cast<uint32_t>(level.points.size()));
+		level.points.insert(level.points.end(), simplified.begin(), simplified.end());
+	}
+	level.route_offsets.push_back(static_cast<uint32_t>(level.points.size()));
+	IndexSegments(level);
+	if (settings_.hide_overlapping_labels)
+	{
+		HideOverlappingLabels(scale, level);
+	}
+	return level;
+}
+
+void renderer::TileIndex::IndexSegments(Level& level)
+{
+	// Отрезок с номером последней точки маршрута не существует
+	vector<Rect> items(level.points.size(), GetEmptyRect());
+	for (size_t route_id = 0; route_id + 1 < level.route_offsets.size(); ++route_id)
+	{
+		for (uint32_t point = level.route_offsets[route_id]; point + 1 < level.route_offsets[route_id + 1]; ++point)
+		{
+			items[point] = GetSegmentRect(level.points[point], level.points[point + 1]);
+		}
+	}
+	level.segments_index = GridIndex(GetBounds(items), items);
+}
+
+void renderer::TileIndex::HideOverlappingLabels(double scale, Level& level) const
+{
+	vector<Rect> boxes;
+	boxes.reserve(route_labels_.size() + stops_.size());
+	for (const auto& [route_id, position] : route_labels_)
+	{
+		boxes.push_back(GetLabelBox(position, route_names_[route_id], settings_.bus_label_font_size,
+			settings_.bus_label_offset, scale));
+	}
+	for (const Stop& stop : stops_)
+	{
+		boxes.push_back(GetLabelBox(stop.position, stop.name, settings_.stop_label_font_size,
+			settings_.stop_label_offset, scale));
+	}
+	// Сетка только из выведенных подписей с ячейкой не меньше самой большой подписи:
+	// прямоугольник подписи задевает не больше четырёх ячеек
+	double cell_size = EPSILON;
+	for (const Rect& box : boxes)
+	{
+		cell_size = max({ cell_size, box.max.x - box.min.x, box.max.y - box.min.y });
+	}
+	unordered_map<uint64_t, vector<uint32_t>> visible_cells;
+	auto get_cell = [cell_size](double x, double y)
+		{
+			return (static_cast<uint64_t>(static_cast<uint32_t>(static_cast<int32_t>(floor(x / cell_size)))) << 32)
+				| static_cast<uint32_t>(static_cast<int32_t>(floor(y / cell_size)));
+		};
+	vector<bool> is_visible(boxes.size(), false);
+	for (uint32_t label = 0; label < boxes.size(); ++label)
+	{
+		const Rect& box = boxes[label];
+		const uint64_t cells[] = { get_cell(box.min.x, box.min.y), get_cell(box.max.x, box.min.y),
+			get_cell(box.min.x, box.max.y), get_cell(box.max.x, box.max.y) };
+		const bool is_overlapping = any_of(begin(cells), end(cells), [&](uint64_t cell)
+			{
+				const auto it = visible_cells.find(cell);
+				return it != visible_cells.end() && any_of(it->second.begin(), it->second.end(), [&](uint32_t other)
+					{
+						return Intersects(boxes[other], box);
+					});
+			});
+		if (is_overlapping)
+		{
+			continue;
+		}
+		is_visible[label] = true;
+		for (size_t i = 0; i < size(cells); ++i)
+		{
+			// Углы в одной ячейке дают одинаковые номера
+			if (find(begin(cells), begin(cells) + i, cells[i]) == begin(cells) + i)
+			{
+				visible_cells[cells[i]].push_back(label);
+			}
+		}
+	}
+	level.is_route_label_visible.assign(is_visible.begin(), is_visible.begin() + route_labels_.size());
+	level.is_stop_label_visible.assign(is_visible.begin() + route_labels_.size(), is_visible.end());
+}
+
+Rect renderer::TileIndex::GetLabelBox(Point position, string_view text, int font_size, Point offset,
+	double scale, double char_width) const
+{
+	// Метрик шрифта нет: символ Verdana в среднем шириной около 0,6 кегля, над базовой линией — кегль,
+	// под ней — четверть; подложка расширяет надпись на половину своей толщины
+	const size_t chars_count = count_if(text.begin(), text.end(), [](char c)
+		{
+			return (static_cast<unsigned char>(c) & 0xC0) != 0x80;
+		});
+	const double half_underlayer = settings_.underlayer_width / 2;
+	const Point min{ offset.x - half_underlayer, offset.y - font_size - half_underlayer };
+	const Point max{ offset.x + chars_count * font_size * char_width + half_underlayer,
+		offset.y + font_size / 4.0 + half_underlayer };
+	return { { position.x + min.x / scale, position.y + min.y / scale },
+		{ position.x + max.x / scale, position.y + max.y / scale } };
+}
+
+void renderer::TileIndex::WriteRouteLines(const Viewport& viewport, const Level& level, Writer& writer,
+	vector<uint32_t>& ids) const
+{
+	// Линия обрезается с запасом в толщину, чтобы скруглённые концы у края плитки остались за её пределами
+	const Rect rect = Expand(viewport.rect, settings_.line_width / viewport.scale);
+	level.segments_index.Query(rect, ids);
+	vector<Point> points;
+	size_t route_id = 0;
+	// Точка, на которой закончилась ломаная, если отрезок дошёл до конца, не выходя из плитки
+	optional<uint32_t> open_end;
+	auto flush = [&]
+		{
+			if (points.size() > 1)
+			{
+				WriteRouteLine(writer, points, settings_.color_palette[route_id % settings_.color_palette.size()],
+					settings_.line_width);
+			}
+			points.clear();
+			open_end.reset();
+		};
+	for (uint32_t segment : ids)
+	{
+		const Point a = level.points[segment];
+		const Point b = level.points[segment + 1];
+		const optional<pair<double, double>> clipped = ClipSegment(a, b, rect);
+		if (!clipped)
+		{
+			continue;
+		}
+		const size_t segment_route = static_cast<size_t>(upper_bound(level.route_offsets.begin(),
+			level.route_offsets.end(), segment) - level.route_offsets.begin() - 1);
+		const auto [enter, exit] = *clipped;
+		if (segment_route != route_id || open_end != segment || enter > 0)
+		{
+			flush();
+			route_id = segment_route;
+			points.push_back(Transform(viewport, Interpolate(a, b, enter)));
+		}
+		points.push_back(Transform(viewport, Interpolate(a, b, exit)));
+		if (exit >= 1)
+		{
+			open_end = segment + 1;
+		}
+		else
+		{
+			flush();
+		}
+	}
+	flush();
+}
+
+void renderer::TileIndex::WriteRouteNames(const Viewport& viewport, const Level& level, Writer& writer,
+	vector<uint32_t>& ids) const
+{
+	const Rect rect = Expand(viewport.rect, route_label_margin_ / viewport.scale);
+	route_labels_index_.Query(rect, ids);
+	for (uint32_t label : ids)
+	{
+		const auto& [route_id, position] = route_labels_[label];
+		if (Contains(rect, position)
+			&& (level.is_route_label_visible.empty() || level.is_route_label_visible[label]))
+		{
+			WriteRouteName(writer, settings_, Transform(viewport, position), route_names_[route_id],
+				settings_.color_palette[route_id % settings_.color_palette.size()]);
+		}
+	}
+}
+
+void renderer::TileIndex::WriteStops(const Viewport& viewport, Writer& writer, vector<uint32_t>& ids) const
+{
+	const Rect rect = Expand(viewport.rect, settings_.stop_radius / viewport.scale);
+	stops_index_.Query(rect, ids);
+	for (uint32_t stop : ids)
+	{
+		if (Contains(rect, stops_[stop].position))
+		{
+			WriteStopCircle(writer, Transform(viewport, stops_[stop].position), settings_.stop_radius);
+		}
+	}
+}
+
+void renderer::TileIndex::WriteStopsNames(const Viewport& viewport, const Level& level, Writer& writer,
+	vector<uint32_t>& ids) const
+{
+	const Rect rect = Expand(viewport.rect, stop_label_margin_ / viewport.scale);
+	stops_index_.Query(rect, ids);
+	for (uint32_t stop : ids)
+	{
+		if (Contains(rect, stops_[stop].position)
+			&& (level.is_stop_label_visible.empty() || level.is_stop_label_visible[stop]))
+		{
+			WriteStopName(writer, settings_, Transform(viewport, stops_[stop].position), stops_[stop].name);
+		}
+	}
+}
+
+double renderer::TileIndex::GetLabelMargin(string_view text, int font_size, Point offset) const
+{
+	const Rect box = GetLabelBox({ 0, 0 }, text, font_size, offset, 1, MAX_CHAR_WIDTH);
+	return max({ -box.min.x, -box.min.y, box.max.x, box.max.y, 0.0 });
+}
@@ -0,0 +1,173 @@
+#pragma once
+
+#include "map_renderer.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace renderer
+{
+
+// Прямоугольник в координатах полной карты
+struct Rect
+{
+	svg::Point min;
+	svg::Point max;
+};
+
+// Видимая часть карты: прямоугольник полной карты, который выводится с увеличением scale
+// так, что его левый верхний угол становится началом координат SVG
+struct Viewport
+{
+	Rect rect;
+	double scale = 1;
+};
+
+inline const int MAX_TILE_ZOOM = 30;
+
+// Плитка zoom/x/y: полная карта width x height делится на 2^zoom x 2^zoom плиток того же размера в пикселях.
+// nullopt, если zoom или номер плитки вне допустимых значений
+std::optional<Viewport> MakeTileViewport(const RenderSettings& settings, int zoom, int x, int y);
+// Область между углами min (юго-запад) и max (северо-восток), вписанная в width x height.
+// nullopt для пустой или вырожденной области
+std::optional<Viewport> MakeBoundsViewport(const RenderSettings& settings, const SphereProjector& projector,
+	geo::Coordinates min, geo::Coordinates max);
+
+// Часть отрезка a-b внутри rect (алгоритм Лианга — Барски): параметры входа и выхода на отрезке от 0 до 1
+std::optional<std::pair<double, double>> ClipSegment(svg::Point a, svg::Point b, const Rect& rect);
+
+/*
+* Равномерная сетка над прямоугольниками элементов. Элемент записывается во все ячейки,
+* которые пересекает его прямоугольник; номер элемента — его позиция в items
+*/
+class GridIndex
+{
+public:
+	GridIndex() = default;
+	GridIndex(const Rect& bounds, const std::vector<Rect>& items);
+
+	// Номера элементов из ячеек, пересекающих rect, по возрастанию и без повторов.
+	// Это кандидаты: точную проверку пересечения выполняет вызывающий
+	void Query(const Rect& rect, std::vector<uint32_t>& ids) const;
+
+private:
+	static constexpr size_t ITEMS_PER_CELL = 4;
+	static constexpr size_t MAX_CELLS = 1 << 20;
+
+	size_t GetColumn(double x) const;
+	size_t GetRow(double y) const;
+
+	Rect bounds_;
+	size_t columns_ = 0;
+	size_t rows_ = 0;
+	double cell_width_ = 1;
+	double cell_height_ = 1;
+	// Элементы ячейки i — ids_[cell_offsets_[i]..cell_offsets_[i + 1])
+	std::vector<uint32_t> cell_offsets_;
+	std::vector<uint32_t> ids_;
+};
+
+/*
+* Геометрия карты в координатах полной карты с пространственными индексами отрезков маршрутов,
+* подписей и остановок. Плитка выводит только попадающие в неё элементы, поэтому время отрисовки
+* зависит от содержимого плитки, а не от размера каталога. Слои и атрибуты те же, что у карты Map.
+* С уровнем детализации (IsLevelOfDetailEnabled) линии упрощаются, а подписи прореживаются
+* под масштаб плитки; результат запоминается для каждого zoom
+*/
+class TileIndex
+{
+public:
+	struct Route
+	{
+		std::string_view name;
+		std::vector<svg::Point> points;
+		// Точки подписей названия маршрута
+		std::vector<svg::Point> label_positions;
+	};
+
+	struct Stop
+	{
+		std::string_view name;
+		svg::Point position;
+	};
+
+	// routes — в порядке маршрутов карты (от него зависит цвет), stops — в порядке имён;
+	// точки уже спроецированы projector
+	TileIndex(RenderSettings settings, SphereProjector projector, const std::vector<Route>& routes,
+		std::vector<Stop> stops);
+
+	const RenderSettings& GetRenderSettings() const
+	{
+		return settings_;
+	}
+	const SphereProjector& GetProjector() const
+	{
+		return projector_;
+	}
+
+	void WriteTile(const Viewport& viewport, svg::Writer& writer) const;
+
+private:
+	// Линии маршрутов одного уровня детализации с индексом отрезков и видимость подписей
+	struct Level
+	{
+		// Точки маршрута i — points[route_offsets[i]..route_offsets[i + 1]); номер отрезка — номер его начальной точки
+		std::vector<uint32_t> route_offsets;
+		std::vector<svg::Point> points;
+		GridIndex segments_index;
+		// Пусты, если перекрывающиеся подписи не скрываются
+		std::vector<bool> is_route_label_visible;
+		std::vector<bool> is_stop_label_visible;
+	};
+
+	// Средняя ширина символа Verdana в кеглях для оценки размера подписи
+	static constexpr double AVERAGE_CHAR_WIDTH = 0.6;
+	// Ширина самого широкого символа Verdana в кеглях: запас вокруг плитки для подписей
+	// не должен быть меньше подписи из одних широких букв
+	static constexpr double MAX_CHAR_WIDTH = 1.0;
+
+	// Уровень для масштаба viewport: zoom — целая часть log2(scale)
+	std::shared_ptr<const Level> GetLevel(const Viewport& viewport) const;
+	Level BuildLevel(int zoom) const;
+	static void IndexSegments(Level& level);
+	// Подписи выводятся жадно в порядке карты (сначала маршруты, затем остановки),
+	// а подпись, перекрывающая уже выведенную при масштабе scale, скрывается
+	void HideOverlappingLabels(double scale, Level& level) const;
+	Rect GetLabelBox(svg::Point position, std::string_view text, int font_size, svg::Point offset,
+		double scale, double char_width = AVERAGE_CHAR_WIDTH) const;
+	// Насколько подпись может выйти за точку привязки, в пикселях при любом масштабе
+	double GetLabelMargin(std::string_view text, int font_size, svg::Point offset) const;
+
+	void WriteRouteLines(const Viewport& viewport, const Level& level, svg::Writer& writer,
+		std::vector<uint32_t>& ids) const;
+	void WriteRouteNames(const Viewport& viewport, const Level& level, svg::Writer& writer,
+		std::vector<uint32_t>& ids) const;
+	void WriteStops(const Viewport& viewport, svg::Writer& writer, std::vector<uint32_t>& ids) const;
+	void WriteStopsNames(const Viewport& viewport, const Level& level, svg::Writer& writer,
+		std::vector<uint32_t>& ids) const;
+
+	RenderSettings settings_;
+	SphereProjector projector_;
+	std::vector<std::string_view> route_names_;
+	// Номер маршрута и точка подписи
+	std::vector<std::pair<uint32_t, svg::Point>> route_labels_;
+	std::vector<Stop> stops_;
+	// Запас вокруг плитки, в который попадают точки привязки всех подписей, задевающих плитку:
+	// самый большой выход подписи маршрута и остановки за свою точку
+	double route_label_margin_ = 0;
+	double stop_label_margin_ = 0;
+	GridIndex route_labels_index_;
+	GridIndex stops_index_;
+	// Линии через все остановки; используются без уровня детализации
+	std::shared_ptr<const Level> full_level_;
+	mutable std::mutex levels_mutex_;
+	mutable std::array<std::shared_ptr<const Level>, MAX_TILE_ZOOM + 1> levels_;
+};
+
+} // namespace renderer
@@ -0,0 +1,398 @@
+#include "mapped_catalogue.h"
+#include "mapped_layout.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace transport;
+using namespace transport::serialization;
+using namespace domain;
+
+namespace
+{
+void CheckSnapshot(bool condition)
+{
+	if (!condition)
+	{
+		throw SerializationError("mapped snapshot is corrupted"s);
+	}
+}
+
+bool IsPowerOfTwo(uint32_t value)
+{
+	return value > 0 && (value & (value - 1)) == 0;
+}
+
+// Смещения CSR начинаются с нуля и не убывают, поэтому каждая строка лежит внутри секции значений
+void CheckCsrOffsets(const uint32_t* index, uint32_t rows)
+{
+	CheckSnapshot(index[0] == 0);
+	for (uint32_t row = 0; row < rows; ++row)
+	{
+		CheckSnapshot(index[row] <= index[row + 1]);
+	}
+}
+
+void CheckIds(const uint32_t* first, const uint32_t* last, uint32_t count)
+{
+	CheckSnapshot(all_of(first, last, [count](uint32_t id)
+		{
+			return id < count;
+		}));
+}
+
+// В слотах — пусто или id + 1 существующей записи, и хотя бы один слот пуст, иначе поиск
+// отсутствующего имени не остановится
+void CheckHashTable(const uint32_t* slots, uint32_t capacity, uint32_t count)
+{
+	bool has_empty_slot = false;
+	for (uint32_t slot = 0; slot < capacity; ++slot)
+	{
+		has_empty_slot = has_empty_slot || slots[slot] == EMPTY_SLOT;
+		CheckSnapshot(slots[slot] <= count);
+	}
+	CheckSnapshot(has_empty_slot);
+}
+} // namespace
+
+void transport::serialization::SaveMappedCatalogue(const TransportCatalogue& tc, const SnapshotSettings& settings,
+	ostream& output)
+{
+	const deque<Stop>& stops = tc.GetStops();
+	const deque<Bus>& buses = tc.GetBuses();
+	unordered_map<const Stop*, uint32_t> stop_to_index;
+	unordered_map<string_view, uint32_t> bus_to_index;
+
+	string strings;
+	auto add_string = [&strings](string_view str)
+	{
+		uint32_t offset = strings.size();
+		strings.append(str);
+		return offset;
+	};
+
+	vector<MappedStop> stop_records;
+	stop_records.reserve(stops.size());
+	for (const Stop& stop : stops)
+	{
+		stop_to_index[&stop] = stop_records.size();
+		stop_records.push_back({ add_string(stop.name), static_cast<uint32_t>(stop.name.size()), 0, 0,
+			stop.coordinates.lat, stop.coordinates.lng });
+	}
+
+	vector<MappedBus> bus_records;
+	vector<uint32_t> bus_stops_index{ 0 };
+	vector<uint32_t> bus_stops;
+	bus_records.reserve(buses.size());
+	for (const Bus& bus : buses)
+	{
+		bus_to_index[bus.name] = bus_records.size();
+		RouteInfo route_info = tc.GetRouteInfo(&bus);
+		bus_records.push_back({ add_string(bus.name), static_cast<uint32_t>(bus.name.size()), bus.is_round,
+			route_info.n_stops, route_info.n_unique_stops, 0, route_info.real_length, route_info.curvature });
+		for (const Stop* stop : bus.stops)
+		{
+			bus_stops.push_back(stop_to_index.at(stop));
+		}
+		bus_stops_index.push_back(bus_stops.size());
+	}
+
+	vector<uint32_t> stop_buses_index{ 0 };
+	vector<uint32_t> stop_buses;
+	for (const Stop& stop : stops)
+	{
+		if (const sv_set* stop_buses_names = tc.GetStopToBuses(&stop))
+		{
+			for (string_view bus_name : *stop_buses_names)
+			{
+				stop_buses.push_back(bus_to_index.at(bus_name));
+			}
+		}
+		stop_buses_index.push_back(stop_buses.size());
+	}
+
+	vector<vector<MappedDistance>> distances_by_stop(stops.size());
+	for (const auto& [stop_pair, distance] : tc.GetDistances())
+	{
+		distances_by_stop[stop_to_index.at(stop_pair.first)].push_back({ stop_to_index.at(stop_pair.second), distance });
+	}
+	vector<uint32_t> distances_index{ 0 };
+	vector<MappedDistance> distances;
+	for (vector<MappedDistance>& stop_distances : distances_by_stop)
+	{
+		sort(stop_distances.begin(), stop_distances.end(), [](const MappedDistance& lhs, const MappedDistance& rhs)
+			{
+				return lhs.to < rhs.to;
+			});
+		distances.insert(distances.end(), stop_distances.begin(), stop_distances.end());
+		distances_index.push_back(distances.size());
+	}
+
+	MappedHeader header{};
+	memcpy(header.magic, MAPPED_MAGIC, sizeof(MAPPED_MAGIC));
+	header.version = MAPPED_VERSION;
+	header.stop_count = stop_records.size();
+	header.bus_count = bus_records.size();
+	header.stop_hash_capacity = GetHashCapacity(stop_records.size());
+	header.bus_hash_capacity = GetHashCapacity(bus_records.size());
+	vector<uint32_t> stop_hash = BuildHashTable(header.stop_count, header.stop_hash_capacity,
+		[&stop_records](uint32_t id) { return stop_records[id]; },
+		[&stops](uint32_t id) { return string_view{ stops[id].name }; });
+	vector<uint32_t> bus_hash = BuildHashTable(header.bus_count, header.bus_hash_capacity,
+		[&bus_records](uint32_t id) { return bus_records[id]; },
+		[&buses](uint32_t id) { return string_view{ buses[id].name }; });
+	ostringstream settings_out;
+	SaveSettings(settings, settings_out);
+	string settings_blob = settings_out.str();
+
+	SectionWriter writer;
+	writer.Append(reinterpret_cast<const char*>(&header), sizeof(header));
+	header.strings_offset = writer.Append(strings.data(), strings.size());
+	header.strings_size = strings.size();
+	header.stops_offset = writer.Append(stop_records);
+	header.buses_offset = writer.Append(bus_records);
+	header.stop_hash_offset = writer.Append(stop_hash);
+	header.bus_hash_offset = writer.Append(bus_hash);
+	header.stop_buses_index_offset = writer.Append(stop_buses_index);
+	header.stop_buses_offset = writer.Append(stop_buses);
+	header.bus_stops_index_offset = writer.Append(bus_stops_index);
+	header.bus_stops_offset = writer.Append(bus_stops);
+	header.distances_index_offset = writer.Append(distances_index);
+	header.distances_offset = writer.Append(distances);
+	header.settings_offset = writer.Append(settings_blob.data(), settings_blob.size());
+	header.settings_size = settings_blob.size();
+	header.file_size = writer.GetBuffer().size();
+	memcpy(writer.GetBuffer().data(), &header, sizeof(header));
+
+	output.write(writer.GetBuffer().data(), writer.GetBuffer().size());
+	if (!output)
+	{
+		throw SerializationError("failed to write snapshot"s);
+	}
+}
+
+bool transport::serialization::IsMappedSnapshot(const string& path)
+{
+	ifstream input(path, ios::binary);
+	char magic[sizeof(MAPPED_MAGIC)];
+	return input.read(magic, sizeof(magic)) && memcmp(magic, MAPPED_MAGIC, sizeof(magic)) == 0;
+}
+
+MappedCatalogue::MappedCatalogue(const string& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		throw runtime_error("failed to open "s + path);
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(MappedHeader))
+	{
+		close(fd);
+		throw SerializationError("not a mapped catalogue snapshot"s);
+	}
+	size_ = file_stat.st_size;
+	void* data = mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+	{
+		throw runtime_error("failed to map "s + path);
+	}
+	data_ = static_cast<const char*>(data);
+
+	try
+	{
+		header_ = reinterpret_cast<const MappedHeader*>(data_);
+		CheckSnapshot(memcmp(header_->magic, MAPPED_MAGIC, sizeof(MAPPED_MAGIC)) == 0);
+		CheckSnapshot(header_->version == MAPPED_VERSION && header_->file_size == size_);
+		CheckSnapshot(IsPowerOfTwo(header_->stop_hash_capacity) && IsPowerOfTwo(header_->bus_hash_capacity));
+		const uint32_t stop_count = header_->stop_count;
+		const uint32_t bus_count = header_->bus_count;
+		strings_ = GetSection<char>(header_->strings_offset, header_->strings_size);
+		stops_ = GetSection<MappedStop>(header_->stops_offset, stop_count);
+		buses_ = GetSection<MappedBus>(header_->buses_offset, bus_count);
+		stop_hash_ = GetSection<uint32_t>(header_->stop_hash_offset, header_->stop_hash_capacity);
+		bus_hash_ = GetSection<uint32_t>(header_->bus_hash_offset, header_->bus_hash_capacity);
+		stop_buses_index_ = GetSection<uint32_t>(header_->stop_buses_index_offset, stop_count + 1ull);
+		stop_buses_ = GetSection<uint32_t>(header_->stop_buses_offset, stop_buses_index_[stop_count]);
+		bus_stops_index_ = GetSection<uint32_t>(header_->bus_stops_index_offset, bus_count + 1ull);
+		bus_stops_ = GetSection<uint32_t>(header_->bus_stops_offset, bus_stops_index_[bus_count]);
+		distances_index_ = GetSection<uint32_t>(header_->distances_index_offset, stop_count + 1ull);
+		distances_ = GetSection<MappedDistance>(header_->distances_offset, distances_index_[stop_count]);
+		GetSection<char>(header_->settings_offset, header_->settings_size);
+	}
+	catch (...)
+	{
+		munmap(const_cast<char*>(data_), size_);
+		throw;
+	}
+}
+
+MappedCatalogue::~MappedCatalogue()
+{
+	munmap(const_cast<char*>(data_), size_);
+}
+
+optional<uint32_t> MappedCatalogue::FindStop(string_view stop_name) const
+{
+	const uint32_t mask = header_->stop_hash_capacity - 1;
+	size_t slot = HashName(stop_name) & mask;
+	// Таблица без пустого слота — повреждённый снимок: поиск отсутствующего имени обходит её один раз
+	for (uint32_t probes = 0; stop_hash_[slot] != EMPTY_SLOT; slot = (slot + 1) & mask)
+	{
+		CheckSnapshot(probes++ <= mask);
+		uint32_t stop = stop_hash_[slot] - 1;
+		if (GetStopName(stop) == stop_name)
+		{
+			return stop;
+		}
+	}
+	return nullopt;
+}
+
+optional<uint32_t> MappedCatalogue::FindBus(string_view bus_name) const
+{
+	const uint32_t mask = header_->bus_hash_capacity - 1;
+	size_t slot = HashName(bus_name) & mask;
+	for (uint32_t probes = 0; bus_hash_[slot] != EMPTY_SLOT; slot = (slot + 1) & mask)
+	{
+		CheckSnapshot(probes++ <= mask);
+		uint32_t bus = bus_hash_[slot] - 1;
+		if (GetBusName(bus) == bus_name)
+		{
+			return bus;
+		}
+	}
+	return nullopt;
+}
+
+string_view MappedCatalogue::GetStopName(uint32_t stop) const
+{
+	CheckSnapshot(stop < header_->stop_count);
+	return GetString(stops_[stop].name_offset, stops_[stop].name_length);
+}
+
+string_view MappedCatalogue::GetBusName(uint32_t bus) const
+{
+	CheckSnapshot(bus < header_->bus_count);
+	return GetString(buses_[bus].name_offset, buses_[bus].name_length);
+}
+
+RouteInfo MappedCatalogue::GetRouteInfo(uint32_t bus) const
+{
+	CheckSnapshot(bus < header_->bus_count);
+	const MappedBus& record = buses_[bus];
+	return { record.n_stops, record.n_unique_stops, record.real_length, record.curvature };
+}
+
+IdRange MappedCatalogue::GetStopBuses(uint32_t stop) const
+{
+	return GetCsrRow(stop_buses_index_, stop_buses_, stop, header_->stop_count);
+}
+
+SnapshotSettings MappedCatalogue::GetSettings() const
+{
+	istringstream input(string(data_ + header_->settings_offset, header_->settings_size));
+	return LoadSettings(input);
+}
+
+void MappedCatalogue::Materialize(TransportCatalogue& tc) const
+{
+	// Каталог строится обходом всего снимка, поэтому полная проверка не меняет порядок времени
+	Validate();
+	// Записи, удалённые патчами, пропускаются; расстояния до них не переносятся
+	vector<const Stop*> stops(header_->stop_count, nullptr);
+	for (uint32_t stop = 0; stop < header_->stop_count; ++stop)
+	{
+		if (stops_[stop].flags & RECORD_REMOVED)
+		{
+			continue;
+		}
+		tc.AddStop(string{ GetStopName(stop) }, { stops_[stop].lat, stops_[stop].lng });
+		stops[stop] = &tc.GetStops().back();
+	}
+	for (uint32_t stop = 0; stop < header_->stop_count; ++stop)
+	{
+		for (uint32_t i = distances_index_[stop]; i < distances_index_[stop + 1]; ++i)
+		{
+			CheckSnapshot(distances_[i].to < header_->stop_count);
+			if (!stops[stop] || !stops[distances_[i].to])
+			{
+				continue;
+			}
+			tc.SetDistanceBetweenStops(stops[stop], stops[distances_[i].to], distances_[i].distance);
+		}
+	}
+	for (uint32_t bus = 0; bus < header_->bus_count; ++bus)
+	{
+		if (buses_[bus].flags & RECORD_REMOVED)
+		{
+			continue;
+		}
+		vector<const Stop*> bus_stops;
+		unordered_set<string_view> unique_stops;
+		for (uint32_t stop : GetCsrRow(bus_stops_index_, bus_stops_, bus, header_->bus_count))
+		{
+			CheckSnapshot(stop < header_->stop_count && stops[stop]);
+			bus_stops.push_back(stops[stop]);
+			unique_stops.insert(stops[stop]->name);
+		}
+		tc.AddBus(string{ GetBusName(bus) }, move(bus_stops), unique_stops, buses_[bus].is_round);
+	}
+}
+
+void MappedCatalogue::Validate() const
+{
+	const uint32_t stop_count = header_->stop_count;
+	const uint32_t bus_count = header_->bus_count;
+	for (uint32_t stop = 0; stop < stop_count; ++stop)
+	{
+		GetStopName(stop);
+	}
+	for (uint32_t bus = 0; bus < bus_count; ++bus)
+	{
+		GetBusName(bus);
+	}
+	CheckHashTable(stop_hash_, header_->stop_hash_capacity, stop_count);
+	CheckHashTable(bus_hash_, header_->bus_hash_capacity, bus_count);
+	CheckCsrOffsets(stop_buses_index_, stop_count);
+	CheckIds(stop_buses_, stop_buses_ + stop_buses_index_[stop_count], bus_count);
+	CheckCsrOffsets(bus_stops_index_, bus_count);
+	CheckIds(bus_stops_, bus_stops_ + bus_stops_index_[bus_count], stop_count);
+	CheckCsrOffsets(distances_index_, stop_count);
+	CheckSnapshot(all_of(distances_, distances_ + distances_index_[stop_count],
+		[stop_count](const MappedDistance& distance)
+		{
+			return distance.to < stop_count;
+		}));
+}
+
+template <typename Type>
+const Type* MappedCatalogue::GetSection(uint64_t offset, uint64_t count) const
+{
+	CheckSnapshot(offset % alignof(Type) == 0 && offset <= size_ && count <= (size_ - offset) / sizeof(Type));
+	return reinterpret_cast<const Type*>(data_ + offset);
+}
+
+IdRange MappedCatalogue::GetCsrRow(const uint32_t* index, const uint32_t* values, uint32_t row, uint32_t rows) const
+{
+	// Открытие проверило только, что значения всех rows строк лежат в секции
+	CheckSnapshot(row < rows && index[row] <= index[row + 1] && index[row + 1] <= index[rows]);
+	return { values + index[row], values + index[row + 1] };
+}
+
+string_view MappedCatalogue::GetString(uint32_t offset, uint32_t length) const
+{
+	CheckSnapshot(static_cast<uint64_t>(offset) + length <= header_->strings_size);
+	return { strings_ + offset, length };
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "serialization.h"
+
+#include <cstdint>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace transport::serialization
+{
+
+struct MappedHeader;
+struct MappedStop;
+struct MappedBus;
+struct MappedDistance;
+
+// Диапазон идентификаторов внутри отображённого файла
+struct IdRange
+{
+	const uint32_t* first = nullptr;
+	const uint32_t* last = nullptr;
+
+	const uint32_t* begin() const
+	{
+		return first;
+	}
+	const uint32_t* end() const
+	{
+		return last;
+	}
+	size_t size() const
+	{
+		return last - first;
+	}
+};
+
+/*
+* Снимок базы, пригодный для отображения в память (mmap) и чтения без десериализации.
+* Все ссылки внутри файла — смещения от его начала, поэтому файл не зависит от адреса
+* отображения и может разделяться через страничный кэш между процессами.
+* Состав: массивы остановок и автобусов (имена — смещения в общем блоке строк,
+* у автобусов — готовая RouteInfo), хеш-таблицы имён с открытой адресацией,
+* CSR-массивы "остановка -> автобусы (по имени)", "автобус -> остановки" и
+* "остановка -> расстояния", а также настройки в формате SaveSettings.
+* Числа хранятся в порядке байтов машины, на которой создан снимок
+*/
+void SaveMappedCatalogue(const TransportCatalogue& tc, const SnapshotSettings& settings, std::ostream& output);
+
+// Проверяет, начинается ли файл с сигнатуры отображаемого снимка
+bool IsMappedSnapshot(const std::string& path);
+
+class MappedCatalogue
+{
+public:
+	explicit MappedCatalogue(const std::string& path);
+	MappedCatalogue(const MappedCatalogue&) = delete;
+	MappedCatalogue& operator=(const MappedCatalogue&) = delete;
+	~MappedCatalogue();
+
+	std::optional<uint32_t> FindStop(std::string_view stop_name) const;
+	std::optional<uint32_t> FindBus(std::string_view bus_name) const;
+	std::string_view GetStopName(uint32_t stop) const;
+	std::string_view GetBusName(uint32_t bus) const;
+	domain::RouteInfo GetRouteInfo(uint32_t bus) const;
+
+	// Автобусы, проходящие через остановку, в порядке возрастания имён
+	IdRange GetStopBuses(uint32_t stop) const;
+
+	SnapshotSettings GetSettings() const;
+
+	// Строит полноценный каталог для запросов, которым нужен граф объектов (Map, Route и др.)
+	void Materialize(TransportCatalogue& tc) const;
+
+private:
+	friend class SnapshotPatcher;
+
+	// Обходит весь снимок и проверяет то, на что полагаются обход без проверок (Materialize)
+	// и SnapshotPatcher: границы имён, номера записей в хеш-таблицах и CSR-массивах, монотонность
+	// смещений CSR и наличие пустого слота в каждой хеш-таблице. При открытии проверяются
+	// только заголовок и границы секций, чтобы открытие не зависело от размера каталога,
+	// а поиск и чтение записей проверяют то, что читают. Бросает SerializationError
+	void Validate() const;
+	template <typename Type>
+	const Type* GetSection(uint64_t offset, uint64_t count) const;
+	IdRange GetCsrRow(const uint32_t* index, const uint32_t* values, uint32_t row, uint32_t rows) const;
+	std::string_view GetString(uint32_t offset, uint32_t length) const;
+
+	const char* data_ = nullptr;
+	size_t size_ = 0;
+	const MappedHeader* header_ = nullptr;
+	const char* strings_ = nullptr;
+	const MappedStop* stops_ = nullptr;
+	const MappedBus* buses_ = nullptr;
+	const uint32_t* stop_hash_ = nullptr;
+	const uint32_t* bus_hash_ = nullptr;
+	const uint32_t* stop_buses_index_ = nullptr;
+	const uint32_t* stop_buses_ = nullptr;
+	const uint32_t* bus_stops_index_ = nullptr;
+	const uint32_t* bus_stops_ = nullptr;
+	const uint32_t* distances_index_ = nullptr;
+	const MappedDistance* distances_ = nullptr;
+};
+
+} // namespace transport::serialization
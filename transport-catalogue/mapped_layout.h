@@ -0,0 +1,171 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+/*
+* Двоичная раскладка отображаемого снимка (см. mapped_catalogue.h).
+* Используется при записи, чтении и применении патчей к снимку
+*/
+namespace transport::serialization
+{
+
+struct MappedHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t stop_count;
+	uint32_t bus_count;
+	uint32_t stop_hash_capacity;
+	uint32_t bus_hash_capacity;
+	uint64_t file_size;
+	uint64_t strings_offset;
+	uint64_t strings_size;
+	uint64_t stops_offset;
+	uint64_t buses_offset;
+	uint64_t stop_hash_offset;
+	uint64_t bus_hash_offset;
+	uint64_t stop_buses_index_offset;
+	uint64_t stop_buses_offset;
+	uint64_t bus_stops_index_offset;
+	uint64_t bus_stops_offset;
+	uint64_t distances_index_offset;
+	uint64_t distances_offset;
+	uint64_t settings_offset;
+	uint64_t settings_size;
+};
+
+// Флаг удалённой патчем записи: идентификаторы остальных записей при удалении не меняются
+const uint32_t RECORD_REMOVED = 1;
+
+struct MappedStop
+{
+	uint32_t name_offset;
+	uint32_t name_length;
+	uint32_t flags;
+	uint32_t reserved;
+	double lat;
+	double lng;
+};
+
+struct MappedBus
+{
+	uint32_t name_offset;
+	uint32_t name_length;
+	uint32_t is_round;
+	int32_t n_stops;
+	int32_t n_unique_stops;
+	uint32_t flags;
+	double real_length;
+	double curvature;
+};
+
+struct MappedDistance
+{
+	uint32_t to;
+	int32_t distance;
+};
+
+inline const char MAPPED_MAGIC[4] = { 'T', 'C', 'M', 'M' };
+inline const uint32_t MAPPED_VERSION = 3;
+inline const uint32_t EMPTY_SLOT = 0;
+inline const size_t SECTION_ALIGNMENT = 8;
+
+// FNV-1a: хеш должен совпадать у процесса, создавшего снимок, и у читающих его
+inline uint64_t HashName(std::string_view name)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (char c : name)
+	{
+		hash ^= static_cast<unsigned char>(c);
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+inline uint32_t GetHashCapacity(size_t count)
+{
+	uint32_t capacity = 1;
+	while (capacity < count * 2)
+	{
+		capacity *= 2;
+	}
+	return capacity;
+}
+
+// Вставка в хеш-таблицу с линейным пробированием; в слоте хранится id + 1, 0 — пустой слот
+inline void InsertIntoHashTable(std::vector<uint32_t>& slots, std::string_view name, uint32_t id)
+{
+	const size_t mask = slots.size() - 1;
+	size_t slot = HashName(name) & mask;
+	while (slots[slot] != EMPTY_SLOT)
+	{
+		slot = (slot + 1) & mask;
+	}
+	slots[slot] = id + 1;
+}
+
+// Таблица по записям без флага RECORD_REMOVED; get_record(id) возвращает MappedStop или MappedBus
+template <typename GetRecord, typename GetName>
+std::vector<uint32_t> BuildHashTable(uint32_t count, uint32_t capacity, GetRecord get_record, GetName get_name)
+{
+	std::vector<uint32_t> slots(capacity, EMPTY_SLOT);
+	for (uint32_t id = 0; id < count; ++id)
+	{
+		if (!(get_record(id).flags & RECORD_REMOVED))
+		{
+			InsertIntoHashTable(slots, get_name(id), id);
+		}
+	}
+	return slots;
+}
+
+// Собирает файл из секций, выравнивая начало каждой
+class SectionWriter
+{
+public:
+	template <typename Type>
+	uint64_t Append(const std::vector<Type>& values)
+	{
+		static_assert(std::is_trivially_copyable_v<Type>);
+		return Append(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(Type));
+	}
+
+	uint64_t Append(const char* data, size_t size)
+	{
+		Align();
+		uint64_t offset = buffer_.size();
+		buffer_.append(data, size);
+		return offset;
+	}
+
+	// Начинает новую секцию, в которую затем дописываются данные через Extend
+	uint64_t Begin()
+	{
+		Align();
+		return buffer_.size();
+	}
+
+	void Extend(const char* data, size_t size)
+	{
+		buffer_.append(data, size);
+	}
+
+	std::string& GetBuffer()
+	{
+		return buffer_;
+	}
+
+private:
+	void Align()
+	{
+		buffer_.resize((buffer_.size() + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT, '\0');
+	}
+
+	std::string buffer_;
+};
+
+} // namespace transport::serialization
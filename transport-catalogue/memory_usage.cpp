@@ -0,0 +1,78 @@
+#include "memory_usage.h"
+
+#include <climits>
+
+using namespace std;
+using namespace transport::memory;
+using namespace json;
+
+namespace
+{
+Node MakeSizeNode(size_t size)
+{
+	if (size <= static_cast<size_t>(INT_MAX))
+	{
+		return Node(static_cast<int>(size));
+	}
+	return Node(static_cast<double>(size));
+}
+} // namespace
+
+size_t transport::memory::GetMallocChunkSize(size_t size)
+{
+	// Заголовок размера 8 байт, выравнивание на 16, минимальный блок 32 байта
+	return max<size_t>(32, (size + 8 + 15) & ~size_t{ 15 });
+}
+
+UsageCounter& UsageCounter::AddJson(const Node& node)
+{
+	AddElements(1);
+	if (node.IsString())
+	{
+		AddString(node.AsString());
+	}
+	else if (node.IsArray())
+	{
+		const Array& array = node.AsArray();
+		AddVector(array);
+		for (const Node& element : array)
+		{
+			AddJson(element);
+		}
+	}
+	else if (node.IsMap())
+	{
+		AddJson(node.AsMap());
+	}
+	return *this;
+}
+
+UsageCounter& UsageCounter::AddJson(const Dict& dict)
+{
+	AddTree(dict);
+	for (const auto& [key, value] : dict)
+	{
+		AddString(key);
+		AddJson(value);
+	}
+	return *this;
+}
+
+Dict transport::memory::ToJSON(const vector<Usage>& usages)
+{
+	Dict result;
+	Usage total{ "total"s };
+	for (const Usage& usage : usages)
+	{
+		result.emplace(usage.name, Dict{
+			{"elements"s, MakeSizeNode(usage.elements)},
+			{"bytes"s, MakeSizeNode(usage.bytes)},
+			{"allocated_bytes"s, MakeSizeNode(usage.allocated_bytes)} });
+		total.bytes += usage.bytes;
+		total.allocated_bytes += usage.allocated_bytes;
+	}
+	result.emplace(total.name, Dict{
+		{"bytes"s, MakeSizeNode(total.bytes)},
+		{"allocated_bytes"s, MakeSizeNode(total.allocated_bytes)} });
+	return result;
+}
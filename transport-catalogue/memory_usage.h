@@ -0,0 +1,140 @@
+#pragma once
+
+#include "json.h"
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace transport::memory
+{
+
+// Память одного контейнера: число элементов и байты в куче
+struct Usage
+{
+	std::string name;
+	size_t elements = 0;
+	// Запрошенные у распределителя байты: данные, узлы, корзины и запас ёмкости
+	size_t bytes = 0;
+	// Те же блоки с заголовками и выравниванием malloc
+	size_t allocated_bytes = 0;
+};
+
+// Размер блока malloc (glibc, 64 бита), выделенного под size байт
+size_t GetMallocChunkSize(size_t size);
+
+/*
+* Подсчёт памяти контейнеров обходом их содержимого. Размеры узлов и блоков повторяют
+* устройство контейнеров libstdc++, поэтому для других стандартных библиотек это оценка.
+* Каждый блок учитывается и по запрошенному размеру, и по размеру блока malloc
+*/
+class UsageCounter
+{
+public:
+	explicit UsageCounter(std::string name)
+	{
+		usage_.name = std::move(name);
+	}
+
+	// Отдельный блок кучи
+	UsageCounter& AddBlock(size_t size)
+	{
+		if (size > 0)
+		{
+			usage_.bytes += size;
+			usage_.allocated_bytes += GetMallocChunkSize(size);
+		}
+		return *this;
+	}
+
+	// count одинаковых блоков
+	UsageCounter& AddBlocks(size_t count, size_t size)
+	{
+		if (size > 0)
+		{
+			usage_.bytes += count * size;
+			usage_.allocated_bytes += count * GetMallocChunkSize(size);
+		}
+		return *this;
+	}
+
+	UsageCounter& AddElements(size_t count)
+	{
+		usage_.elements += count;
+		return *this;
+	}
+
+	// Строки до 15 символов хранятся внутри объекта и кучу не занимают
+	UsageCounter& AddString(const std::string& str)
+	{
+		return str.capacity() > SSO_CAPACITY ? AddBlock(str.capacity() + 1) : *this;
+	}
+
+	template <typename Type>
+	UsageCounter& AddVector(const std::vector<Type>& vector)
+	{
+		return AddBlock(vector.capacity() * sizeof(Type));
+	}
+
+	// Узлы по 512 байт и массив указателей на них
+	template <typename Type>
+	UsageCounter& AddDeque(const std::deque<Type>& deque)
+	{
+		const size_t per_node = sizeof(Type) < DEQUE_NODE_SIZE ? DEQUE_NODE_SIZE / sizeof(Type) : 1;
+		const size_t nodes = deque.size() / per_node + 1;
+		AddBlocks(nodes, per_node * sizeof(Type));
+		return AddBlock(std::max<size_t>(8, nodes + 2) * sizeof(void*));
+	}
+
+	// Узел: указатель на следующий, значение и, если хеш не считается дёшево, сохранённый хеш
+	template <typename HashTable>
+	UsageCounter& AddHashTable(const HashTable& table)
+	{
+		AddBlocks(table.size(), sizeof(void*) + sizeof(typename HashTable::value_type)
+			+ (IsHashCached<HashTable>() ? sizeof(size_t) : 0));
+		// Единственная корзина пустой таблицы хранится внутри объекта
+		return table.bucket_count() > 1 ? AddBlock(table.bucket_count() * sizeof(void*)) : *this;
+	}
+
+	// Узел красно-чёрного дерева: цвет и три указателя перед значением
+	template <typename Tree>
+	UsageCounter& AddTree(const Tree& tree)
+	{
+		return AddBlocks(tree.size(), TREE_NODE_HEADER + sizeof(typename Tree::value_type));
+	}
+
+	// Содержимое значения JSON: узлы словарей, массивы и строки; элементы — число значений
+	UsageCounter& AddJson(const json::Node& node);
+	UsageCounter& AddJson(const json::Dict& dict);
+
+	const Usage& Get() const
+	{
+		return usage_;
+	}
+
+private:
+	static const size_t SSO_CAPACITY = 15;
+	static const size_t DEQUE_NODE_SIZE = 512;
+	static const size_t TREE_NODE_HEADER = 32;
+
+	template <typename HashTable>
+	static constexpr bool IsHashCached()
+	{
+#if defined(__GLIBCXX__)
+		// Правило libstdc++: хеш хранится в узле, если хеш-функция не помечена как быстрая или может бросить исключение
+		return std::__cache_default<typename HashTable::key_type, typename HashTable::hasher>::value;
+#else
+		return true;
+#endif
+	}
+
+	Usage usage_;
+};
+
+// Словарь имя -> {elements, bytes, allocated_bytes} и итог в ключе "total"
+json::Dict ToJSON(const std::vector<Usage>& usages);
+
+} // namespace transport::memory
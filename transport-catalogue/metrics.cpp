@@ -0,0 +1,247 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+
+using namespace std;
+using namespace transport::metrics;
+using namespace json;
+
+namespace
+{
+// Счётчики выводятся целыми числами JSON, пока помещаются в int
+Node MakeCountNode(uint64_t count)
+{
+	if (count <= static_cast<uint64_t>(INT_MAX))
+	{
+		return Node(static_cast<int>(count));
+	}
+	return Node(static_cast<double>(count));
+}
+
+int GetHighestBit(uint64_t value)
+{
+#if defined(__GNUC__)
+	return 63 - __builtin_clzll(value);
+#else
+	int bit = 0;
+	while (value >>= 1)
+	{
+		++bit;
+	}
+	return bit;
+#endif
+}
+
+double ToMicroseconds(uint64_t nanoseconds)
+{
+	return nanoseconds / 1e3;
+}
+} // namespace
+
+void Counter::Add(uint64_t value)
+{
+	value_.fetch_add(value, memory_order_relaxed);
+}
+
+uint64_t Counter::Get() const
+{
+	return value_.load(memory_order_relaxed);
+}
+
+void Counter::Reset()
+{
+	value_.store(0, memory_order_relaxed);
+}
+
+void Histogram::Record(uint64_t nanoseconds)
+{
+	buckets_[GetBucket(nanoseconds)].fetch_add(1, memory_order_relaxed);
+	sum_.fetch_add(nanoseconds, memory_order_relaxed);
+	uint64_t max = max_.load(memory_order_relaxed);
+	while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, memory_order_relaxed))
+	{
+	}
+}
+
+uint64_t Histogram::GetCount() const
+{
+	uint64_t count = 0;
+	for (const atomic<uint64_t>& bucket : buckets_)
+	{
+		count += bucket.load(memory_order_relaxed);
+	}
+	return count;
+}
+
+uint64_t Histogram::GetPercentile(double q) const
+{
+	const uint64_t count = GetCount();
+	if (count == 0)
+	{
+		return 0;
+	}
+	const uint64_t rank = max<uint64_t>(1, static_cast<uint64_t>(ceil(q * count)));
+	const uint64_t max_value = max_.load(memory_order_relaxed);
+	uint64_t seen = 0;
+	for (size_t bucket = 0; bucket < BUCKETS_COUNT; ++bucket)
+	{
+		seen += buckets_[bucket].load(memory_order_relaxed);
+		if (seen >= rank)
+		{
+			return min(GetBucketValue(bucket), max_value);
+		}
+	}
+	return max_value;
+}
+
+Dict Histogram::ToJSON() const
+{
+	const uint64_t count = GetCount();
+	const uint64_t sum = sum_.load(memory_order_relaxed);
+	return Dict{
+		{"count"s, MakeCountNode(count)},
+		{"total_ms"s, sum / 1e6},
+		{"mean_us"s, count == 0 ? 0.0 : ToMicroseconds(sum) / count},
+		{"p50_us"s, ToMicroseconds(GetPercentile(0.5))},
+		{"p90_us"s, ToMicroseconds(GetPercentile(0.9))},
+		{"p99_us"s, ToMicroseconds(GetPercentile(0.99))},
+		{"p999_us"s, ToMicroseconds(GetPercentile(0.999))},
+		{"max_us"s, ToMicroseconds(max_.load(memory_order_relaxed))} };
+}
+
+void Histogram::Reset()
+{
+	for (atomic<uint64_t>& bucket : buckets_)
+	{
+		bucket.store(0, memory_order_relaxed);
+	}
+	sum_.store(0, memory_order_relaxed);
+	max_.store(0, memory_order_relaxed);
+}
+
+size_t Histogram::GetBucket(uint64_t value)
+{
+	if (value < SUB_BUCKETS_COUNT)
+	{
+		return value;
+	}
+	const int shift = GetHighestBit(value) - SUB_BUCKET_BITS;
+	return SUB_BUCKETS_COUNT * (shift + 1) + ((value >> shift) - SUB_BUCKETS_COUNT);
+}
+
+uint64_t Histogram::GetBucketValue(size_t bucket)
+{
+	if (bucket < SUB_BUCKETS_COUNT)
+	{
+		return bucket;
+	}
+	const int shift = static_cast<int>(bucket / SUB_BUCKETS_COUNT) - 1;
+	const uint64_t lower = (SUB_BUCKETS_COUNT + bucket % SUB_BUCKETS_COUNT) << shift;
+	return lower + ((uint64_t{ 1 } << shift) >> 1);
+}
+
+void Registry::Enable(bool is_enabled)
+{
+	is_enabled_.store(is_enabled, memory_order_relaxed);
+}
+
+bool Registry::IsEnabled() const
+{
+	return is_enabled_.load(memory_order_relaxed);
+}
+
+Counter& Registry::GetCounter(const string& name)
+{
+	lock_guard lock(mutex_);
+	unique_ptr<Counter>& counter = counters_[name];
+	if (!counter)
+	{
+		counter = make_unique<Counter>();
+	}
+	return *counter;
+}
+
+Histogram& Registry::GetHistogram(const string& group, const string& name)
+{
+	lock_guard lock(mutex_);
+	unique_ptr<Histogram>& histogram = histograms_[group][name];
+	if (!histogram)
+	{
+		histogram = make_unique<Histogram>();
+	}
+	return *histogram;
+}
+
+void Registry::Reset()
+{
+	lock_guard lock(mutex_);
+	start_ = chrono::steady_clock::now();
+	for (auto& [name, counter] : counters_)
+	{
+		counter->Reset();
+	}
+	for (auto& [group, histograms] : histograms_)
+	{
+		for (auto& [name, histogram] : histograms)
+		{
+			histogram->Reset();
+		}
+	}
+}
+
+Dict Registry::ToJSON() const
+{
+	lock_guard lock(mutex_);
+	const double uptime = chrono::duration<double>(chrono::steady_clock::now() - start_).count();
+	Dict counters;
+	for (const auto& [name, counter] : counters_)
+	{
+		counters.emplace(name, MakeCountNode(counter->Get()));
+	}
+	Dict result{ {"uptime_s"s, uptime}, {"counters"s, move(counters)} };
+	for (const auto& [group, histograms] : histograms_)
+	{
+		Dict group_dict;
+		for (const auto& [name, histogram] : histograms)
+		{
+			// Пустые гистограммы — зарегистрированные, но не встретившиеся типы и этапы
+			if (histogram->GetCount() == 0)
+			{
+				continue;
+			}
+			Dict histogram_dict = histogram->ToJSON();
+			if (group == "requests"s && uptime > 0)
+			{
+				histogram_dict.emplace("rate_per_s"s, histogram->GetCount() / uptime);
+			}
+			group_dict.emplace(name, move(histogram_dict));
+		}
+		result.emplace(group, move(group_dict));
+	}
+	return result;
+}
+
+Registry& transport::metrics::GetRegistry()
+{
+	static Registry registry;
+	return registry;
+}
+
+ScopedTimer::ScopedTimer(Histogram& histogram)
+{
+	if (GetRegistry().IsEnabled())
+	{
+		histogram_ = &histogram;
+		start_ = chrono::steady_clock::now();
+	}
+}
+
+ScopedTimer::~ScopedTimer()
+{
+	if (histogram_)
+	{
+		histogram_->Record(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start_).count());
+	}
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include "json.h"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace transport::metrics
+{
+
+class Counter
+{
+public:
+	void Add(uint64_t value = 1);
+	uint64_t Get() const;
+	void Reset();
+
+private:
+	std::atomic<uint64_t> value_{ 0 };
+};
+
+/*
+* Гистограмма длительностей в наносекундах в духе HDR Histogram: значения до 32 хранятся точно,
+* большие — в 32 корзинах на каждую степень двойки, то есть с относительной погрешностью
+* не больше 1/32. Запись — несколько атомарных операций без блокировок
+*/
+class Histogram
+{
+public:
+	void Record(uint64_t nanoseconds);
+
+	uint64_t GetCount() const;
+	// Значение, не меньше которого q-я доля записей (q от 0 до 1), в наносекундах
+	uint64_t GetPercentile(double q) const;
+	// count, total_ms, mean_us, p50_us, p90_us, p99_us, p999_us, max_us
+	json::Dict ToJSON() const;
+	void Reset();
+
+private:
+	static const int SUB_BUCKET_BITS = 5;
+	static const size_t SUB_BUCKETS_COUNT = size_t{ 1 } << SUB_BUCKET_BITS;
+	static const size_t BUCKETS_COUNT = SUB_BUCKETS_COUNT * (64 - SUB_BUCKET_BITS + 1);
+
+	static size_t GetBucket(uint64_t value);
+	// Середина диапазона значений корзины
+	static uint64_t GetBucketValue(size_t bucket);
+
+	// Число записей не хранится отдельно, а складывается из корзин при чтении
+	std::array<std::atomic<uint64_t>, BUCKETS_COUNT> buckets_{};
+	std::atomic<uint64_t> sum_{ 0 };
+	std::atomic<uint64_t> max_{ 0 };
+};
+
+/*
+* Реестр счётчиков и гистограмм процесса. Получение метрики по имени берёт блокировку,
+* поэтому в горячем коде ссылки на метрики запоминаются заранее; сами метрики живут
+* до конца работы реестра. Пока сбор выключен, ScopedTimer не читает часы
+*/
+class Registry
+{
+public:
+	void Enable(bool is_enabled);
+	bool IsEnabled() const;
+
+	Counter& GetCounter(const std::string& name);
+	// group — "phases" для этапов загрузки и подготовки, "requests" для типов запросов
+	Histogram& GetHistogram(const std::string& group, const std::string& name);
+	// Обнуляет все метрики и время работы; вызывается, когда метрики никто не записывает
+	void Reset();
+
+	// Снимок всех метрик: counters, группы гистограмм, uptime_s и для группы requests — rate_per_s
+	json::Dict ToJSON() const;
+
+private:
+	std::atomic<bool> is_enabled_{ false };
+	std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+	mutable std::mutex mutex_;
+	std::map<std::string, std::unique_ptr<Counter>> counters_;
+	std::map<std::string, std::map<std::string, std::unique_ptr<Histogram>>> histograms_;
+};
+
+Registry& GetRegistry();
+
+// Записывает в гистограмму время жизни объекта, если сбор метрик включён при его создании
+class ScopedTimer
+{
+public:
+	explicit ScopedTimer(Histogram& histogram);
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+	~ScopedTimer();
+
+private:
+	Histogram* histogram_ = nullptr;
+	std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace transport::metrics
@@ -0,0 +1,168 @@
+#include "raptor_router.h"
+
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+using namespace transport;
+using namespace transport::router;
+using namespace domain;
+
+const size_t RaptorRouter::NONE = numeric_limits<size_t>::max();
+
+RaptorRouter::RaptorRouter(const TransportCatalogue& tc, RoutingSettings settings)
+	: settings_(settings)
+{
+	for (const Stop& stop : tc.GetStops())
+	{
+		stop_to_index_[&stop] = stops_.size();
+		stops_.push_back(&stop);
+	}
+	stop_to_routes_.resize(stops_.size());
+	for (const Bus& bus : tc.GetBuses())
+	{
+		if (bus.stops.empty())
+		{
+			continue;
+		}
+		RouteData route;
+		route.bus = &bus;
+		route.stops.reserve(bus.stops.size());
+		route.ride_times.reserve(bus.stops.size());
+		double ride_time = 0;
+		for (size_t i = 0; i < bus.stops.size(); ++i)
+		{
+			if (i > 0)
+			{
+				ride_time += ComputeRideTime(settings_, tc.GetDistanceBetweenStops(bus.stops[i - 1], bus.stops[i]));
+			}
+			size_t stop = stop_to_index_.at(bus.stops[i]);
+			route.stops.push_back(stop);
+			route.ride_times.push_back(ride_time);
+			stop_to_routes_[stop].push_back({ routes_.size(), i });
+		}
+		routes_.push_back(move(route));
+	}
+}
+
+vector<RouteResult> RaptorRouter::BuildRoutes(const Stop* from, const Stop* to) const
+{
+	const double infinity = numeric_limits<double>::infinity();
+	const double wait_time = settings_.bus_wait_time;
+	size_t source = stop_to_index_.at(from);
+	size_t target = stop_to_index_.at(to);
+	if (source == target)
+	{
+		return { RouteResult{} };
+	}
+
+	vector<vector<Label>> rounds(1, vector<Label>(stops_.size(), Label{ infinity }));
+	vector<double> best_times(stops_.size(), infinity);
+	rounds[0][source].time = 0;
+	best_times[source] = 0;
+	vector<size_t> marked_stops{ source };
+	vector<size_t> first_positions(routes_.size(), NONE);
+	vector<bool> is_marked(stops_.size(), false);
+	vector<RouteResult> result;
+
+	for (size_t round = 1; !marked_stops.empty(); ++round)
+	{
+		// Собираем маршруты, проходящие через отмеченные остановки, и самую раннюю позицию на каждом
+		vector<size_t> routes_to_scan;
+		for (size_t stop : marked_stops)
+		{
+			for (const StopRoute& stop_route : stop_to_routes_[stop])
+			{
+				size_t& first_position = first_positions[stop_route.route];
+				if (first_position == NONE)
+				{
+					routes_to_scan.push_back(stop_route.route);
+					first_position = stop_route.position;
+				}
+				else
+				{
+					first_position = min(first_position, stop_route.position);
+				}
+			}
+		}
+
+		rounds.push_back(rounds.back());
+		for (Label& label : rounds.back())
+		{
+			label.route = NONE;
+		}
+		const vector<Label>& prev_round = rounds[round - 1];
+		vector<Label>& cur_round = rounds[round];
+		vector<size_t> new_marked_stops;
+
+		for (size_t route_index : routes_to_scan)
+		{
+			const RouteData& route = routes_[route_index];
+			size_t board_position = NONE;
+			double board_time = infinity;
+			for (size_t position = first_positions[route_index]; position < route.stops.size(); ++position)
+			{
+				size_t stop = route.stops[position];
+				double arrival_time = infinity;
+				if (board_position != NONE)
+				{
+					arrival_time = board_time + route.ride_times[position] - route.ride_times[board_position];
+					if (arrival_time < best_times[stop] && arrival_time < best_times[target])
+					{
+						cur_round[stop] = { arrival_time, route_index, board_position, position };
+						best_times[stop] = arrival_time;
+						if (!is_marked[stop])
+						{
+							is_marked[stop] = true;
+							new_marked_stops.push_back(stop);
+						}
+					}
+				}
+				// Пересаживаемся на этот автобус здесь, если так выходит раньше
+				if (prev_round[stop].time + wait_time < arrival_time)
+				{
+					board_position = position;
+					board_time = prev_round[stop].time + wait_time;
+				}
+			}
+			first_positions[route_index] = NONE;
+		}
+
+		for (size_t stop : new_marked_stops)
+		{
+			is_marked[stop] = false;
+		}
+		marked_stops = move(new_marked_stops);
+		if (cur_round[target].route != NONE)
+		{
+			result.push_back(RestoreRoute(rounds, round, target));
+		}
+	}
+	return result;
+}
+
+RouteResult RaptorRouter::RestoreRoute(const vector<vector<Label>>& rounds, size_t round, size_t stop) const
+{
+	RouteResult route;
+	route.total_time = rounds[round][stop].time;
+	while (round > 0)
+	{
+		const Label& label = rounds[round][stop];
+		if (label.route == NONE)
+		{
+			--round;
+			continue;
+		}
+		const RouteData& route_data = routes_[label.route];
+		size_t board_stop = route_data.stops[label.board_position];
+		route.items.push_back({ stops_[board_stop], route_data.bus,
+			static_cast<int>(label.alight_position - label.board_position),
+			route_data.ride_times[label.alight_position] - route_data.ride_times[label.board_position] });
+		route.items.push_back({ stops_[board_stop], nullptr, 0, static_cast<double>(settings_.bus_wait_time) });
+		stop = board_stop;
+		--round;
+	}
+	reverse(route.items.begin(), route.items.end());
+	route.transfer_count = max(static_cast<int>(route.items.size() / 2) - 1, 0);
+	return route;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "transport_router.h"
+
+#include <vector>
+#include <unordered_map>
+
+namespace transport::router
+{
+
+/*
+* Альтернативный движок маршрутизации по схеме RAPTOR: вместо графа работает
+* с массивами остановок маршрутов и сканирует их по раундам. Раунд k находит
+* лучшее время прибытия, использующее не более k поездок, поэтому результатом
+* является Парето-набор маршрутов по паре (число пересадок, время в пути)
+*/
+class RaptorRouter
+{
+public:
+	RaptorRouter(const TransportCatalogue& tc, RoutingSettings settings);
+
+	// Парето-оптимальные маршруты, упорядоченные по возрастанию числа пересадок.
+	// Последний элемент — самый быстрый маршрут. Пустой результат — остановка недостижима
+	std::vector<RouteResult> BuildRoutes(const domain::Stop* from, const domain::Stop* to) const;
+
+private:
+	static const size_t NONE;
+
+	struct RouteData
+	{
+		const domain::Bus* bus = nullptr;
+		std::vector<size_t> stops;
+		// Время поездки от начальной остановки маршрута до каждой остановки
+		std::vector<double> ride_times;
+	};
+
+	struct StopRoute
+	{
+		size_t route;
+		size_t position;
+	};
+
+	// Метка остановки в раунде. route == NONE — метка унаследована из предыдущего раунда
+	struct Label
+	{
+		double time;
+		size_t route = NONE;
+		size_t board_position = NONE;
+		size_t alight_position = NONE;
+	};
+
+	RouteResult RestoreRoute(const std::vector<std::vector<Label>>& rounds, size_t round, size_t stop) const;
+
+	RoutingSettings settings_;
+	std::vector<const domain::Stop*> stops_;
+	std::unordered_map<const domain::Stop*, size_t> stop_to_index_;
+	std::vector<RouteData> routes_;
+	std::vector<std::vector<StopRoute>> stop_to_routes_;
+};
+
+} // namespace transport::router
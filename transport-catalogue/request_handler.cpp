@@ -1,14 +1,44 @@
 #include "request_handler.h"
+#include "json.h"
+#include "metrics.h"
+#include "trace.h"
+
+#include <algorithm>
 
 using namespace std;
 using namespace transport::request_handler;
 using namespace renderer;
 
+namespace
+{
+void SortStopsByName(vector<const transport::domain::Stop*>& stops)
+{
+	sort(stops.begin(), stops.end(), [](const transport::domain::Stop* lhs, const transport::domain::Stop* rhs)
+		{
+			return lhs->name < rhs->name;
+		});
+	stops.erase(unique(stops.begin(), stops.end()), stops.end());
+}
+
+transport::metrics::Histogram& GetRenderMapHistogram()
+{
+	static transport::metrics::Histogram& histogram
+		= transport::metrics::GetRegistry().GetHistogram("phases"s, "render_map"s);
+	return histogram;
+}
+} // namespace
+
 RequestHandler::RequestHandler(const transport::TransportCatalogue& db, const renderer::MapRenderer& renderer)
 	:db_(db), renderer_(renderer)
 {
 }
 
+RequestHandler::RequestHandler(const transport::TransportCatalogue& db, const renderer::MapRenderer& renderer,
+	optional<transport::router::RoutingSettings> routing_settings)
+	:db_(db), renderer_(renderer), routing_settings_(move(routing_settings))
+{
+}
+
 std::optional<transport::domain::RouteInfo> RequestHandler::GetRouteInfo(std::string_view bus_name) const
 {
 	const domain::Bus* bus = db_.SearchBus(bus_name);
@@ -31,114 +61,289 @@ const transport::sv_set* RequestHandler::GetBusesByStop(std::string_view stop_na
 	return buses;
 }
 
-svg::Document RequestHandler::RenderMap(const transport::sv_set& valid_buses) const
+void RequestHandler::GetRouteInfos(const vector<string_view>& bus_names,
+	vector<optional<domain::RouteInfo>>& route_infos) const
 {
-	transport::sv_set valid_stops;
-	vector<geo::Coordinates> stops_coordinates;
-	unordered_map<string_view, svg::Color> bus_to_color;
-	unordered_map<string_view, vector<svg::Point>> bus_to_points;
-	for (string_view bus_name : valid_buses)
+	vector<const domain::Bus*> buses;
+	db_.SearchBuses(bus_names, buses);
+	db_.GetRouteInfos(buses, route_infos);
+}
+
+void RequestHandler::GetBusesByStops(const vector<string_view>& stop_names, vector<const sv_set*>& buses) const
+{
+	vector<const domain::Stop*> stops;
+	db_.SearchStops(stop_names, stops);
+	db_.GetStopsToBuses(stops, buses);
+}
+
+void RequestHandler::RenderMap(const transport::sv_set& valid_buses, svg::Writer& writer) const
+{
+	const RenderSettings render_settings = renderer_.GetRenderSettings();
+	if (IsLevelOfDetailEnabled(render_settings))
 	{
-		for (const domain::Stop* stop : db_.SearchBus(bus_name)->stops)
+		// Полная карта — плитка нулевого уровня: упрощённые линии и видимые подписи берутся из её кэша
+		GetTileIndex(valid_buses)->WriteTile(*MakeTileViewport(render_settings, 0, 0, 0), writer);
+		return;
+	}
+	const SphereProjector sphere_projector = MakeSphereProjector(valid_buses, render_settings);
+	const vector<const domain::Stop*> stops = GetStopsOfBuses(valid_buses);
+	writer.BeginDocument();
+	RenderRouteLines(writer, valid_buses, render_settings, sphere_projector);
+	RenderRouteNames(writer, valid_buses, render_settings, sphere_projector);
+	RenderStops(writer, stops, render_settings, sphere_projector);
+	RenderStopsNames(writer, stops, render_settings, sphere_projector);
+	writer.EndDocument();
+}
+
+shared_ptr<const RenderedMap> RequestHandler::GetRenderedMap(const transport::sv_set& valid_buses) const
+{
+	// Блокировка удерживается на время отрисовки, чтобы одновременные запросы Map рисовали карту один раз
+	lock_guard lock(map_cache_mutex_);
+	if (map_cache_ && map_cache_->catalogue_version == db_.GetVersion()
+		&& map_cache_->settings_hash == renderer_.GetSettingsHash())
+	{
+		return map_cache_;
+	}
+	metrics::ScopedTimer timer(GetRenderMapHistogram());
+	auto rendered_map = make_shared<RenderedMap>();
+	rendered_map->catalogue_version = db_.GetVersion();
+	rendered_map->settings_hash = renderer_.GetSettingsHash();
+	trace::Span span("render_map", "render");
+	// Размер карты почти не меняется между версиями каталога
+	string& map_json = rendered_map->json;
+	map_json.reserve(map_cache_ ? map_cache_->json.size() : 0);
+	map_json.push_back('"');
+	svg::Writer writer([&map_json](string_view svg_part)
 		{
-			valid_stops.insert(stop->name);
-			stops_coordinates.push_back(stop->coordinates);
-		}
+			json::AppendEscaped(svg_part, map_json);
+		});
+	RenderMap(valid_buses, writer);
+	map_json.push_back('"');
+	map_cache_ = move(rendered_map);
+	return map_cache_;
+}
+
+void RequestHandler::PrintMap(const transport::sv_set& valid_buses, ostream& output) const
+{
+	metrics::ScopedTimer timer(GetRenderMapHistogram());
+	trace::Span span("render_map", "render");
+	output << '"';
+	svg::Writer writer([&output](string_view svg_part)
+		{
+			json::PrintEscaped(svg_part, output);
+		});
+	RenderMap(valid_buses, writer);
+	output << '"';
+}
+
+shared_ptr<const TileIndex> RequestHandler::GetTileIndex(const transport::sv_set& valid_buses) const
+{
+	lock_guard lock(tile_index_mutex_);
+	if (tile_index_ && tile_index_version_ == db_.GetVersion() && tile_index_settings_hash_ == renderer_.GetSettingsHash())
+	{
+		return tile_index_;
 	}
+	static metrics::Histogram& build_histogram = metrics::GetRegistry().GetHistogram("phases"s, "build_tile_index"s);
+	metrics::ScopedTimer timer(build_histogram);
+	trace::Span span("build_tile_index", "render");
 	RenderSettings render_settings = renderer_.GetRenderSettings();
-	SphereProjector sphere_projector(stops_coordinates.begin(), stops_coordinates.end(),
-		render_settings.width, render_settings.height, render_settings.padding);
-	size_t color_index = 0;
-	size_t colors_count = render_settings.color_palette.size();
+	const SphereProjector sphere_projector = MakeSphereProjector(valid_buses, render_settings);
+	// Те же точки линий и подписей, что у RenderRouteLines и RenderRouteNames
+	vector<TileIndex::Route> routes;
+	routes.reserve(valid_buses.size());
 	for (string_view bus_name : valid_buses)
 	{
-		if (color_index >= colors_count)
+		const domain::Bus* bus = db_.SearchBus(bus_name);
+		TileIndex::Route& route = routes.emplace_back();
+		route.name = bus_name;
+		route.points.reserve(bus->stops.size());
+		for (const domain::Stop* stop : bus->stops)
 		{
-			color_index = 0;
+			route.points.push_back(sphere_projector(stop->coordinates));
 		}
-		bus_to_color[bus_name] = render_settings.color_palette[color_index];
-		++color_index;
-		for (const domain::Stop* stop : db_.SearchBus(bus_name)->stops)
+		route.label_positions.push_back(route.points.front());
+		if (!bus->is_round && bus->stops[bus->stops.size() / 2] != bus->stops.front())
 		{
-			bus_to_points[bus_name].push_back(sphere_projector(stop->coordinates));
+			route.label_positions.push_back(route.points[bus->stops.size() / 2]);
 		}
 	}
+	vector<TileIndex::Stop> stops;
+	for (const domain::Stop* stop : GetStopsOfBuses(valid_buses))
+	{
+		stops.push_back({ stop->name, sphere_projector(stop->coordinates) });
+	}
+	tile_index_ = make_shared<TileIndex>(move(render_settings), sphere_projector, routes, move(stops));
+	tile_index_version_ = db_.GetVersion();
+	tile_index_settings_hash_ = renderer_.GetSettingsHash();
+	return tile_index_;
+}
 
-	vector<unique_ptr<svg::Drawable>> picture;
-	
-	RenderRouteLines(picture, valid_buses, bus_to_points, bus_to_color, render_settings);
-	RenderRouteNames(picture, valid_buses, bus_to_color, render_settings, sphere_projector);
-	RenderStops(picture, valid_stops, render_settings, sphere_projector);
-	RenderStopsNames(picture, valid_stops, render_settings, sphere_projector);
+void RequestHandler::RenderIsochrone(const transport::sv_set& valid_buses,
+	const vector<pair<const transport::domain::Stop*, double>>& reachable_stops, svg::Writer& writer) const
+{
+	const RenderSettings render_settings = renderer_.GetRenderSettings();
+	const SphereProjector sphere_projector = MakeSphereProjector(valid_buses, render_settings);
+	vector<const domain::Stop*> stops;
+	stops.reserve(reachable_stops.size());
+	for (const auto& [stop, time] : reachable_stops)
+	{
+		stops.push_back(stop);
+	}
+	SortStopsByName(stops);
+	writer.BeginDocument();
+	RenderStops(writer, stops, render_settings, sphere_projector);
+	RenderStopsNames(writer, stops, render_settings, sphere_projector);
+	writer.EndDocument();
+}
 
-	svg::Document doc;
-	renderer::DrawMap(picture, doc);
-	return doc;
+vector<pair<const transport::domain::Stop*, double>> RequestHandler::GetReachableStops(
+	const transport::domain::Stop* stop, double max_time) const
+{
+	return GetRouter().ComputeReachableStops(stop, max_time);
 }
 
-void RequestHandler::RenderRouteLines(vector<unique_ptr<svg::Drawable>>& picture,
-	const transport::sv_set& valid_buses,
-	const unordered_map<string_view, vector<svg::Point>>& bus_to_points,
-	const unordered_map<string_view, svg::Color>& bus_to_color,
+vector<optional<double>> RequestHandler::GetTravelTimes(const transport::domain::Stop* from,
+	const vector<const transport::domain::Stop*>& targets) const
+{
+	return GetRouter().ComputeTravelTimes(from, targets);
+}
+
+vector<transport::router::RouteResult> RequestHandler::GetRoutes(const transport::domain::Stop* from,
+	const transport::domain::Stop* to, transport::router::RoutingEngine engine, bool use_astar) const
+{
+	if (engine == router::RoutingEngine::RAPTOR)
+	{
+		return GetRaptorRouter().BuildRoutes(from, to);
+	}
+	vector<router::RouteResult> routes;
+	if (optional<router::RouteResult> route = GetRouter().BuildRoute(from, to, use_astar))
+	{
+		routes.push_back(move(*route));
+	}
+	return routes;
+}
+
+const transport::router::TransportRouter& RequestHandler::GetRouter() const
+{
+	if (!routing_settings_)
+	{
+		throw logic_error("routing settings are not set"s);
+	}
+	// Остальные потоки ждут, пока первый строит граф
+	call_once(router_flag_, [this]
+		{
+			static metrics::Histogram& build_histogram = metrics::GetRegistry().GetHistogram("phases"s, "build_router"s);
+			metrics::ScopedTimer timer(build_histogram);
+			trace::Span span("build_router");
+			router_ = make_unique<router::TransportRouter>(db_, *routing_settings_);
+		});
+	return *router_;
+}
+
+const transport::router::RaptorRouter& RequestHandler::GetRaptorRouter() const
+{
+	if (!routing_settings_)
+	{
+		throw logic_error("routing settings are not set"s);
+	}
+	call_once(raptor_router_flag_, [this]
+		{
+			static metrics::Histogram& build_histogram
+				= metrics::GetRegistry().GetHistogram("phases"s, "build_raptor_router"s);
+			metrics::ScopedTimer timer(build_histogram);
+			trace::Span span("build_raptor_router");
+			raptor_router_ = make_unique<router::RaptorRouter>(db_, *routing_settings_);
+		});
+	return *raptor_router_;
+}
+
+const transport::domain::Stop* RequestHandler::GetStop(std::string_view stop_name) const
+{
+	return db_.SearchStop(stop_name);
+}
+
+SphereProjector RequestHandler::MakeSphereProjector(const transport::sv_set& valid_buses,
 	const RenderSettings& render_settings) const
 {
+	trace::Span span("SphereProjector", "render");
+	vector<geo::Coordinates> stops_coordinates;
+	for (string_view bus_name : valid_buses)
+	{
+		for (const domain::Stop* stop : db_.SearchBus(bus_name)->stops)
+		{
+			stops_coordinates.push_back(stop->coordinates);
+		}
+	}
+	return SphereProjector(stops_coordinates.begin(), stops_coordinates.end(),
+		render_settings.width, render_settings.height, render_settings.padding);
+}
+
+vector<const transport::domain::Stop*> RequestHandler::GetStopsOfBuses(const transport::sv_set& valid_buses) const
+{
+	vector<const domain::Stop*> stops;
+	for (string_view bus_name : valid_buses)
+	{
+		const vector<const domain::Stop*>& bus_stops = db_.SearchBus(bus_name)->stops;
+		stops.insert(stops.end(), bus_stops.begin(), bus_stops.end());
+	}
+	SortStopsByName(stops);
+	return stops;
+}
+
+void RequestHandler::RenderRouteLines(svg::Writer& writer, const transport::sv_set& valid_buses,
+	const RenderSettings& render_settings, const SphereProjector& sphere_projector) const
+{
+	// Один буфер точек на все линии
+	vector<svg::Point> points;
+	size_t color_index = 0;
 	for (string_view bus_name : valid_buses)
 	{
-		picture.emplace_back(make_unique<RoutePolyline>(bus_to_points.at(bus_name),
-			bus_to_color.at(bus_name), render_settings.line_width));
+		points.clear();
+		for (const domain::Stop* stop : db_.SearchBus(bus_name)->stops)
+		{
+			points.push_back(sphere_projector(stop->coordinates));
+		}
+		WriteRouteLine(writer, points, render_settings.color_palette[color_index], render_settings.line_width);
+		color_index = (color_index + 1) % render_settings.color_palette.size();
 	}
 }
 
-void RequestHandler::RenderRouteNames(vector<unique_ptr<svg::Drawable>>& picture,
-	const transport::sv_set& valid_buses,
-	const unordered_map<string_view, svg::Color>& bus_to_color,
-	const RenderSettings& render_settings,
-	const SphereProjector& sphere_projector) const
+void RequestHandler::RenderRouteNames(svg::Writer& writer, const transport::sv_set& valid_buses,
+	const RenderSettings& render_settings, const SphereProjector& sphere_projector) const
 {
+	size_t color_index = 0;
 	for (string_view bus_name : valid_buses)
 	{
+		const svg::Color& color = render_settings.color_palette[color_index];
+		color_index = (color_index + 1) % render_settings.color_palette.size();
 		const domain::Bus* bus = db_.SearchBus(bus_name);
 		const domain::Stop* first_stop = bus->stops.front();
-		svg::Point first_stop_point = sphere_projector(first_stop->coordinates);
-		picture.emplace_back(make_unique<RouteName>(first_stop_point, render_settings.bus_label_offset,
-			render_settings.bus_label_font_size, string{ bus_name }, render_settings.underlayer_color,
-			render_settings.underlayer_width, bus_to_color.at(bus_name)));
+		WriteRouteName(writer, render_settings, sphere_projector(first_stop->coordinates), bus_name, color);
 		if (!bus->is_round)
 		{
-			int last_stop_index = bus->stops.size() / 2;
-			const domain::Stop* last_stop = bus->stops[last_stop_index];
+			const domain::Stop* last_stop = bus->stops[bus->stops.size() / 2];
 			if (first_stop != last_stop)
 			{
-				svg::Point last_stop_point = sphere_projector(last_stop->coordinates);
-				picture.emplace_back(make_unique<RouteName>(last_stop_point, render_settings.bus_label_offset,
-					render_settings.bus_label_font_size, string{ bus_name }, render_settings.underlayer_color,
-					render_settings.underlayer_width, bus_to_color.at(bus_name)));
+				WriteRouteName(writer, render_settings, sphere_projector(last_stop->coordinates), bus_name, color);
 			}
 		}
 	}
 }
 
-void RequestHandler::RenderStops(vector<unique_ptr<svg::Drawable>>& picture,
-	const transport::sv_set& valid_stops,
-	const RenderSettings& render_settings,
-	const SphereProjector& sphere_projector) const
+void RequestHandler::RenderStops(svg::Writer& writer, const vector<const domain::Stop*>& stops,
+	const RenderSettings& render_settings, const SphereProjector& sphere_projector) const
 {
-	for (string_view stop_name : valid_stops)
+	for (const domain::Stop* stop : stops)
 	{
-		picture.emplace_back(make_unique<StopCircle>(sphere_projector(db_.SearchStop(stop_name)->coordinates),
-			render_settings.stop_radius));
+		WriteStopCircle(writer, sphere_projector(stop->coordinates), render_settings.stop_radius);
 	}
 }
 
-void RequestHandler::RenderStopsNames(vector<unique_ptr<svg::Drawable>>& picture,
-	const transport::sv_set& valid_stops,
-	const RenderSettings& render_settings,
-	const SphereProjector& sphere_projector) const
+void RequestHandler::RenderStopsNames(svg::Writer& writer, const vector<const domain::Stop*>& stops,
+	const RenderSettings& render_settings, const SphereProjector& sphere_projector) const
 {
-	for (string_view stop_name : valid_stops)
+	for (const domain::Stop* stop : stops)
 	{
-		picture.emplace_back(make_unique<StopName>(sphere_projector(db_.SearchStop(stop_name)->coordinates),
-			render_settings.stop_label_offset, render_settings.stop_label_font_size, string{ stop_name },
-			render_settings.underlayer_color, render_settings.underlayer_width));
+		WriteStopName(writer, render_settings, sphere_projector(stop->coordinates), stop->name);
 	}
 }
@@ -2,17 +2,35 @@
 
 #include "transport_catalogue.h"
 #include "map_renderer.h"
+#include "map_tiles.h"
+#include "transport_router.h"
+#include "raptor_router.h"
 
+#include <memory>
+#include <mutex>
 #include <optional>
+#include <string>
 
 namespace transport::request_handler
 {
 
+// Отрисованная карта в виде строкового литерала JSON (SVG в кавычках, с экранированием)
+struct RenderedMap
+{
+	uint64_t catalogue_version = 0;
+	size_t settings_hash = 0;
+	std::string json;
+};
+
 class RequestHandler
 {
 public:
 	// MapRenderer понадобится в следующей части итогового проекта
 	RequestHandler(const TransportCatalogue& db, const renderer::MapRenderer& renderer);
+	// Маршрутизаторы строятся по routing_settings при первом запросе, которому они нужны:
+	// граф TransportRouter занимает O(ΣL²) рёбер и не нужен запросам Stop, Bus и Map
+	RequestHandler(const TransportCatalogue& db, const renderer::MapRenderer& renderer,
+		std::optional<router::RoutingSettings> routing_settings);
 
 	// Возвращает информацию о маршруте (запрос Bus)
 	std::optional<domain::RouteInfo> GetRouteInfo(std::string_view bus_name) const;
@@ -20,32 +38,84 @@ public:
 	// Возвращает маршруты, проходящие через остановку
 	const transport::sv_set* GetBusesByStop(std::string_view stop_name) const;
 
-	svg::Document RenderMap(const transport::sv_set& valid_buses) const;
+	// Пакетные варианты GetRouteInfo и GetBusesByStop: i-й результат относится к i-му имени.
+	// Поиск по именам и по объектам идёт блоками с предвыборкой (см. TransportCatalogue::SearchBuses)
+	void GetRouteInfos(const std::vector<std::string_view>& bus_names,
+		std::vector<std::optional<domain::RouteInfo>>& route_infos) const;
+	void GetBusesByStops(const std::vector<std::string_view>& stop_names,
+		std::vector<const transport::sv_set*>& buses) const;
+
+	// Записывает карту запроса Map: линии маршрутов, их названия, остановки и названия остановок.
+	// С уровнем детализации в настройках карта совпадает с плиткой zoom 0 из GetTileIndex
+	void RenderMap(const transport::sv_set& valid_buses, svg::Writer& writer) const;
+
+	// Карта запроса Map. Результат запоминается и возвращается повторно, пока не изменились
+	// версия каталога и настройки отрисовки; valid_buses должны определяться каталогом
+	std::shared_ptr<const RenderedMap> GetRenderedMap(const transport::sv_set& valid_buses) const;
+
+	// Выводит карту строковым литералом JSON, как RenderedMap::json, но без кэша: SVG экранируется
+	// и пишется в output частями по мере отрисовки, поэтому память не зависит от размера карты
+	void PrintMap(const transport::sv_set& valid_buses, std::ostream& output) const;
+
+	// Геометрия карты RenderMap с пространственными индексами для плиток (запрос MapTile).
+	// Строится один раз и обновляется так же, как кэш GetRenderedMap
+	std::shared_ptr<const renderer::TileIndex> GetTileIndex(const transport::sv_set& valid_buses) const;
+
+	// Слой с достижимыми остановками (запрос Isochrone) в той же проекции, что и карта RenderMap
+	void RenderIsochrone(const transport::sv_set& valid_buses,
+		const std::vector<std::pair<const domain::Stop*, double>>& reachable_stops, svg::Writer& writer) const;
+
+	// Остановки, достижимые от stop не более чем за max_time минут (запрос Isochrone)
+	std::vector<std::pair<const domain::Stop*, double>> GetReachableStops(const domain::Stop* stop,
+		double max_time) const;
+
+	// Возвращает время в пути от остановки до каждой из целевых остановок (строка запроса Matrix)
+	std::vector<std::optional<double>> GetTravelTimes(const domain::Stop* from,
+		const std::vector<const domain::Stop*>& targets) const;
+
+	// Строит маршрут между остановками (запрос Route). Движок GRAPH возвращает один
+	// самый быстрый маршрут (поиском A* при use_astar), RAPTOR — Парето-набор по числу пересадок и времени
+	std::vector<router::RouteResult> GetRoutes(const domain::Stop* from, const domain::Stop* to,
+		router::RoutingEngine engine, bool use_astar) const;
+
+	const domain::Stop* GetStop(std::string_view stop_name) const;
 
 private:
-	void RenderRouteLines(std::vector<std::unique_ptr<svg::Drawable>>& picture,
-		const transport::sv_set& valid_buses,
-		const std::unordered_map<std::string_view,
-		std::vector<svg::Point>>& bus_to_points,
-		const std::unordered_map<std::string_view, svg::Color>& bus_to_color,
+	// Бросают logic_error, если routing_settings не заданы
+	const router::TransportRouter& GetRouter() const;
+	const router::RaptorRouter& GetRaptorRouter() const;
+	renderer::SphereProjector MakeSphereProjector(const transport::sv_set& valid_buses,
 		const renderer::RenderSettings& render_settings) const;
-	void RenderRouteNames(std::vector<std::unique_ptr<svg::Drawable>>& picture, 
-		const transport::sv_set& valid_buses,
-		const std::unordered_map<std::string_view,
-		svg::Color>& bus_to_color,
+	// Остановки маршрутов valid_buses без повторов в порядке имён
+	std::vector<const domain::Stop*> GetStopsOfBuses(const transport::sv_set& valid_buses) const;
+	void RenderRouteLines(svg::Writer& writer, const transport::sv_set& valid_buses,
 		const renderer::RenderSettings& render_settings,
 		const renderer::SphereProjector& sphere_projector) const;
-	void RenderStops(std::vector<std::unique_ptr<svg::Drawable>>& picture, 
-		const transport::sv_set& valid_stops,
+	void RenderRouteNames(svg::Writer& writer, const transport::sv_set& valid_buses,
 		const renderer::RenderSettings& render_settings,
 		const renderer::SphereProjector& sphere_projector) const;
-	void RenderStopsNames(std::vector<std::unique_ptr<svg::Drawable>>& picture, 
-		const transport::sv_set& valid_stops,
+	void RenderStops(svg::Writer& writer, const std::vector<const domain::Stop*>& stops,
+		const renderer::RenderSettings& render_settings,
+		const renderer::SphereProjector& sphere_projector) const;
+	void RenderStopsNames(svg::Writer& writer, const std::vector<const domain::Stop*>& stops,
 		const renderer::RenderSettings& render_settings,
 		const renderer::SphereProjector& sphere_projector) const;
 
 	const TransportCatalogue& db_;
 	const renderer::MapRenderer& renderer_;
+	std::optional<router::RoutingSettings> routing_settings_;
+
+	mutable std::once_flag router_flag_;
+	mutable std::unique_ptr<const router::TransportRouter> router_;
+	mutable std::once_flag raptor_router_flag_;
+	mutable std::unique_ptr<const router::RaptorRouter> raptor_router_;
+
+	mutable std::mutex map_cache_mutex_;
+	mutable std::shared_ptr<const RenderedMap> map_cache_;
+	mutable std::mutex tile_index_mutex_;
+	mutable std::shared_ptr<const renderer::TileIndex> tile_index_;
+	mutable uint64_t tile_index_version_ = 0;
+	mutable size_t tile_index_settings_hash_ = 0;
 };
 
 } // namespace transport::request_handler
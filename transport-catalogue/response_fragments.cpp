@@ -0,0 +1,136 @@
+#include "response_fragments.h"
+
+#include <sstream>
+#include <stdexcept>
+
+using namespace std;
+using namespace transport;
+using namespace transport::json_reader;
+using namespace transport::domain;
+using namespace json;
+
+namespace
+{
+// Ключ с кавычками не встречается внутри строковых значений: кавычки в них экранируются
+const string_view REQUEST_ID_KEY = "\"request_id\": "sv;
+} // namespace
+
+Dict transport::json_reader::MakeStopResponse(const sv_set* buses)
+{
+	Array buses_array;
+	if (buses)
+	{
+		for (string_view bus_name : *buses)
+		{
+			buses_array.emplace_back(string{ bus_name });
+		}
+	}
+	return Dict{ {"buses"s, move(buses_array)} };
+}
+
+Dict transport::json_reader::MakeBusResponse(const RouteInfo& route_info)
+{
+	return Dict{
+		{"curvature"s, route_info.curvature},
+		{"route_length"s, route_info.real_length},
+		{"stop_count"s, route_info.n_stops},
+		{"unique_stop_count"s, route_info.n_unique_stops} };
+}
+
+size_t ResponseArena::Add(string_view response, int request_id)
+{
+	const string printed_id = to_string(request_id);
+	const size_t key = response.find(REQUEST_ID_KEY);
+	if (key == string_view::npos || response.substr(key + REQUEST_ID_KEY.size(), printed_id.size()) != printed_id)
+	{
+		throw logic_error("response has no request_id "s + printed_id);
+	}
+	const size_t split = key + REQUEST_ID_KEY.size();
+
+	Fragment fragment;
+	fragment.begin = buffer_.size();
+	fragment.split = fragment.begin + split;
+	buffer_.append(response.substr(0, split));
+	buffer_.append(response.substr(split + printed_id.size()));
+	fragment.end = buffer_.size();
+	fragments_.push_back(fragment);
+	return fragments_.size() - 1;
+}
+
+void ResponseArena::Write(size_t fragment, int request_id, ostream& output) const
+{
+	const Fragment& bounds = fragments_.at(fragment);
+	output.write(buffer_.data() + bounds.begin, bounds.split - bounds.begin);
+	output << request_id;
+	output.write(buffer_.data() + bounds.split, bounds.end - bounds.split);
+}
+
+size_t ResponseArena::GetSize() const
+{
+	return buffer_.size();
+}
+
+memory::Usage ResponseArena::GetMemoryUsage(string name) const
+{
+	memory::UsageCounter counter(move(name));
+	return counter.AddElements(fragments_.size()).AddString(buffer_).AddVector(fragments_).Get();
+}
+
+void ResponseArena::ShrinkToFit()
+{
+	buffer_.shrink_to_fit();
+	fragments_.shrink_to_fit();
+}
+
+ResponseFragments::ResponseFragments(const TransportCatalogue& tc, int indent)
+	: stops_count_(tc.GetStops().size())
+	, buses_count_(tc.GetBuses().size())
+	, indent_(indent)
+{
+	for (const Stop& stop : tc.GetStops())
+	{
+		AddResponse(MakeStopResponse(tc.GetStopToBuses(&stop)));
+	}
+	for (const Bus& bus : tc.GetBuses())
+	{
+		AddResponse(MakeBusResponse(tc.GetRouteInfo(&bus)));
+	}
+	arena_.ShrinkToFit();
+}
+
+void ResponseFragments::WriteStopResponse(size_t stop_id, int request_id, ostream& output) const
+{
+	if (stop_id >= stops_count_)
+	{
+		throw out_of_range("stop id is out of range"s);
+	}
+	arena_.Write(stop_id, request_id, output);
+}
+
+void ResponseFragments::WriteBusResponse(size_t bus_id, int request_id, ostream& output) const
+{
+	if (bus_id >= buses_count_)
+	{
+		throw out_of_range("bus id is out of range"s);
+	}
+	arena_.Write(stops_count_ + bus_id, request_id, output);
+}
+
+size_t ResponseFragments::GetArenaSize() const
+{
+	return arena_.GetSize();
+}
+
+memory::Usage ResponseFragments::GetMemoryUsage() const
+{
+	return arena_.GetMemoryUsage("response_fragments"s);
+}
+
+void ResponseFragments::AddResponse(Dict response)
+{
+	// Ответ печатается с request_id = 0, ноль вырезается при добавлении в буфер
+	response["request_id"s] = 0;
+	ostringstream printed;
+	Print(Document{ move(response) }, printed, indent_);
+	arena_.Add(printed.str(), 0);
+}
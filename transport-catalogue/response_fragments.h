@@ -0,0 +1,75 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "json.h"
+#include "memory_usage.h"
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace transport::json_reader
+{
+
+// Тела ответов на запросы Stop и Bus без request_id
+json::Dict MakeStopResponse(const sv_set* buses);
+json::Dict MakeBusResponse(const domain::RouteInfo& route_info);
+
+/*
+* Буфер напечатанных ответов, разрезанных в месте значения request_id: ответ хранится
+* один раз и выводится с любым номером запроса
+*/
+class ResponseArena
+{
+public:
+	// response — ответ в формате json::Print с номером request_id; возвращает номер фрагмента
+	size_t Add(std::string_view response, int request_id);
+	void Write(size_t fragment, int request_id, std::ostream& output) const;
+
+	size_t GetSize() const;
+	void ShrinkToFit();
+	memory::Usage GetMemoryUsage(std::string name) const;
+
+private:
+	// Ответ занимает [begin, end) в буфере, request_id вставляется в позицию split
+	struct Fragment
+	{
+		size_t begin;
+		size_t split;
+		size_t end;
+	};
+
+	std::string buffer_;
+	std::vector<Fragment> fragments_;
+};
+
+/*
+* Заранее сериализованные ответы на запросы Stop и Bus. Ответ на каждую остановку и каждый
+* автобус печатается один раз в общий буфер в формате json::Print и разрезается в месте
+* значения request_id; при запросе выводятся две части ответа и номер запроса между ними
+*/
+class ResponseFragments
+{
+public:
+	// indent — отступ ответа, как у остальных ответов Reader
+	ResponseFragments(const TransportCatalogue& tc, int indent);
+
+	// stop_id и bus_id — номера domain::Stop::id и domain::Bus::id
+	void WriteStopResponse(size_t stop_id, int request_id, std::ostream& output) const;
+	void WriteBusResponse(size_t bus_id, int request_id, std::ostream& output) const;
+
+	size_t GetArenaSize() const;
+	memory::Usage GetMemoryUsage() const;
+
+private:
+	void AddResponse(json::Dict response);
+
+	// Сначала фрагменты остановок в порядке id, затем фрагменты автобусов
+	ResponseArena arena_;
+	size_t stops_count_ = 0;
+	size_t buses_count_ = 0;
+	int indent_ = 0;
+};
+
+} // namespace transport::json_reader
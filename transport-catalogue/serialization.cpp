@@ -0,0 +1,316 @@
+#include "serialization.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <unordered_map>
+
+using namespace std;
+using namespace transport;
+using namespace transport::serialization;
+using namespace domain;
+
+namespace
+{
+const char SNAPSHOT_MAGIC[4] = { 'T', 'C', 'A', 'T' };
+const uint32_t SNAPSHOT_VERSION = 2;
+// Числа элементов и длины строк читаются из файла, поэтому память под них выделяется
+// не больше чем на столько элементов вперёд: повреждённый снимок заканчивается раньше
+const uint32_t MAX_RESERVED_COUNT = 1 << 16;
+
+template <typename Type>
+void WriteValue(ostream& output, Type value)
+{
+	static_assert(is_trivially_copyable_v<Type>);
+	output.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+template <typename Type>
+Type ReadValue(istream& input)
+{
+	static_assert(is_trivially_copyable_v<Type>);
+	Type value;
+	if (!input.read(reinterpret_cast<char*>(&value), sizeof(value)))
+	{
+		throw SerializationError("unexpected end of snapshot"s);
+	}
+	return value;
+}
+
+void WriteString(ostream& output, string_view str)
+{
+	WriteValue<uint32_t>(output, str.size());
+	output.write(str.data(), str.size());
+}
+
+string ReadString(istream& input)
+{
+	const uint32_t size = ReadValue<uint32_t>(input);
+	string str;
+	while (str.size() < size)
+	{
+		const size_t offset = str.size();
+		str.resize(offset + min(size - offset, static_cast<size_t>(MAX_RESERVED_COUNT)));
+		if (!input.read(str.data() + offset, str.size() - offset))
+		{
+			throw SerializationError("unexpected end of snapshot"s);
+		}
+	}
+	return str;
+}
+
+void WritePoint(ostream& output, svg::Point point)
+{
+	WriteValue(output, point.x);
+	WriteValue(output, point.y);
+}
+
+svg::Point ReadPoint(istream& input)
+{
+	double x = ReadValue<double>(input);
+	double y = ReadValue<double>(input);
+	return { x, y };
+}
+
+// Цвет хранится как номер альтернативы variant и её содержимое
+void WriteColor(ostream& output, const svg::Color& color)
+{
+	WriteValue<uint8_t>(output, color.index());
+	if (const string* name = get_if<string>(&color))
+	{
+		WriteString(output, *name);
+	}
+	else if (const svg::Rgb* rgb = get_if<svg::Rgb>(&color))
+	{
+		WriteValue(output, rgb->red);
+		WriteValue(output, rgb->green);
+		WriteValue(output, rgb->blue);
+	}
+	else if (const svg::Rgba* rgba = get_if<svg::Rgba>(&color))
+	{
+		WriteValue(output, rgba->red);
+		WriteValue(output, rgba->green);
+		WriteValue(output, rgba->blue);
+		WriteValue(output, rgba->opacity);
+	}
+}
+
+svg::Color ReadColor(istream& input)
+{
+	switch (ReadValue<uint8_t>(input))
+	{
+	case 0:
+		return svg::Color();
+	case 1:
+		return svg::Color(ReadString(input));
+	case 2:
+	{
+		uint8_t red = ReadValue<uint8_t>(input);
+		uint8_t green = ReadValue<uint8_t>(input);
+		uint8_t blue = ReadValue<uint8_t>(input);
+		return svg::Color(svg::Rgb{ red, green, blue });
+	}
+	case 3:
+	{
+		uint8_t red = ReadValue<uint8_t>(input);
+		uint8_t green = ReadValue<uint8_t>(input);
+		uint8_t blue = ReadValue<uint8_t>(input);
+		double opacity = ReadValue<double>(input);
+		return svg::Color(svg::Rgba{ red, green, blue, opacity });
+	}
+	default:
+		throw SerializationError("unknown color type in snapshot"s);
+	}
+}
+
+void WriteRenderSettings(ostream& output, const renderer::RenderSettings& settings)
+{
+	WriteValue(output, settings.width);
+	WriteValue(output, settings.height);
+	WriteValue(output, settings.padding);
+	WriteValue(output, settings.line_width);
+	WriteValue(output, settings.stop_radius);
+	WriteValue<int32_t>(output, settings.bus_label_font_size);
+	WritePoint(output, settings.bus_label_offset);
+	WriteValue<int32_t>(output, settings.stop_label_font_size);
+	WritePoint(output, settings.stop_label_offset);
+	WriteColor(output, settings.underlayer_color);
+	WriteValue(output, settings.underlayer_width);
+	WriteValue<uint32_t>(output, settings.color_palette.size());
+	for (const svg::Color& color : settings.color_palette)
+	{
+		WriteColor(output, color);
+	}
+	WriteValue(output, settings.simplify_tolerance);
+	WriteValue<uint8_t>(output, settings.hide_overlapping_labels);
+}
+
+renderer::RenderSettings ReadRenderSettings(istream& input)
+{
+	renderer::RenderSettings settings;
+	settings.width = ReadValue<double>(input);
+	settings.height = ReadValue<double>(input);
+	settings.padding = ReadValue<double>(input);
+	settings.line_width = ReadValue<double>(input);
+	settings.stop_radius = ReadValue<double>(input);
+	settings.bus_label_font_size = ReadValue<int32_t>(input);
+	settings.bus_label_offset = ReadPoint(input);
+	settings.stop_label_font_size = ReadValue<int32_t>(input);
+	settings.stop_label_offset = ReadPoint(input);
+	settings.underlayer_color = ReadColor(input);
+	settings.underlayer_width = ReadValue<double>(input);
+	uint32_t colors_count = ReadValue<uint32_t>(input);
+	for (uint32_t i = 0; i < colors_count; ++i)
+	{
+		settings.color_palette.push_back(ReadColor(input));
+	}
+	settings.simplify_tolerance = ReadValue<double>(input);
+	settings.hide_overlapping_labels = ReadValue<uint8_t>(input);
+	return settings;
+}
+
+void WriteRoutingSettings(ostream& output, const optional<router::RoutingSettings>& settings)
+{
+	WriteValue<uint8_t>(output, settings.has_value());
+	if (settings)
+	{
+		WriteValue<int32_t>(output, settings->bus_wait_time);
+		WriteValue(output, settings->bus_velocity);
+		WriteValue<uint8_t>(output, static_cast<uint8_t>(settings->engine));
+		WriteValue<uint8_t>(output, settings->use_astar);
+	}
+}
+
+optional<router::RoutingSettings> ReadRoutingSettings(istream& input)
+{
+	if (!ReadValue<uint8_t>(input))
+	{
+		return nullopt;
+	}
+	router::RoutingSettings settings;
+	settings.bus_wait_time = ReadValue<int32_t>(input);
+	settings.bus_velocity = ReadValue<double>(input);
+	settings.engine = static_cast<router::RoutingEngine>(ReadValue<uint8_t>(input));
+	settings.use_astar = ReadValue<uint8_t>(input);
+	return settings;
+}
+} // namespace
+
+void transport::serialization::SaveCatalogue(const TransportCatalogue& tc, const SnapshotSettings& settings,
+	ostream& output)
+{
+	output.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+	WriteValue(output, SNAPSHOT_VERSION);
+
+	unordered_map<const Stop*, uint32_t> stop_to_index;
+	uint32_t stop_index = 0;
+	WriteValue<uint32_t>(output, tc.GetStops().size());
+	for (const Stop& stop : tc.GetStops())
+	{
+		stop_to_index[&stop] = stop_index++;
+		WriteString(output, stop.name);
+		WriteValue(output, stop.coordinates.lat);
+		WriteValue(output, stop.coordinates.lng);
+	}
+
+	WriteValue<uint32_t>(output, tc.GetDistances().size());
+	for (const auto& [stops, distance] : tc.GetDistances())
+	{
+		WriteValue(output, stop_to_index.at(stops.first));
+		WriteValue(output, stop_to_index.at(stops.second));
+		WriteValue<int32_t>(output, distance);
+	}
+
+	WriteValue<uint32_t>(output, tc.GetBuses().size());
+	for (const Bus& bus : tc.GetBuses())
+	{
+		WriteString(output, bus.name);
+		WriteValue<uint8_t>(output, bus.is_round);
+		WriteValue<uint32_t>(output, bus.stops.size());
+		for (const Stop* stop : bus.stops)
+		{
+			WriteValue(output, stop_to_index.at(stop));
+		}
+	}
+
+	SaveSettings(settings, output);
+	if (!output)
+	{
+		throw SerializationError("failed to write snapshot"s);
+	}
+}
+
+SnapshotSettings transport::serialization::LoadCatalogue(istream& input, TransportCatalogue& tc)
+{
+	char magic[sizeof(SNAPSHOT_MAGIC)];
+	if (!input.read(magic, sizeof(magic)) || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0)
+	{
+		throw SerializationError("not a transport catalogue snapshot"s);
+	}
+	if (ReadValue<uint32_t>(input) != SNAPSHOT_VERSION)
+	{
+		throw SerializationError("unsupported snapshot version"s);
+	}
+
+	const uint32_t stops_count = ReadValue<uint32_t>(input);
+	vector<const Stop*> stops;
+	stops.reserve(min(stops_count, MAX_RESERVED_COUNT));
+	for (uint32_t i = 0; i < stops_count; ++i)
+	{
+		string name = ReadString(input);
+		double lat = ReadValue<double>(input);
+		double lng = ReadValue<double>(input);
+		tc.AddStop(name, { lat, lng });
+		stops.push_back(&tc.GetStops().back());
+	}
+	auto get_stop = [&stops](uint32_t index)
+	{
+		if (index >= stops.size())
+		{
+			throw SerializationError("stop index is out of range"s);
+		}
+		return stops[index];
+	};
+
+	uint32_t distances_count = ReadValue<uint32_t>(input);
+	for (uint32_t i = 0; i < distances_count; ++i)
+	{
+		const Stop* stop_a = get_stop(ReadValue<uint32_t>(input));
+		const Stop* stop_b = get_stop(ReadValue<uint32_t>(input));
+		tc.SetDistanceBetweenStops(stop_a, stop_b, ReadValue<int32_t>(input));
+	}
+
+	uint32_t buses_count = ReadValue<uint32_t>(input);
+	for (uint32_t i = 0; i < buses_count; ++i)
+	{
+		string name = ReadString(input);
+		bool is_round = ReadValue<uint8_t>(input);
+		const uint32_t bus_stops_count = ReadValue<uint32_t>(input);
+		vector<const Stop*> bus_stops;
+		bus_stops.reserve(min(bus_stops_count, MAX_RESERVED_COUNT));
+		unordered_set<string_view> unique_stops;
+		for (uint32_t j = 0; j < bus_stops_count; ++j)
+		{
+			bus_stops.push_back(get_stop(ReadValue<uint32_t>(input)));
+			unique_stops.insert(bus_stops.back()->name);
+		}
+		tc.AddBus(name, move(bus_stops), unique_stops, is_round);
+	}
+
+	return LoadSettings(input);
+}
+
+void transport::serialization::SaveSettings(const SnapshotSettings& settings, ostream& output)
+{
+	WriteRenderSettings(output, settings.render_settings);
+	WriteRoutingSettings(output, settings.routing_settings);
+}
+
+SnapshotSettings transport::serialization::LoadSettings(istream& input)
+{
+	SnapshotSettings settings;
+	settings.render_settings = ReadRenderSettings(input);
+	settings.routing_settings = ReadRoutingSettings(input);
+	return settings;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "map_renderer.h"
+#include "transport_router.h"
+
+#include <iostream>
+#include <optional>
+#include <stdexcept>
+
+namespace transport::serialization
+{
+
+// Эта ошибка выбрасывается при чтении повреждённого или несовместимого снимка базы
+class SerializationError : public std::runtime_error
+{
+public:
+	using runtime_error::runtime_error;
+};
+
+// Настройки, сохраняемые в снимке вместе с каталогом
+struct SnapshotSettings
+{
+	renderer::RenderSettings render_settings;
+	std::optional<router::RoutingSettings> routing_settings;
+};
+
+/*
+* Двоичный снимок базы: остановки, расстояния, автобусы (остановки задаются индексами)
+* и настройки. Информация о маршрутах (RouteInfo) при загрузке пересчитывается в AddBus
+*/
+void SaveCatalogue(const TransportCatalogue& tc, const SnapshotSettings& settings, std::ostream& output);
+
+// Заполняет пустой каталог tc из снимка и возвращает сохранённые настройки
+SnapshotSettings LoadCatalogue(std::istream& input, TransportCatalogue& tc);
+
+// Настройки в том же двоичном виде, что и в снимке (используется другими форматами снимков)
+void SaveSettings(const SnapshotSettings& settings, std::ostream& output);
+SnapshotSettings LoadSettings(std::istream& input);
+
+} // namespace transport::serialization
@@ -0,0 +1,517 @@
+#include "server.h"
+
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+#include <fcntl.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+using namespace transport::server;
+
+namespace
+{
+const size_t READ_BUFFER_SIZE = 1 << 16;
+const size_t MAX_EVENTS = 64;
+// Пока у соединения столько запросов без ответа, новые запросы из него не читаются.
+// Каждый такой запрос может держать целый ответ (Map — мегабайты), поэтому очередь неглубокая
+const uint64_t MAX_PENDING_REQUESTS = 128;
+// Пока у соединения столько байт ответов не отправлено, новые запросы из него не читаются:
+// клиент, который не читает ответы, иначе копил бы их в памяти сервера без ограничений
+const size_t MAX_PENDING_OUTPUT = 4 << 20;
+// В формате ответа на неразобранный запрос
+const string_view LINE_TOO_LONG_RESPONSE = "{\"error_message\": \"request is too long\",\"request_id\": null}"sv;
+
+[[noreturn]] void ThrowSystemError(const string& what)
+{
+	throw system_error(errno, generic_category(), what);
+}
+
+sigset_t GetStopSignals()
+{
+	sigset_t signals;
+	sigemptyset(&signals);
+	sigaddset(&signals, SIGINT);
+	sigaddset(&signals, SIGTERM);
+	return signals;
+}
+
+void CloseFd(int& fd)
+{
+	if (fd >= 0)
+	{
+		close(fd);
+		fd = -1;
+	}
+}
+} // namespace
+
+Server::Server(ServerSettings settings, LineHandler handler)
+	: settings_(move(settings)), handler_(move(handler))
+{
+	// Сигналы остановки принимаются через signalfd, поэтому блокируются до создания любых потоков
+	sigset_t signals = GetStopSignals();
+	pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+	// Закрытое клиентом соединение обрабатывается как ошибка записи
+	signal(SIGPIPE, SIG_IGN);
+}
+
+Server::~Server()
+{
+	// Сначала дожидаемся рабочих потоков: они пишут в completions_ и wake_fd_
+	pool_.reset();
+	for (auto& [id, connection] : connections_)
+	{
+		if (connection.input_fd != STDIN_FILENO)
+		{
+			CloseFd(connection.input_fd);
+		}
+	}
+	// После закрытия канала поток перекачки stdin завершается ошибкой записи
+	if (stdin_pump_.joinable())
+	{
+		stdin_pump_.join();
+	}
+	if (listen_fd_ >= 0)
+	{
+		CloseFd(listen_fd_);
+		unlink(settings_.socket_path.c_str());
+	}
+	CloseFd(signal_fd_);
+	CloseFd(wake_fd_);
+	CloseFd(epoll_fd_);
+}
+
+void Server::Run()
+{
+	sigset_t signals = GetStopSignals();
+	epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd_ < 0)
+	{
+		ThrowSystemError("epoll_create1"s);
+	}
+	wake_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	signal_fd_ = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+	if (wake_fd_ < 0 || signal_fd_ < 0)
+	{
+		ThrowSystemError("eventfd/signalfd"s);
+	}
+	Watch(wake_fd_, EPOLLIN);
+	Watch(signal_fd_, EPOLLIN);
+
+	pool_ = make_unique<concurrent::ThreadPool>(settings_.threads_count);
+	if (settings_.socket_path.empty())
+	{
+		OpenStdin();
+	}
+	else
+	{
+		Listen();
+	}
+
+	epoll_event events[MAX_EVENTS];
+	while (!is_stopped_)
+	{
+		int events_count = epoll_wait(epoll_fd_, events, MAX_EVENTS, -1);
+		if (events_count < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			ThrowSystemError("epoll_wait"s);
+		}
+		for (int i = 0; i < events_count; ++i)
+		{
+			const int fd = events[i].data.fd;
+			if (fd == wake_fd_)
+			{
+				HandleCompletions();
+			}
+			else if (fd == signal_fd_)
+			{
+				is_stopped_ = true;
+			}
+			else if (fd == listen_fd_)
+			{
+				AcceptConnections();
+			}
+			else
+			{
+				HandleConnectionEvent(fd, events[i].events);
+			}
+		}
+	}
+}
+
+void Server::Listen()
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (settings_.socket_path.size() >= sizeof(address.sun_path))
+	{
+		throw invalid_argument("socket path is too long: "s + settings_.socket_path);
+	}
+	strcpy(address.sun_path, settings_.socket_path.c_str());
+
+	listen_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if (listen_fd_ < 0)
+	{
+		ThrowSystemError("socket"s);
+	}
+	// Файл сокета мог остаться от предыдущего запуска
+	unlink(settings_.socket_path.c_str());
+	if (bind(listen_fd_, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0
+		|| listen(listen_fd_, SOMAXCONN) != 0)
+	{
+		ThrowSystemError("failed to listen on "s + settings_.socket_path);
+	}
+	Watch(listen_fd_, EPOLLIN);
+}
+
+void Server::OpenStdin()
+{
+	Connection connection;
+	connection.input_fd = STDIN_FILENO;
+	connection.output_fd = STDOUT_FILENO;
+
+	// Обычные файлы и /dev/null не поддерживают epoll: их содержимое перекачивается через канал
+	epoll_event event{};
+	event.events = EPOLLIN;
+	event.data.fd = STDIN_FILENO;
+	if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, STDIN_FILENO, &event) == 0)
+	{
+		epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, STDIN_FILENO, nullptr);
+	}
+	else if (errno == EPERM)
+	{
+		int pipe_fds[2];
+		if (pipe2(pipe_fds, O_CLOEXEC) != 0)
+		{
+			ThrowSystemError("pipe2"s);
+		}
+		connection.input_fd = pipe_fds[0];
+		stdin_pump_ = thread([write_fd = pipe_fds[1]]
+			{
+				char buffer[READ_BUFFER_SIZE];
+				ssize_t size;
+				while ((size = read(STDIN_FILENO, buffer, sizeof(buffer))) > 0)
+				{
+					for (ssize_t written = 0; written < size;)
+					{
+						ssize_t result = write(write_fd, buffer + written, size - written);
+						if (result < 0)
+						{
+							close(write_fd);
+							return;
+						}
+						written += result;
+					}
+				}
+				close(write_fd);
+			});
+	}
+	else
+	{
+		ThrowSystemError("epoll_ctl"s);
+	}
+	AddConnection(move(connection));
+}
+
+void Server::AddConnection(Connection connection)
+{
+	const uint64_t id = next_connection_id_++;
+	fd_to_connection_[connection.input_fd] = id;
+	connections_.emplace(id, move(connection));
+	UpdateConnection(id);
+}
+
+void Server::AcceptConnections()
+{
+	for (;;)
+	{
+		int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if (fd < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED)
+			{
+				return;
+			}
+			ThrowSystemError("accept4"s);
+		}
+		Connection connection;
+		connection.input_fd = fd;
+		connection.output_fd = fd;
+		connection.is_socket = true;
+		AddConnection(move(connection));
+	}
+}
+
+void Server::HandleConnectionEvent(int fd, uint32_t events)
+{
+	auto it = fd_to_connection_.find(fd);
+	if (it == fd_to_connection_.end())
+	{
+		return;
+	}
+	const uint64_t id = it->second;
+	Connection& connection = connections_.at(id);
+	// EPOLLHUP и EPOLLERR приходят и без EPOLLIN: после ошибки длинной строки
+	// оставшиеся в сокете запросы уже не принимаются
+	if ((events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !connection.is_input_closed)
+	{
+		ReadRequests(connection);
+	}
+	if (events & EPOLLOUT)
+	{
+		FlushOutput(connection);
+	}
+	UpdateConnection(id);
+}
+
+void Server::ReadRequests(Connection& connection)
+{
+	// Уровневый режим epoll: одного чтения за событие достаточно, остаток придёт следующим событием
+	char buffer[READ_BUFFER_SIZE];
+	ssize_t size = read(connection.input_fd, buffer, sizeof(buffer));
+	if (size < 0)
+	{
+		if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+		{
+			connection.is_broken = true;
+		}
+		return;
+	}
+	if (size == 0)
+	{
+		connection.is_input_closed = true;
+		return;
+	}
+	connection.input.append(buffer, size);
+}
+
+bool Server::CanAcceptRequests(const Connection& connection) const
+{
+	return connection.next_sequence - connection.next_to_write < MAX_PENDING_REQUESTS
+		&& connection.output.size() - connection.output_offset < MAX_PENDING_OUTPUT;
+}
+
+void Server::SubmitBufferedRequests(uint64_t connection_id, Connection& connection)
+{
+	size_t line_begin = 0;
+	for (size_t line_end; CanAcceptRequests(connection)
+		&& (line_end = connection.input.find('\n', line_begin)) != string::npos; line_begin = line_end + 1)
+	{
+		if (line_end - line_begin > settings_.max_line_length)
+		{
+			RejectLongLine(connection);
+			return;
+		}
+		SubmitRequest(connection_id, connection, connection.input.substr(line_begin, line_end - line_begin));
+	}
+	connection.input.erase(0, line_begin);
+	const size_t last_line_size = connection.input.size() - (connection.input.rfind('\n') + 1);
+	if (!connection.is_input_closed)
+	{
+		// Без перевода строки незавершённая строка иначе копилась бы в памяти без ограничений
+		if (last_line_size > settings_.max_line_length)
+		{
+			RejectLongLine(connection);
+		}
+	}
+	else if (last_line_size == connection.input.size() && !connection.input.empty() && CanAcceptRequests(connection))
+	{
+		// Последняя строка ввода может быть без перевода строки
+		SubmitRequest(connection_id, connection, move(connection.input));
+		connection.input.clear();
+	}
+}
+
+void Server::SubmitRequest(uint64_t connection_id, Connection& connection, string line)
+{
+	if (!line.empty() && line.back() == '\r')
+	{
+		line.pop_back();
+	}
+	if (line.find_first_not_of(" \t"s) == string::npos)
+	{
+		return;
+	}
+	const uint64_t sequence = connection.next_sequence++;
+	pool_->Submit([this, connection_id, sequence, line = move(line)]
+		{
+			string response = handler_(line);
+			{
+				lock_guard lock(completions_mutex_);
+				completions_.push_back({ connection_id, sequence, move(response) });
+			}
+			const uint64_t one = 1;
+			[[maybe_unused]] ssize_t result = write(wake_fd_, &one, sizeof(one));
+		});
+}
+
+void Server::RejectLongLine(Connection& connection)
+{
+	// Уже принятые запросы получают ответы, после них выводится ошибка и соединение закрывается
+	connection.input.clear();
+	connection.input.shrink_to_fit();
+	connection.is_input_closed = true;
+	AddResponse(connection, connection.next_sequence++, string(LINE_TOO_LONG_RESPONSE));
+	FlushOutput(connection);
+}
+
+void Server::AddResponse(Connection& connection, uint64_t sequence, string response)
+{
+	connection.ready_responses.emplace(sequence, move(response));
+	for (auto ready = connection.ready_responses.begin();
+		ready != connection.ready_responses.end() && ready->first == connection.next_to_write;
+		ready = connection.ready_responses.erase(ready))
+	{
+		connection.output += ready->second;
+		connection.output += '\n';
+		++connection.next_to_write;
+	}
+}
+
+void Server::HandleCompletions()
+{
+	uint64_t counter;
+	[[maybe_unused]] ssize_t result = read(wake_fd_, &counter, sizeof(counter));
+	vector<Completion> completions;
+	{
+		lock_guard lock(completions_mutex_);
+		completions.swap(completions_);
+	}
+
+	vector<uint64_t> updated;
+	for (Completion& completion : completions)
+	{
+		auto it = connections_.find(completion.connection_id);
+		if (it == connections_.end())
+		{
+			continue;
+		}
+		AddResponse(it->second, completion.sequence, move(completion.response));
+		updated.push_back(completion.connection_id);
+	}
+	for (uint64_t id : updated)
+	{
+		auto it = connections_.find(id);
+		if (it != connections_.end())
+		{
+			FlushOutput(it->second);
+			UpdateConnection(id);
+		}
+	}
+}
+
+void Server::FlushOutput(Connection& connection)
+{
+	while (connection.output_offset < connection.output.size() && !connection.is_broken)
+	{
+		const char* data = connection.output.data() + connection.output_offset;
+		const size_t size = connection.output.size() - connection.output_offset;
+		ssize_t written = connection.is_socket
+			? send(connection.output_fd, data, size, MSG_NOSIGNAL)
+			: write(connection.output_fd, data, size);
+		if (written < 0)
+		{
+			if (errno == EAGAIN || errno == EWOULDBLOCK)
+			{
+				// Отправленное начало удаляется, когда составляет не меньше половины буфера,
+				// поэтому каждый байт сдвигается в среднем не больше одного раза
+				if (connection.output_offset >= connection.output.size() / 2)
+				{
+					connection.output.erase(0, connection.output_offset);
+					connection.output_offset = 0;
+				}
+				return;
+			}
+			if (errno != EINTR)
+			{
+				connection.is_broken = true;
+			}
+			continue;
+		}
+		connection.output_offset += written;
+	}
+	connection.output.clear();
+	connection.output_offset = 0;
+}
+
+void Server::UpdateConnection(uint64_t connection_id)
+{
+	Connection& connection = connections_.at(connection_id);
+	if (!connection.is_broken)
+	{
+		SubmitBufferedRequests(connection_id, connection);
+	}
+	const bool is_finished = connection.is_input_closed && connection.input.empty()
+		&& connection.next_to_write == connection.next_sequence && connection.output.empty();
+	if (connection.is_broken || is_finished)
+	{
+		if (connection.watched_events != 0)
+		{
+			epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, connection.input_fd, nullptr);
+		}
+		fd_to_connection_.erase(connection.input_fd);
+		if (!connection.is_socket)
+		{
+			// Соединение stdin единственное: с его закрытием сервер завершается
+			is_stopped_ = true;
+		}
+		if (connection.input_fd != STDIN_FILENO)
+		{
+			CloseFd(connection.input_fd);
+		}
+		connections_.erase(connection_id);
+		return;
+	}
+
+	uint32_t events = 0;
+	if (!connection.is_input_closed && CanAcceptRequests(connection))
+	{
+		events |= EPOLLIN;
+	}
+	if (connection.is_socket && !connection.output.empty())
+	{
+		events |= EPOLLOUT;
+	}
+	if (events == connection.watched_events)
+	{
+		return;
+	}
+	epoll_event event{};
+	event.events = events;
+	event.data.fd = connection.input_fd;
+	int operation = connection.watched_events == 0 ? EPOLL_CTL_ADD : events == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
+	if (epoll_ctl(epoll_fd_, operation, connection.input_fd, &event) != 0)
+	{
+		ThrowSystemError("epoll_ctl"s);
+	}
+	connection.watched_events = events;
+}
+
+void Server::Watch(int fd, uint32_t events)
+{
+	epoll_event event{};
+	event.events = events;
+	event.data.fd = fd;
+	if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0)
+	{
+		ThrowSystemError("epoll_ctl"s);
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "thread_pool.h"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace transport::server
+{
+
+struct ServerSettings
+{
+	// Пустой путь — запросы читаются из stdin, ответы пишутся в stdout
+	std::string socket_path;
+	size_t threads_count = 1;
+	// Строка-запрос длиннее этого числа байт получает ответ с ошибкой, и соединение закрывается
+	size_t max_line_length = 1 << 20;
+};
+
+// Отвечает на одну строку-запрос одной строкой без перевода строки.
+// Вызывается из рабочих потоков одновременно и не должна выбрасывать исключений
+using LineHandler = std::function<std::string(const std::string& line)>;
+
+/*
+* Сервер запросов, разделённых переводами строк: на каждый запрос выводится одна строка ответа.
+* Соединения обслуживает цикл epoll в одном потоке, запросы выполняются на пуле потоков,
+* а ответы в пределах соединения выводятся в порядке запросов.
+* В режиме stdin работа завершается по концу ввода, в режиме сокета — по SIGINT или SIGTERM.
+* Конструктор блокирует эти сигналы в вызывающем потоке, поэтому сервер нужно создать
+* раньше остальных потоков процесса
+*/
+class Server
+{
+public:
+	Server(ServerSettings settings, LineHandler handler);
+	Server(const Server&) = delete;
+	Server& operator=(const Server&) = delete;
+	~Server();
+
+	void Run();
+
+private:
+	struct Connection
+	{
+		int input_fd = -1;
+		int output_fd = -1;
+		bool is_socket = false;
+		std::string input;
+		std::string output;
+		size_t output_offset = 0;
+		uint64_t next_sequence = 0;
+		uint64_t next_to_write = 0;
+		// Ответы, готовые раньше предшествующих им запросов
+		std::map<uint64_t, std::string> ready_responses;
+		bool is_input_closed = false;
+		bool is_broken = false;
+		uint32_t watched_events = 0;
+	};
+
+	struct Completion
+	{
+		uint64_t connection_id;
+		uint64_t sequence;
+		std::string response;
+	};
+
+	void Listen();
+	void OpenStdin();
+	void AddConnection(Connection connection);
+	void AcceptConnections();
+	void HandleConnectionEvent(int fd, uint32_t events);
+	void ReadRequests(Connection& connection);
+	// Запросы не принимаются, пока у соединения слишком много запросов без ответа
+	// или неотправленных байт ответов
+	bool CanAcceptRequests(const Connection& connection) const;
+	// Отправляет на пул прочитанные строки, пока соединение принимает запросы; остальные ждут в input
+	void SubmitBufferedRequests(uint64_t connection_id, Connection& connection);
+	void SubmitRequest(uint64_t connection_id, Connection& connection, std::string line);
+	// Отвечает ошибкой на слишком длинную строку и перестаёт читать соединение
+	void RejectLongLine(Connection& connection);
+	// Выводит ответы, чья очередь подошла, в буфер соединения
+	void AddResponse(Connection& connection, uint64_t sequence, std::string response);
+	void HandleCompletions();
+	void FlushOutput(Connection& connection);
+	void UpdateConnection(uint64_t connection_id);
+	void Watch(int fd, uint32_t events);
+
+	ServerSettings settings_;
+	LineHandler handler_;
+	int epoll_fd_ = -1;
+	int listen_fd_ = -1;
+	int wake_fd_ = -1;
+	int signal_fd_ = -1;
+	std::thread stdin_pump_;
+	bool is_stopped_ = false;
+
+	std::unordered_map<uint64_t, Connection> connections_;
+	std::unordered_map<int, uint64_t> fd_to_connection_;
+	uint64_t next_connection_id_ = 0;
+
+	std::mutex completions_mutex_;
+	std::vector<Completion> completions_;
+
+	std::unique_ptr<concurrent::ThreadPool> pool_;
+};
+
+} // namespace transport::server
@@ -0,0 +1,533 @@
+#include "snapshot_patch.h"
+#include "mapped_layout.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <unordered_map>
+
+using namespace std;
+using namespace transport;
+using namespace transport::serialization;
+using namespace domain;
+
+namespace
+{
+
+// Массив записей снимка с изменёнными и добавленными записями поверх исходного
+template <typename Record>
+class RecordsPatch
+{
+public:
+	RecordsPatch(const Record* base, uint32_t base_count)
+		: base_(base), base_count_(base_count)
+	{
+	}
+
+	const Record& Get(uint32_t id) const
+	{
+		if (id >= base_count_)
+		{
+			return appended_[id - base_count_];
+		}
+		auto it = changed_.find(id);
+		return it == changed_.end() ? base_[id] : it->second;
+	}
+
+	Record& Edit(uint32_t id)
+	{
+		if (id >= base_count_)
+		{
+			return appended_[id - base_count_];
+		}
+		return changed_.emplace(id, base_[id]).first->second;
+	}
+
+	uint32_t Append(const Record& record)
+	{
+		appended_.push_back(record);
+		return base_count_ + appended_.size() - 1;
+	}
+
+	uint32_t GetCount() const
+	{
+		return base_count_ + appended_.size();
+	}
+
+	uint64_t Write(SectionWriter& writer) const
+	{
+		uint64_t offset = writer.Begin();
+		writer.Extend(reinterpret_cast<const char*>(base_), base_count_ * sizeof(Record));
+		for (const auto& [id, record] : changed_)
+		{
+			memcpy(writer.GetBuffer().data() + offset + id * sizeof(Record), &record, sizeof(Record));
+		}
+		writer.Extend(reinterpret_cast<const char*>(appended_.data()), appended_.size() * sizeof(Record));
+		return offset;
+	}
+
+private:
+	const Record* base_;
+	uint32_t base_count_;
+	map<uint32_t, Record> changed_;
+	vector<Record> appended_;
+};
+
+// CSR-массив с заменёнными строками поверх исходного; строки за пределами исходного пусты
+template <typename Value>
+class CsrPatch
+{
+public:
+	CsrPatch(const uint32_t* index, const Value* values, uint32_t base_rows)
+		: index_(index), values_(values), base_rows_(base_rows)
+	{
+	}
+
+	vector<Value> GetRow(uint32_t row) const
+	{
+		if (auto it = changed_rows_.find(row); it != changed_rows_.end())
+		{
+			return it->second;
+		}
+		if (row >= base_rows_)
+		{
+			return {};
+		}
+		return { values_ + index_[row], values_ + index_[row + 1] };
+	}
+
+	vector<Value>& EditRow(uint32_t row)
+	{
+		auto it = changed_rows_.find(row);
+		if (it == changed_rows_.end())
+		{
+			it = changed_rows_.emplace(row, GetRow(row)).first;
+		}
+		return it->second;
+	}
+
+	// Записывает индекс и значения для rows строк; неизменённые участки значений копируются одним блоком
+	pair<uint64_t, uint64_t> Write(SectionWriter& writer, uint32_t rows) const
+	{
+		vector<uint32_t> index(rows + 1, 0);
+		uint32_t value_count = 0;
+		for (uint32_t row = 0; row < rows; ++row)
+		{
+			index[row] = value_count;
+			auto it = changed_rows_.find(row);
+			if (it != changed_rows_.end())
+			{
+				value_count += it->second.size();
+			}
+			else if (row < base_rows_)
+			{
+				value_count += index_[row + 1] - index_[row];
+			}
+		}
+		index[rows] = value_count;
+		uint64_t index_offset = writer.Append(index);
+
+		uint64_t values_offset = writer.Begin();
+		uint32_t copied_rows = 0;
+		auto copy_base_rows = [&](uint32_t end_row)
+		{
+			end_row = min(end_row, base_rows_);
+			if (copied_rows < end_row)
+			{
+				writer.Extend(reinterpret_cast<const char*>(values_ + index_[copied_rows]),
+					(index_[end_row] - index_[copied_rows]) * sizeof(Value));
+			}
+		};
+		for (const auto& [row, values] : changed_rows_)
+		{
+			if (row >= rows)
+			{
+				break;
+			}
+			copy_base_rows(row);
+			writer.Extend(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(Value));
+			copied_rows = row + 1;
+		}
+		copy_base_rows(rows);
+		return { index_offset, values_offset };
+	}
+
+private:
+	const uint32_t* index_;
+	const Value* values_;
+	uint32_t base_rows_;
+	map<uint32_t, vector<Value>> changed_rows_;
+};
+
+} // namespace
+
+namespace transport::serialization
+{
+
+class SnapshotPatcher
+{
+public:
+	explicit SnapshotPatcher(const MappedCatalogue& base)
+		: base_(base),
+		header_(*base.header_),
+		stops_(base.stops_, base.header_->stop_count),
+		buses_(base.buses_, base.header_->bus_count),
+		stop_buses_(base.stop_buses_index_, base.stop_buses_, base.header_->stop_count),
+		bus_stops_(base.bus_stops_index_, base.bus_stops_, base.header_->bus_count),
+		distances_(base.distances_index_, base.distances_, base.header_->stop_count)
+	{
+		// Патч читает массивы снимка без проверок и всё равно копирует его целиком
+		base.Validate();
+	}
+
+	void Apply(const CataloguePatch& patch)
+	{
+		for (const StopPatch& stop_patch : patch.stops)
+		{
+			ApplyStop(stop_patch);
+		}
+		// Расстояния применяются после остановок: они могут ссылаться на добавленные в том же патче
+		for (const StopPatch& stop_patch : patch.stops)
+		{
+			if (!stop_patch.is_removed)
+			{
+				ApplyDistances(stop_patch);
+			}
+		}
+		for (const BusPatch& bus_patch : patch.buses)
+		{
+			ApplyBus(bus_patch);
+		}
+		for (uint32_t stop : removed_stops_)
+		{
+			vector<uint32_t> stop_buses = stop_buses_.GetRow(stop);
+			if (!stop_buses.empty())
+			{
+				throw invalid_argument("stop "s + string{ GetStopName(stop) } + " is still used by bus "s
+					+ string{ GetBusName(stop_buses.front()) });
+			}
+		}
+		UpdateRouteInfo();
+	}
+
+	void Write(ostream& output) const
+	{
+		MappedHeader header = header_;
+		header.stop_count = stops_.GetCount();
+		header.bus_count = buses_.GetCount();
+
+		SectionWriter writer;
+		writer.Append(reinterpret_cast<const char*>(&header), sizeof(header));
+		header.strings_offset = writer.Begin();
+		writer.Extend(base_.strings_, header_.strings_size);
+		writer.Extend(appended_strings_.data(), appended_strings_.size());
+		header.strings_size = header_.strings_size + appended_strings_.size();
+		header.stops_offset = stops_.Write(writer);
+		header.buses_offset = buses_.Write(writer);
+
+		vector<uint32_t> stop_hash = GetHashTable(base_.stop_hash_, header_.stop_hash_capacity, stops_,
+			added_stops_, are_stops_removed_, [this](uint32_t id) { return GetStopName(id); });
+		header.stop_hash_capacity = stop_hash.size();
+		header.stop_hash_offset = writer.Append(stop_hash);
+		vector<uint32_t> bus_hash = GetHashTable(base_.bus_hash_, header_.bus_hash_capacity, buses_,
+			added_buses_, are_buses_removed_, [this](uint32_t id) { return GetBusName(id); });
+		header.bus_hash_capacity = bus_hash.size();
+		header.bus_hash_offset = writer.Append(bus_hash);
+
+		tie(header.stop_buses_index_offset, header.stop_buses_offset) = stop_buses_.Write(writer, header.stop_count);
+		tie(header.bus_stops_index_offset, header.bus_stops_offset) = bus_stops_.Write(writer, header.bus_count);
+		tie(header.distances_index_offset, header.distances_offset) = distances_.Write(writer, header.stop_count);
+		header.settings_offset = writer.Append(base_.data_ + header_.settings_offset, header_.settings_size);
+		header.file_size = writer.GetBuffer().size();
+		memcpy(writer.GetBuffer().data(), &header, sizeof(header));
+
+		output.write(writer.GetBuffer().data(), writer.GetBuffer().size());
+		if (!output)
+		{
+			throw SerializationError("failed to write snapshot"s);
+		}
+	}
+
+private:
+	optional<uint32_t> FindStop(const string& name) const
+	{
+		if (auto it = added_stops_.find(name); it != added_stops_.end())
+		{
+			return it->second;
+		}
+		optional<uint32_t> stop = base_.FindStop(name);
+		if (stop && stops_.Get(*stop).flags & RECORD_REMOVED)
+		{
+			return nullopt;
+		}
+		return stop;
+	}
+
+	optional<uint32_t> FindBus(const string& name) const
+	{
+		if (auto it = added_buses_.find(name); it != added_buses_.end())
+		{
+			return it->second;
+		}
+		optional<uint32_t> bus = base_.FindBus(name);
+		if (bus && buses_.Get(*bus).flags & RECORD_REMOVED)
+		{
+			return nullopt;
+		}
+		return bus;
+	}
+
+	uint32_t GetExistingStop(const string& name) const
+	{
+		optional<uint32_t> stop = FindStop(name);
+		if (!stop)
+		{
+			throw invalid_argument("unknown stop "s + name);
+		}
+		return *stop;
+	}
+
+	string_view GetString(uint32_t offset, uint32_t length) const
+	{
+		if (offset >= header_.strings_size)
+		{
+			return string_view{ appended_strings_ }.substr(offset - header_.strings_size, length);
+		}
+		return base_.GetString(offset, length);
+	}
+
+	string_view GetStopName(uint32_t stop) const
+	{
+		const MappedStop& record = stops_.Get(stop);
+		return GetString(record.name_offset, record.name_length);
+	}
+
+	string_view GetBusName(uint32_t bus) const
+	{
+		const MappedBus& record = buses_.Get(bus);
+		return GetString(record.name_offset, record.name_length);
+	}
+
+	uint32_t AddString(const string& str)
+	{
+		uint32_t offset = header_.strings_size + appended_strings_.size();
+		appended_strings_ += str;
+		return offset;
+	}
+
+	void ApplyStop(const StopPatch& stop_patch)
+	{
+		optional<uint32_t> stop = FindStop(stop_patch.name);
+		if (stop_patch.is_removed)
+		{
+			if (!stop)
+			{
+				throw invalid_argument("unknown stop "s + stop_patch.name);
+			}
+			stops_.Edit(*stop).flags |= RECORD_REMOVED;
+			distances_.EditRow(*stop).clear();
+			added_stops_.erase(stop_patch.name);
+			removed_stops_.push_back(*stop);
+			are_stops_removed_ = true;
+			return;
+		}
+		if (!stop)
+		{
+			if (!stop_patch.coordinates)
+			{
+				throw invalid_argument("coordinates are required for new stop "s + stop_patch.name);
+			}
+			uint32_t name_offset = AddString(stop_patch.name);
+			stop = stops_.Append({ name_offset, static_cast<uint32_t>(stop_patch.name.size()), 0, 0,
+				stop_patch.coordinates->lat, stop_patch.coordinates->lng });
+			added_stops_[stop_patch.name] = *stop;
+		}
+		else if (stop_patch.coordinates)
+		{
+			MappedStop& record = stops_.Edit(*stop);
+			record.lat = stop_patch.coordinates->lat;
+			record.lng = stop_patch.coordinates->lng;
+			moved_stops_.insert(*stop);
+		}
+	}
+
+	void ApplyDistances(const StopPatch& stop_patch)
+	{
+		uint32_t from = GetExistingStop(stop_patch.name);
+		for (const auto& [to_name, distance] : stop_patch.road_distances)
+		{
+			uint32_t to = GetExistingStop(to_name);
+			vector<MappedDistance>& row = distances_.EditRow(from);
+			auto it = lower_bound(row.begin(), row.end(), to, [](const MappedDistance& entry, uint32_t stop)
+				{
+					return entry.to < stop;
+				});
+			if (it != row.end() && it->to == to)
+			{
+				it->distance = distance;
+			}
+			else
+			{
+				row.insert(it, { to, distance });
+			}
+			moved_stops_.insert(from);
+			moved_stops_.insert(to);
+		}
+	}
+
+	void ApplyBus(const BusPatch& bus_patch)
+	{
+		optional<uint32_t> bus = FindBus(bus_patch.name);
+		if (bus)
+		{
+			for (uint32_t stop : GetUniqueStops(*bus))
+			{
+				vector<uint32_t>& row = stop_buses_.EditRow(stop);
+				row.erase(remove(row.begin(), row.end(), *bus), row.end());
+			}
+			bus_stops_.EditRow(*bus).clear();
+		}
+		if (bus_patch.is_removed)
+		{
+			if (!bus)
+			{
+				throw invalid_argument("unknown bus "s + bus_patch.name);
+			}
+			buses_.Edit(*bus).flags |= RECORD_REMOVED;
+			added_buses_.erase(bus_patch.name);
+			are_buses_removed_ = true;
+			return;
+		}
+
+		vector<uint32_t> bus_stops;
+		for (const string& stop_name : bus_patch.stops)
+		{
+			bus_stops.push_back(GetExistingStop(stop_name));
+		}
+		if (!bus)
+		{
+			uint32_t name_offset = AddString(bus_patch.name);
+			bus = buses_.Append({ name_offset, static_cast<uint32_t>(bus_patch.name.size()), 0, 0, 0, 0, 0, 0 });
+			added_buses_[bus_patch.name] = *bus;
+		}
+		buses_.Edit(*bus).is_round = bus_patch.is_round;
+		bus_stops_.EditRow(*bus) = bus_stops;
+		for (uint32_t stop : set<uint32_t>(bus_stops.begin(), bus_stops.end()))
+		{
+			// Автобусы остановки хранятся в порядке имён
+			vector<uint32_t>& row = stop_buses_.EditRow(stop);
+			auto it = lower_bound(row.begin(), row.end(), GetBusName(*bus), [this](uint32_t lhs, string_view name)
+				{
+					return GetBusName(lhs) < name;
+				});
+			row.insert(it, *bus);
+		}
+		changed_buses_.insert(*bus);
+	}
+
+	set<uint32_t> GetUniqueStops(uint32_t bus) const
+	{
+		vector<uint32_t> stops = bus_stops_.GetRow(bus);
+		return { stops.begin(), stops.end() };
+	}
+
+	int GetDistance(uint32_t from, uint32_t to) const
+	{
+		for (auto [stop_a, stop_b] : { pair{ from, to }, pair{ to, from } })
+		{
+			vector<MappedDistance> row = distances_.GetRow(stop_a);
+			auto it = lower_bound(row.begin(), row.end(), stop_b, [](const MappedDistance& entry, uint32_t stop)
+				{
+					return entry.to < stop;
+				});
+			if (it != row.end() && it->to == stop_b)
+			{
+				return it->distance;
+			}
+		}
+		return 0;
+	}
+
+	// Пересчёт RouteInfo для изменённых автобусов и автобусов через остановки с новыми координатами или расстояниями
+	void UpdateRouteInfo()
+	{
+		set<uint32_t> affected_buses = changed_buses_;
+		for (uint32_t stop : moved_stops_)
+		{
+			for (uint32_t bus : stop_buses_.GetRow(stop))
+			{
+				affected_buses.insert(bus);
+			}
+		}
+		for (uint32_t bus : affected_buses)
+		{
+			if (buses_.Get(bus).flags & RECORD_REMOVED)
+			{
+				continue;
+			}
+			vector<uint32_t> bus_stops = bus_stops_.GetRow(bus);
+			double geo_length = 0;
+			double real_length = 0;
+			for (size_t i = 1; i < bus_stops.size(); ++i)
+			{
+				const MappedStop& stop_a = stops_.Get(bus_stops[i - 1]);
+				const MappedStop& stop_b = stops_.Get(bus_stops[i]);
+				geo_length += geo::ComputeDistance({ stop_a.lat, stop_a.lng }, { stop_b.lat, stop_b.lng });
+				real_length += GetDistance(bus_stops[i - 1], bus_stops[i]);
+			}
+			MappedBus& record = buses_.Edit(bus);
+			record.n_stops = bus_stops.size();
+			record.n_unique_stops = set<uint32_t>(bus_stops.begin(), bus_stops.end()).size();
+			record.real_length = real_length;
+			record.curvature = real_length / geo_length;
+		}
+	}
+
+	// Исходная таблица копируется, если имена не менялись; новые имена дописываются,
+	// пока хватает ёмкости, иначе (и после удалений) таблица строится заново
+	template <typename Record, typename GetName>
+	vector<uint32_t> GetHashTable(const uint32_t* base_slots, uint32_t base_capacity,
+		const RecordsPatch<Record>& records, const unordered_map<string, uint32_t>& added, bool is_removed,
+		GetName get_name) const
+	{
+		uint32_t capacity = GetHashCapacity(records.GetCount());
+		if (is_removed || capacity > base_capacity)
+		{
+			return BuildHashTable(records.GetCount(), max(capacity, base_capacity),
+				[&records](uint32_t id) { return records.Get(id); }, get_name);
+		}
+		vector<uint32_t> slots(base_slots, base_slots + base_capacity);
+		for (const auto& [name, id] : added)
+		{
+			InsertIntoHashTable(slots, name, id);
+		}
+		return slots;
+	}
+
+	const MappedCatalogue& base_;
+	const MappedHeader& header_;
+	string appended_strings_;
+	RecordsPatch<MappedStop> stops_;
+	RecordsPatch<MappedBus> buses_;
+	CsrPatch<uint32_t> stop_buses_;
+	CsrPatch<uint32_t> bus_stops_;
+	CsrPatch<MappedDistance> distances_;
+	unordered_map<string, uint32_t> added_stops_;
+	unordered_map<string, uint32_t> added_buses_;
+	vector<uint32_t> removed_stops_;
+	set<uint32_t> moved_stops_;
+	set<uint32_t> changed_buses_;
+	bool are_stops_removed_ = false;
+	bool are_buses_removed_ = false;
+};
+
+} // namespace transport::serialization
+
+void transport::serialization::ApplyPatch(const MappedCatalogue& base, const CataloguePatch& patch, ostream& output)
+{
+	SnapshotPatcher patcher(base);
+	patcher.Apply(patch);
+	patcher.Write(output);
+}
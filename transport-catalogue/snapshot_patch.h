@@ -0,0 +1,49 @@
+#pragma once
+
+#include "mapped_catalogue.h"
+#include "geo.h"
+
+#include <iostream>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace transport::serialization
+{
+
+// Добавление, изменение или удаление остановки. Без координат меняются только расстояния
+struct StopPatch
+{
+	std::string name;
+	bool is_removed = false;
+	std::optional<geo::Coordinates> coordinates;
+	std::vector<std::pair<std::string, int>> road_distances;
+};
+
+// Добавление, замена маршрута или удаление автобуса
+struct BusPatch
+{
+	std::string name;
+	bool is_removed = false;
+	// Полная последовательность остановок (для некольцевого маршрута — туда и обратно)
+	std::vector<std::string> stops;
+	bool is_round = false;
+};
+
+struct CataloguePatch
+{
+	std::vector<StopPatch> stops;
+	std::vector<BusPatch> buses;
+};
+
+/*
+* Записывает в output новый отображаемый снимок: base с применённым patch.
+* Неизменённые секции и неизменённые участки записей и CSR-строк копируются блоками,
+* RouteInfo пересчитывается только для автобусов, затронутых патчем.
+* Удалённые записи помечаются флагом, идентификаторы остальных сохраняются.
+* При ошибке в патче (неизвестное имя, удаление используемой остановки) бросает std::invalid_argument
+*/
+void ApplyPatch(const MappedCatalogue& base, const CataloguePatch& patch, std::ostream& output);
+
+} // namespace transport::serialization
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace concurrent
+{
+
+/*
+* Ограниченная очередь без блокировок для одного производителя и одного потребителя.
+* Push ждёт свободного места, Pop — элемента; ожидание — опрос с уступкой процессора.
+* Close может вызвать любая сторона: после него Push возвращает false,
+* а Pop отдаёт оставшиеся элементы и затем nullopt
+*/
+template <typename Type>
+class SpscQueue
+{
+public:
+	explicit SpscQueue(size_t capacity)
+		: slots_(capacity > 0 ? capacity : 1)
+	{
+	}
+	SpscQueue(const SpscQueue&) = delete;
+	SpscQueue& operator=(const SpscQueue&) = delete;
+
+	bool Push(Type value)
+	{
+		const size_t tail = tail_.load(std::memory_order_relaxed);
+		for (size_t attempt = 0; tail - head_.load(std::memory_order_acquire) == slots_.size(); ++attempt)
+		{
+			if (is_closed_.load(std::memory_order_acquire))
+			{
+				return false;
+			}
+			Wait(attempt);
+		}
+		if (is_closed_.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+		slots_[tail % slots_.size()] = std::move(value);
+		tail_.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	std::optional<Type> Pop()
+	{
+		const size_t head = head_.load(std::memory_order_relaxed);
+		for (size_t attempt = 0; tail_.load(std::memory_order_acquire) == head; ++attempt)
+		{
+			if (is_closed_.load(std::memory_order_acquire))
+			{
+				// Элемент мог быть добавлен перед закрытием очереди
+				if (tail_.load(std::memory_order_acquire) == head)
+				{
+					return std::nullopt;
+				}
+				break;
+			}
+			Wait(attempt);
+		}
+		std::optional<Type> value = std::move(slots_[head % slots_.size()]);
+		slots_[head % slots_.size()].reset();
+		head_.store(head + 1, std::memory_order_release);
+		return value;
+	}
+
+	void Close()
+	{
+		is_closed_.store(true, std::memory_order_release);
+	}
+
+private:
+	// Короткое ожидание уступает процессор, долгое — засыпает, чтобы не занимать ядро
+	static void Wait(size_t attempt)
+	{
+		if (attempt < 64)
+		{
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds(50));
+		}
+	}
+
+	std::vector<std::optional<Type>> slots_;
+	alignas(64) std::atomic<size_t> head_{ 0 };
+	alignas(64) std::atomic<size_t> tail_{ 0 };
+	alignas(64) std::atomic<bool> is_closed_{ false };
+};
+
+} // namespace concurrent
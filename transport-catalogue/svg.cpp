@@ -1,5 +1,7 @@
 #include "svg.h"
 
+#include <charconv>
+
 namespace svg {
 
 using namespace std::literals;
@@ -227,4 +229,227 @@ void Document::Render(std::ostream& out) const
 	out << "</svg>"sv;
 }
 
+void Writer::BeginDocument()
+{
+	Write("<?xml version=\"1.0\" encoding=\"UTF-8\" ?>\n"sv);
+	Write("<svg xmlns=\"http://www.w3.org/2000/svg\" version=\"1.1\">\n"sv);
+}
+
+void Writer::EndDocument()
+{
+	Write("</svg>"sv);
+	if (sink_)
+	{
+		Flush();
+	}
+}
+
+void Writer::WritePolyline(const std::vector<Point>& points, const PathAttrs& attrs)
+{
+	Write("  <polyline points=\""sv);
+	bool is_first = true;
+	for (const Point& point : points)
+	{
+		if (!is_first)
+		{
+			output_.push_back(' ');
+		}
+		is_first = false;
+		WriteNumber(point.x);
+		output_.push_back(',');
+		WriteNumber(point.y);
+		// Ломаная длинного маршрута сама может занимать сотни килобайт
+		FlushIfFull();
+	}
+	output_.push_back('"');
+	WriteAttrs(attrs);
+	Write("/>\n"sv);
+	FlushIfFull();
+}
+
+void Writer::WriteCircle(Point center, double radius, const PathAttrs& attrs)
+{
+	Write("  <circle cx=\""sv);
+	WriteNumber(center.x);
+	Write("\" cy=\""sv);
+	WriteNumber(center.y);
+	Write("\" r=\""sv);
+	WriteNumber(radius);
+	output_.push_back('"');
+	WriteAttrs(attrs);
+	Write("/>\n"sv);
+	FlushIfFull();
+}
+
+void Writer::WriteText(const TextAttrs& text, std::string_view data, const PathAttrs& attrs)
+{
+	Write("  <text x=\""sv);
+	WriteNumber(text.position.x);
+	Write("\" y=\""sv);
+	WriteNumber(text.position.y);
+	Write("\" dx=\""sv);
+	WriteNumber(text.offset.x);
+	Write("\" dy=\""sv);
+	WriteNumber(text.offset.y);
+	Write("\" font-size=\""sv);
+	WriteNumber(text.font_size);
+	output_.push_back('"');
+	if (!text.font_family.empty())
+	{
+		Write(" font-family=\""sv);
+		Write(text.font_family);
+		output_.push_back('"');
+	}
+	if (!text.font_weight.empty())
+	{
+		Write(" font-weight=\""sv);
+		Write(text.font_weight);
+		output_.push_back('"');
+	}
+	WriteAttrs(attrs);
+	output_.push_back('>');
+	WriteEscaped(data);
+	Write("</text>\n"sv);
+	FlushIfFull();
+}
+
+void Writer::Flush()
+{
+	sink_(output_);
+	output_.clear();
+}
+
+void Writer::WriteNumber(double value)
+{
+	char buffer[32];
+	const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::general, 6);
+	output_.append(buffer, result.ptr);
+}
+
+void Writer::WriteNumber(uint32_t value)
+{
+	char buffer[16];
+	const auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+	output_.append(buffer, result.ptr);
+}
+
+void Writer::WriteColor(const Color& color)
+{
+	if (const std::string* name = std::get_if<std::string>(&color))
+	{
+		Write(*name);
+	}
+	else if (const Rgb* rgb = std::get_if<Rgb>(&color))
+	{
+		Write("rgb("sv);
+		WriteNumber(uint32_t{ rgb->red });
+		output_.push_back(',');
+		WriteNumber(uint32_t{ rgb->green });
+		output_.push_back(',');
+		WriteNumber(uint32_t{ rgb->blue });
+		output_.push_back(')');
+	}
+	else if (const Rgba* rgba = std::get_if<Rgba>(&color))
+	{
+		Write("rgba("sv);
+		WriteNumber(uint32_t{ rgba->red });
+		output_.push_back(',');
+		WriteNumber(uint32_t{ rgba->green });
+		output_.push_back(',');
+		WriteNumber(uint32_t{ rgba->blue });
+		output_.push_back(',');
+		WriteNumber(rgba->opacity);
+		output_.push_back(')');
+	}
+	else
+	{
+		Write("none"sv);
+	}
+}
+
+void Writer::WriteAttrs(const PathAttrs& attrs)
+{
+	if (attrs.fill_color)
+	{
+		Write(" fill=\""sv);
+		WriteColor(*attrs.fill_color);
+		output_.push_back('"');
+	}
+	if (attrs.stroke_color)
+	{
+		Write(" stroke=\""sv);
+		WriteColor(*attrs.stroke_color);
+		output_.push_back('"');
+	}
+	if (attrs.stroke_width)
+	{
+		Write(" stroke-width=\""sv);
+		WriteNumber(*attrs.stroke_width);
+		output_.push_back('"');
+	}
+	if (attrs.stroke_linecap)
+	{
+		Write(" stroke-linecap=\""sv);
+		Write(attrs.stroke_linecap == StrokeLineCap::BUTT ? "butt"sv
+			: attrs.stroke_linecap == StrokeLineCap::ROUND ? "round"sv : "square"sv);
+		output_.push_back('"');
+	}
+	if (attrs.stroke_linejoin)
+	{
+		Write(" stroke-linejoin=\""sv);
+		switch (*attrs.stroke_linejoin)
+		{
+		case StrokeLineJoin::ARCS:
+			Write("arcs"sv);
+			break;
+		case StrokeLineJoin::BEVEL:
+			Write("bevel"sv);
+			break;
+		case StrokeLineJoin::MITER:
+			Write("miter"sv);
+			break;
+		case StrokeLineJoin::MITER_CLIP:
+			Write("miter-clip"sv);
+			break;
+		case StrokeLineJoin::ROUND:
+			Write("round"sv);
+			break;
+		}
+		output_.push_back('"');
+	}
+}
+
+void Writer::WriteEscaped(std::string_view text)
+{
+	size_t plain_begin = 0;
+	for (size_t i = 0; i < text.size(); ++i)
+	{
+		std::string_view entity;
+		switch (text[i])
+		{
+		case '"':
+			entity = "&quot;"sv;
+			break;
+		case '\'':
+			entity = "&apos;"sv;
+			break;
+		case '<':
+			entity = "&lt;"sv;
+			break;
+		case '>':
+			entity = "&gt;"sv;
+			break;
+		case '&':
+			entity = "&amp;"sv;
+			break;
+		default:
+			continue;
+		}
+		Write(text.substr(plain_begin, i - plain_begin));
+		Write(entity);
+		plain_begin = i + 1;
+	}
+	Write(text.substr(plain_begin));
+}
+
 }  // namespace svg
@@ -1,11 +1,13 @@
 #pragma once
 
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <memory>
 #include <string>
 #include <vector>
 #include <optional>
+#include <string_view>
 #include <variant>
 
 namespace svg
@@ -257,6 +259,90 @@ private:
 	std::vector<std::unique_ptr<Object>> objects_;
 };
 
+// Атрибуты заливки и контура для Writer в том же порядке, что и у PathProps; цвета не копируются
+struct PathAttrs
+{
+	const Color* fill_color = nullptr;
+	const Color* stroke_color = nullptr;
+	std::optional<double> stroke_width;
+	std::optional<StrokeLineCap> stroke_linecap;
+	std::optional<StrokeLineJoin> stroke_linejoin;
+};
+
+// Атрибуты текста для Writer, соответствующие сеттерам Text
+struct TextAttrs
+{
+	Point position;
+	Point offset;
+	uint32_t font_size = 1;
+	std::string_view font_family;
+	std::string_view font_weight;
+};
+
+/*
+* Записывает SVG-документ прямо в конец строки, минуя объекты Object и потоки. Разметка
+* побайтно совпадает с Document::Render для тех же элементов: числа форматируются через
+* to_chars так же, как operator<< потока по умолчанию (%g, 6 значащих цифр)
+*/
+class Writer
+{
+public:
+	// Получатель документа по частям; части режутся по границам байтов, а не символов UTF-8
+	using Sink = std::function<void(std::string_view)>;
+
+	explicit Writer(std::string& output)
+		: output_(output)
+	{
+	}
+	// Документ копится во внутреннем буфере и отдаётся sink частями примерно по FLUSH_SIZE байт,
+	// поэтому память не зависит от размера документа. Последняя часть отдаётся в EndDocument
+	explicit Writer(Sink sink)
+		: output_(buffer_)
+		, sink_(std::move(sink))
+	{
+		buffer_.reserve(FLUSH_SIZE + FLUSH_SIZE / 4);
+	}
+	// output_ может ссылаться на собственный buffer_, поэтому копия ссылалась бы на чужой буфер
+	Writer(const Writer&) = delete;
+	Writer(Writer&&) = delete;
+	Writer& operator=(const Writer&) = delete;
+	Writer& operator=(Writer&&) = delete;
+
+	void BeginDocument();
+	void EndDocument();
+
+	void WritePolyline(const std::vector<Point>& points, const PathAttrs& attrs);
+	void WriteCircle(Point center, double radius, const PathAttrs& attrs);
+	// data записывается с экранированием спецсимволов XML, как в Text::SetData
+	void WriteText(const TextAttrs& text, std::string_view data, const PathAttrs& attrs);
+
+private:
+	static const size_t FLUSH_SIZE = 64 * 1024;
+
+	void Write(std::string_view text)
+	{
+		output_.append(text);
+	}
+	void WriteNumber(double value);
+	void WriteNumber(uint32_t value);
+	void WriteColor(const Color& color);
+	void WriteAttrs(const PathAttrs& attrs);
+	void WriteEscaped(std::string_view text);
+	// Отдаёт буфер sink, если он набрал FLUSH_SIZE байт; без sink ничего не делает
+	void FlushIfFull()
+	{
+		if (sink_ && output_.size() >= FLUSH_SIZE)
+		{
+			Flush();
+		}
+	}
+	void Flush();
+
+	std::string buffer_;
+	std::string& output_;
+	Sink sink_;
+};
+
 template<typename Obj>
 void ObjectContainer::Add(Obj obj)
 {
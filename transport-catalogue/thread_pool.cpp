@@ -0,0 +1,54 @@
+#include "thread_pool.h"
+
+using namespace std;
+using namespace concurrent;
+
+ThreadPool::ThreadPool(size_t threads_count)
+{
+	if (threads_count == 0)
+	{
+		threads_count = 1;
+	}
+	workers_.reserve(threads_count);
+	for (size_t i = 0; i < threads_count; ++i)
+	{
+		workers_.emplace_back([this] { WorkerLoop(); });
+	}
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		lock_guard lock(mutex_);
+		is_stopped_ = true;
+	}
+	has_task_.notify_all();
+	for (thread& worker : workers_)
+	{
+		worker.join();
+	}
+}
+
+size_t ThreadPool::GetThreadsCount() const
+{
+	return workers_.size();
+}
+
+void ThreadPool::WorkerLoop()
+{
+	for (;;)
+	{
+		function<void()> task;
+		{
+			unique_lock lock(mutex_);
+			has_task_.wait(lock, [this] { return is_stopped_ || !tasks_.empty(); });
+			if (tasks_.empty())
+			{
+				return;
+			}
+			task = move(tasks_.front());
+			tasks_.pop();
+		}
+		task();
+	}
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace concurrent
+{
+
+/*
+* Пул потоков фиксированного размера с общей очередью задач.
+* Submit возвращает std::future с результатом задачи
+*/
+class ThreadPool
+{
+public:
+	explicit ThreadPool(size_t threads_count = std::thread::hardware_concurrency());
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool();
+
+	size_t GetThreadsCount() const;
+
+	template <typename Func>
+	std::future<std::invoke_result_t<Func>> Submit(Func func);
+
+private:
+	void WorkerLoop();
+
+	std::vector<std::thread> workers_;
+	std::queue<std::function<void()>> tasks_;
+	std::mutex mutex_;
+	std::condition_variable has_task_;
+	bool is_stopped_ = false;
+};
+
+template <typename Func>
+std::future<std::invoke_result_t<Func>> ThreadPool::Submit(Func func)
+{
+	using Result = std::invoke_result_t<Func>;
+	auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+	std::future<Result> result = task->get_future();
+	{
+		std::lock_guard lock(mutex_);
+		tasks_.emplace([task] { (*task)(); });
+	}
+	has_task_.notify_one();
+	return result;
+}
+
+} // namespace concurrent
@@ -0,0 +1,108 @@
+#include "trace.h"
+
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+using namespace transport::trace;
+
+atomic<bool> Tracer::is_enabled_{ false };
+atomic<size_t> Tracer::events_count_{ 0 };
+mutex Tracer::mutex_;
+string Tracer::path_;
+// Отсчёт времени — от запуска процесса, чтобы интервалы до Enable (разбор настроек) не были отрицательными
+chrono::steady_clock::time_point Tracer::start_ = chrono::steady_clock::now();
+vector<shared_ptr<Tracer::ThreadBuffer>> Tracer::buffers_;
+
+namespace
+{
+void WriteMicroseconds(ostream& output, int64_t nanoseconds)
+{
+	output << nanoseconds / 1000 << '.' << setw(3) << setfill('0') << nanoseconds % 1000;
+}
+} // namespace
+
+void Tracer::Enable(string path)
+{
+	lock_guard lock(mutex_);
+	path_ = move(path);
+	is_enabled_.store(true, memory_order_relaxed);
+}
+
+void Tracer::Write()
+{
+	lock_guard lock(mutex_);
+	if (path_.empty())
+	{
+		return;
+	}
+	is_enabled_.store(false, memory_order_relaxed);
+	ofstream output(path_);
+	if (!output)
+	{
+		throw runtime_error("failed to open trace file "s + path_);
+	}
+
+	output << "{\"traceEvents\": [\n"s;
+	bool is_first = true;
+	auto begin_event = [&output, &is_first]
+	{
+		if (!is_first)
+		{
+			output << ",\n"s;
+		}
+		is_first = false;
+	};
+	for (const shared_ptr<ThreadBuffer>& buffer : buffers_)
+	{
+		begin_event();
+		output << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "s << buffer->thread_id
+			<< ", \"args\": {\"name\": \""s << (buffer->thread_id == 1 ? "main"s : "thread "s + to_string(buffer->thread_id))
+			<< "\"}}"s;
+		for (const Event& event : buffer->events)
+		{
+			begin_event();
+			output << "{\"name\": \""s << event.name << "\", \"cat\": \""s << event.category
+				<< "\", \"ph\": \"X\", \"pid\": 1, \"tid\": "s << buffer->thread_id << ", \"ts\": "s;
+			WriteMicroseconds(output, event.start_ns);
+			output << ", \"dur\": "s;
+			WriteMicroseconds(output, event.duration_ns);
+			if (event.id)
+			{
+				output << ", \"args\": {\"id\": "s << *event.id << '}';
+			}
+			output << '}';
+		}
+		buffer->events.clear();
+	}
+	const size_t events_count = events_count_.exchange(0, memory_order_relaxed);
+	output << "\n], \"displayTimeUnit\": \"ms\", \"otherData\": {\"dropped_events\": "s
+		<< (events_count > MAX_EVENTS ? events_count - MAX_EVENTS : 0) << "}}\n"s;
+	path_.clear();
+}
+
+void Tracer::AddSpan(const char* name, const char* category, chrono::steady_clock::time_point start,
+	chrono::steady_clock::time_point end, optional<int> id)
+{
+	if (events_count_.fetch_add(1, memory_order_relaxed) >= MAX_EVENTS)
+	{
+		return;
+	}
+	GetThreadBuffer().events.push_back({ name, category,
+		chrono::duration_cast<chrono::nanoseconds>(start - start_).count(),
+		chrono::duration_cast<chrono::nanoseconds>(end - start).count(), id });
+}
+
+Tracer::ThreadBuffer& Tracer::GetThreadBuffer()
+{
+	thread_local shared_ptr<ThreadBuffer> buffer;
+	if (!buffer)
+	{
+		buffer = make_shared<ThreadBuffer>();
+		lock_guard lock(mutex_);
+		buffers_.push_back(buffer);
+		buffer->thread_id = static_cast<uint32_t>(buffers_.size());
+	}
+	return *buffer;
+}
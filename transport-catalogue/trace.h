@@ -0,0 +1,100 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace transport::trace
+{
+
+/*
+* Запись интервалов в формате Chrome trace_event (chrome://tracing, Perfetto).
+* Каждый поток пишет в собственный буфер без блокировок; файл записывает Write,
+* когда открытых интервалов не осталось. Пока запись выключена, Span только проверяет флаг.
+* Буферы опустошает только Write, поэтому всех потоков вместе хранится не больше MAX_EVENTS
+* интервалов (режим serve пишет интервал на каждый запрос и работает долго): следующие
+* отбрасываются, и их число записывается в файл
+*/
+class Tracer
+{
+public:
+	static bool IsEnabled()
+	{
+		return is_enabled_.load(std::memory_order_relaxed);
+	}
+
+	// Начинает запись; интервалы записываются в файл path при вызове Write
+	static void Enable(std::string path);
+	// Записывает файл и выключает запись; без Enable ничего не делает
+	static void Write();
+
+	// name и category — строковые литералы: буферы хранят только указатели на них
+	static void AddSpan(const char* name, const char* category, std::chrono::steady_clock::time_point start,
+		std::chrono::steady_clock::time_point end, std::optional<int> id = std::nullopt);
+
+private:
+	static const size_t MAX_EVENTS = 4 << 20;
+
+	struct Event
+	{
+		const char* name;
+		const char* category;
+		int64_t start_ns;
+		int64_t duration_ns;
+		std::optional<int> id;
+	};
+
+	struct ThreadBuffer
+	{
+		uint32_t thread_id = 0;
+		std::vector<Event> events;
+	};
+
+	static ThreadBuffer& GetThreadBuffer();
+
+	static std::atomic<bool> is_enabled_;
+	static std::atomic<size_t> events_count_;
+	static std::mutex mutex_;
+	static std::string path_;
+	static std::chrono::steady_clock::time_point start_;
+	// Буферы переживают свои потоки, чтобы их интервалы попали в файл
+	static std::vector<std::shared_ptr<ThreadBuffer>> buffers_;
+};
+
+// Интервал от создания до уничтожения объекта
+class Span
+{
+public:
+	explicit Span(const char* name, const char* category = "phase", std::optional<int> id = std::nullopt)
+	{
+		if (Tracer::IsEnabled())
+		{
+			name_ = name;
+			category_ = category;
+			id_ = id;
+			start_ = std::chrono::steady_clock::now();
+		}
+	}
+	Span(const Span&) = delete;
+	Span& operator=(const Span&) = delete;
+	~Span()
+	{
+		if (name_)
+		{
+			Tracer::AddSpan(name_, category_, start_, std::chrono::steady_clock::now(), id_);
+		}
+	}
+
+private:
+	const char* name_ = nullptr;
+	const char* category_ = nullptr;
+	std::optional<int> id_;
+	std::chrono::steady_clock::time_point start_;
+};
+
+} // namespace transport::trace
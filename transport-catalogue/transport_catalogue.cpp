@@ -1,22 +1,145 @@
 #include "transport_catalogue.h"
+#include "trace.h"
 
 #include <algorithm>
+#include <limits>
+#include <utility>
 
 using namespace std;
 using namespace transport;
 using namespace domain;
 using namespace geo;
 
+namespace
+{
+// Ключей в блоке пакетного поиска: столько промахов кэша процессор успевает обслуживать одновременно
+const size_t LOOKUP_BLOCK_SIZE = 16;
+const uint32_t EMPTY_SLOT = numeric_limits<uint32_t>::max();
+const size_t MIN_INDEX_CAPACITY = 16;
+
+void Prefetch(const void* address)
+{
+#if defined(__GNUC__)
+	__builtin_prefetch(address);
+#else
+	(void)address;
+#endif
+}
+
+size_t GetNameHash(string_view name)
+{
+	return hash<string_view>{}(name);
+}
+
+// Слот с именем name или первый пустой слот цепочки, начинающейся в slot
+template <typename Items>
+size_t FindSlot(const NameIndex& index, const Items& items, string_view name, size_t slot)
+{
+	const size_t mask = index.slots.size() - 1;
+	while (index.slots[slot] != EMPTY_SLOT && items[index.slots[slot]].name != name)
+	{
+		slot = (slot + 1) & mask;
+	}
+	return slot;
+}
+
+// Запись с тем же именем заменяется новой
+template <typename Items>
+void InsertName(NameIndex& index, const Items& items, uint32_t id)
+{
+	// Таблица заполнена не больше чем наполовину: цепочки короткие, и пустой слот всегда есть
+	if ((index.size + 1) * 2 > index.slots.size())
+	{
+		vector<uint32_t> old_slots = exchange(index.slots,
+			vector<uint32_t>(max(MIN_INDEX_CAPACITY, index.slots.size() * 2), EMPTY_SLOT));
+		const size_t mask = index.slots.size() - 1;
+		for (uint32_t old_id : old_slots)
+		{
+			if (old_id != EMPTY_SLOT)
+			{
+				const string_view name = items[old_id].name;
+				index.slots[FindSlot(index, items, name, GetNameHash(name) & mask)] = old_id;
+			}
+		}
+	}
+	const string_view name = items[id].name;
+	const size_t slot = FindSlot(index, items, name, GetNameHash(name) & (index.slots.size() - 1));
+	index.size += index.slots[slot] == EMPTY_SLOT;
+	index.slots[slot] = id;
+}
+
+template <typename Items>
+const typename Items::value_type* FindName(const NameIndex& index, const Items& items, string_view name)
+{
+	if (index.size == 0)
+	{
+		return nullptr;
+	}
+	const uint32_t id = index.slots[FindSlot(index, items, name, GetNameHash(name) & (index.slots.size() - 1))];
+	return id == EMPTY_SLOT ? nullptr : &items[id];
+}
+
+// Ищет names в index и записывает в results найденные записи или nullptr
+template <typename Items>
+void FindNames(const NameIndex& index, const Items& items, const vector<string_view>& names,
+	vector<const typename Items::value_type*>& results)
+{
+	results.assign(names.size(), nullptr);
+	if (index.size == 0)
+	{
+		return;
+	}
+	const size_t mask = index.slots.size() - 1;
+	size_t slots[LOOKUP_BLOCK_SIZE];
+	for (size_t begin = 0; begin < names.size(); begin += LOOKUP_BLOCK_SIZE)
+	{
+		const size_t end = min(names.size(), begin + LOOKUP_BLOCK_SIZE);
+		// Адрес слота зависит только от хеша, поэтому слоты всего блока загружаются параллельно
+		for (size_t i = begin; i < end; ++i)
+		{
+			slots[i - begin] = GetNameHash(names[i]) & mask;
+			Prefetch(&index.slots[slots[i - begin]]);
+		}
+		// Записи, на которые указывают первые слоты цепочек
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t id = index.slots[slots[i - begin]];
+			if (id != EMPTY_SLOT)
+			{
+				Prefetch(&items[id]);
+			}
+		}
+		// Длинные имена хранятся вне записи
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t id = index.slots[slots[i - begin]];
+			if (id != EMPTY_SLOT)
+			{
+				Prefetch(items[id].name.data());
+			}
+		}
+		// Сравнение имён без повторного хеширования
+		for (size_t i = begin; i < end; ++i)
+		{
+			const uint32_t id = index.slots[FindSlot(index, items, names[i], slots[i - begin])];
+			results[i] = id == EMPTY_SLOT ? nullptr : &items[id];
+		}
+	}
+}
+} // namespace
+
 void TransportCatalogue::AddBus(const string& name, vector<const Stop*> stops, const unordered_set<string_view>& unique_stops, bool is_round)
 {
-	buses_.push_back({ name, move(stops), unique_stops, is_round});
+	++version_;
+	buses_.push_back({ name, move(stops), unique_stops, is_round, buses_.size() });
 	Bus* bus = &buses_.back();
 	for (string_view stop_name : bus->unique_stops)
 	{
-		stop_to_buses_[SearchStop(stop_name)].insert(bus->name);
+		stop_to_buses_[SearchStop(stop_name)->id].insert(bus->name);
 	}
-	name_to_bus_[bus->name] = bus;
+	InsertName(name_to_bus_, buses_, static_cast<uint32_t>(bus->id));
 
+	trace::Span span("AddBus route info", "catalogue");
 	int n_stops = bus->stops.size();
 	int n_unique_stops = bus->unique_stops.size();
 	double geo_length = 0;
@@ -29,52 +152,70 @@ void TransportCatalogue::AddBus(const string& name, vector<const Stop*> stops, c
 		real_length += GetDistanceBetweenStops(stop_a, stop_b);
 	}
 	double curvature = real_length / geo_length;
-	routes_info_[bus] = { n_stops, n_unique_stops, real_length, curvature };
+	routes_info_.push_back({ n_stops, n_unique_stops, real_length, curvature });
 }
 
 void TransportCatalogue::AddStop(const string& name, Coordinates coordinates)
 {
-	stops_.push_back({ name, coordinates });
-	Stop* stop = &stops_.back();
-	name_to_stop_[stop->name] = stop;
+	++version_;
+	stops_.push_back({ name, coordinates, stops_.size() });
+	stop_to_buses_.emplace_back();
+	InsertName(name_to_stop_, stops_, static_cast<uint32_t>(stops_.back().id));
 }
 
 const Bus* TransportCatalogue::SearchBus(string_view bus_name) const
 {
-	auto search = name_to_bus_.find(bus_name);
-	if (search == name_to_bus_.end())
+	return FindName(name_to_bus_, buses_, bus_name);
+}
+
+const Stop* TransportCatalogue::SearchStop(string_view stop_name) const
+{
+	return FindName(name_to_stop_, stops_, stop_name);
+}
+
+void TransportCatalogue::SearchBuses(const vector<string_view>& bus_names, vector<const Bus*>& buses) const
+{
+	FindNames(name_to_bus_, buses_, bus_names, buses);
+}
+
+void TransportCatalogue::SearchStops(const vector<string_view>& stop_names, vector<const Stop*>& stops) const
+{
+	FindNames(name_to_stop_, stops_, stop_names, stops);
+}
+
+void TransportCatalogue::GetRouteInfos(const vector<const Bus*>& buses, vector<optional<RouteInfo>>& route_infos) const
+{
+	// Адреса зависят только от номеров, поэтому загрузки разных элементов не ждут друг друга
+	route_infos.resize(buses.size());
+	for (size_t i = 0; i < buses.size(); ++i)
 	{
-		return nullptr;
+		route_infos[i] = buses[i] ? optional(routes_info_[buses[i]->id]) : nullopt;
 	}
-	return search->second;
 }
 
-const Stop* TransportCatalogue::SearchStop(string_view stop_name) const
+void TransportCatalogue::GetStopsToBuses(const vector<const Stop*>& stops, vector<const sv_set*>& buses) const
 {
-	auto search = name_to_stop_.find(stop_name);
-	if (search == name_to_stop_.end())
+	buses.resize(stops.size());
+	for (size_t i = 0; i < stops.size(); ++i)
 	{
-		return nullptr;
+		buses[i] = stops[i] ? GetStopToBuses(stops[i]) : nullptr;
 	}
-	return search->second;
 }
 
 RouteInfo TransportCatalogue::GetRouteInfo(const Bus* bus) const
 {
-	return routes_info_.at(bus);
+	return routes_info_.at(bus->id);
 }
 
 const sv_set* TransportCatalogue::GetStopToBuses(const Stop* stop) const
 {
-	if (!stop_to_buses_.count(stop))
-	{
-		return nullptr;
-	}
-	return &stop_to_buses_.at(stop);
+	const sv_set& buses = stop_to_buses_.at(stop->id);
+	return buses.empty() ? nullptr : &buses;
 }
 
 void TransportCatalogue::SetDistanceBetweenStops(const Stop* stop_a, const Stop* stop_b, int distance)
 {
+	++version_;
 	distances_btw_stops_[{stop_a, stop_b}] = distance;
 }
 
@@ -90,3 +231,59 @@ int TransportCatalogue::GetDistanceBetweenStops(const Stop* stop_a, const Stop*
 	}
 	return 0;
 }
+
+const deque<Stop>& TransportCatalogue::GetStops() const
+{
+	return stops_;
+}
+
+const deque<Bus>& TransportCatalogue::GetBuses() const
+{
+	return buses_;
+}
+
+const Distances_btw_stops& TransportCatalogue::GetDistances() const
+{
+	return distances_btw_stops_;
+}
+
+uint64_t TransportCatalogue::GetVersion() const
+{
+	return version_;
+}
+
+vector<memory::Usage> TransportCatalogue::GetMemoryUsage() const
+{
+	memory::UsageCounter stops("stops_"s);
+	stops.AddElements(stops_.size()).AddDeque(stops_);
+	for (const Stop& stop : stops_)
+	{
+		stops.AddString(stop.name);
+	}
+
+	memory::UsageCounter buses("buses_"s);
+	buses.AddElements(buses_.size()).AddDeque(buses_);
+	for (const Bus& bus : buses_)
+	{
+		buses.AddString(bus.name).AddVector(bus.stops).AddHashTable(bus.unique_stops);
+	}
+
+	memory::UsageCounter stop_to_buses("stop_to_buses_"s);
+	stop_to_buses.AddElements(stop_to_buses_.size()).AddVector(stop_to_buses_);
+	for (const sv_set& stop_buses : stop_to_buses_)
+	{
+		stop_to_buses.AddTree(stop_buses);
+	}
+
+	memory::UsageCounter name_to_bus("name_to_bus_"s);
+	name_to_bus.AddElements(name_to_bus_.size).AddVector(name_to_bus_.slots);
+	memory::UsageCounter name_to_stop("name_to_stop_"s);
+	name_to_stop.AddElements(name_to_stop_.size).AddVector(name_to_stop_.slots);
+	memory::UsageCounter distances("distances_btw_stops_"s);
+	distances.AddElements(distances_btw_stops_.size()).AddHashTable(distances_btw_stops_);
+	memory::UsageCounter routes_info("routes_info_"s);
+	routes_info.AddElements(routes_info_.size()).AddVector(routes_info_);
+
+	return { stops.Get(), buses.Get(), name_to_bus.Get(), name_to_stop.Get(), stop_to_buses.Get(),
+		distances.Get(), routes_info.Get() };
+}
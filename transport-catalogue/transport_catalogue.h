@@ -1,7 +1,9 @@
 #pragma once
 
 #include "domain.h"
+#include "memory_usage.h"
 
+#include <cstdint>
 #include <string>
 #include <string_view>
 #include <deque>
@@ -17,6 +19,15 @@ namespace transport
 using sv_set = std::set<std::string_view, std::less<>>;
 using Distances_btw_stops = std::unordered_map<std::pair<const domain::Stop*, const domain::Stop*>, int, domain::StopsHasher>;
 
+// Хеш-таблица имён с открытой адресацией: слот хранит номер записи в stops_ или buses_.
+// Адрес слота вычисляется по хешу имени без обращения к памяти, поэтому пакетный поиск
+// загружает слоты всех ключей блока одновременно
+struct NameIndex
+{
+	std::vector<uint32_t> slots;
+	size_t size = 0;
+};
+
 class TransportCatalogue
 {
 public:
@@ -27,17 +38,36 @@ public:
 	const domain::Stop* SearchStop(std::string_view stop_name) const;
 	domain::RouteInfo GetRouteInfo(const domain::Bus* bus) const;
 	const sv_set* GetStopToBuses(const domain::Stop* stop) const;
+	// Пакетные варианты поиска: i-й результат относится к i-му ключу, для ненайденных — nullptr.
+	// Имена обрабатываются блоками: слоты NameIndex, затем записи всего блока загружаются в кэш
+	// раньше, чем сравниваются имена, чтобы промахи кэша по разным ключам перекрывались
+	void SearchBuses(const std::vector<std::string_view>& bus_names, std::vector<const domain::Bus*>& buses) const;
+	void SearchStops(const std::vector<std::string_view>& stop_names, std::vector<const domain::Stop*>& stops) const;
+	// Для nullptr вместо автобуса — nullopt
+	void GetRouteInfos(const std::vector<const domain::Bus*>& buses,
+		std::vector<std::optional<domain::RouteInfo>>& route_infos) const;
+	void GetStopsToBuses(const std::vector<const domain::Stop*>& stops, std::vector<const sv_set*>& buses) const;
 	void SetDistanceBetweenStops(const domain::Stop* stop_a, const domain::Stop* stop_b, int distance);
 	int GetDistanceBetweenStops(const domain::Stop* stop_a, const domain::Stop* stop_b) const;
+	const std::deque<domain::Stop>& GetStops() const;
+	const std::deque<domain::Bus>& GetBuses() const;
+	const Distances_btw_stops& GetDistances() const;
+	// Номер версии, увеличивается при каждом изменении каталога; по нему сбрасываются кэши
+	uint64_t GetVersion() const;
+	// Память каждого контейнера каталога вместе с именами, маршрутами и множествами автобусов
+	std::vector<memory::Usage> GetMemoryUsage() const;
 
 private:
 	std::deque<domain::Stop>									stops_;
 	std::deque<domain::Bus>										buses_;
-	std::unordered_map<std::string_view, const domain::Bus*>	name_to_bus_;
-	std::unordered_map<std::string_view, const domain::Stop*>	name_to_stop_;
-	std::unordered_map<const domain::Stop*, sv_set>				stop_to_buses_;
+	NameIndex													name_to_bus_;
+	NameIndex													name_to_stop_;
+	// По domain::Stop::id; у остановки без автобусов множество пустое
+	std::vector<sv_set>											stop_to_buses_;
 	Distances_btw_stops											distances_btw_stops_;
-	std::unordered_map<const domain::Bus*, domain::RouteInfo>	routes_info_;
+	// По domain::Bus::id
+	std::vector<domain::RouteInfo>								routes_info_;
+	uint64_t													version_ = 0;
 };
 
 } // namespace transport
@@ -0,0 +1,258 @@
+#include "transport_router.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <queue>
+
+using namespace std;
+using namespace transport;
+using namespace transport::router;
+using namespace domain;
+using namespace graph;
+
+namespace
+{
+// Перевод скорости из км/ч в м/мин
+const double METERS_PER_KM = 1000.0;
+const double MINUTES_PER_HOUR = 60.0;
+}
+
+TransportRouter::TransportRouter(const TransportCatalogue& tc, RoutingSettings settings)
+	: tc_(tc), settings_(settings), graph_(tc.GetStops().size() * 2)
+{
+	BuildGraph();
+}
+
+double transport::router::ComputeRideTime(const RoutingSettings& settings, double distance)
+{
+	return distance / (settings.bus_velocity * METERS_PER_KM / MINUTES_PER_HOUR);
+}
+
+vector<optional<double>> TransportRouter::ComputeTravelTimes(const Stop* from,
+	const vector<const Stop*>& targets) const
+{
+	if (targets.empty())
+	{
+		return {};
+	}
+	vector<VertexId> target_vertices;
+	target_vertices.reserve(targets.size());
+	for (const Stop* target : targets)
+	{
+		target_vertices.push_back(GetWaitVertex(target));
+	}
+	ShortestPathTree tree = SearchFrom(GetWaitVertex(from), target_vertices);
+
+	vector<optional<double>> result;
+	result.reserve(targets.size());
+	for (VertexId vertex : target_vertices)
+	{
+		if (tree.is_settled[vertex])
+		{
+			result.push_back(tree.times[vertex]);
+		}
+		else
+		{
+			result.push_back(nullopt);
+		}
+	}
+	return result;
+}
+
+vector<pair<const Stop*, double>> TransportRouter::ComputeReachableStops(const Stop* from, double max_time) const
+{
+	ShortestPathTree tree = SearchFrom(GetWaitVertex(from), {}, max_time);
+	vector<pair<const Stop*, double>> result;
+	for (const auto& [stop, vertex] : stop_to_vertex_)
+	{
+		if (tree.is_settled[vertex])
+		{
+			result.emplace_back(stop, tree.times[vertex]);
+		}
+	}
+	sort(result.begin(), result.end(), [](const auto& lhs, const auto& rhs)
+		{
+			return make_pair(lhs.second, string_view{ lhs.first->name })
+				< make_pair(rhs.second, string_view{ rhs.first->name });
+		});
+	return result;
+}
+
+optional<RouteResult> TransportRouter::BuildRoute(const Stop* from, const Stop* to, bool use_astar) const
+{
+	VertexId target = GetWaitVertex(to);
+	ShortestPathTree tree = SearchFrom(GetWaitVertex(from), { target }, numeric_limits<double>::infinity(),
+		use_astar ? to : nullptr);
+	if (!tree.is_settled[target])
+	{
+		return nullopt;
+	}
+
+	RouteResult route;
+	route.total_time = tree.times[target];
+	route.settled_count = tree.settled_count;
+	for (optional<EdgeId> edge_id = tree.prev_edges[target]; edge_id;
+		edge_id = tree.prev_edges[graph_.GetEdge(*edge_id).from])
+	{
+		const EdgeInfo& info = edges_info_[*edge_id];
+		route.items.push_back({ info.stop, info.bus, info.span_count, graph_.GetEdge(*edge_id).weight });
+		if (info.bus)
+		{
+			++route.transfer_count;
+		}
+	}
+	reverse(route.items.begin(), route.items.end());
+	route.transfer_count = max(route.transfer_count - 1, 0);
+	return route;
+}
+
+const RoutingSettings& TransportRouter::GetRoutingSettings() const
+{
+	return settings_;
+}
+
+const DirectedWeightedGraph<double>& TransportRouter::GetGraph() const
+{
+	return graph_;
+}
+
+const EdgeInfo& TransportRouter::GetEdgeInfo(EdgeId edge_id) const
+{
+	return edges_info_.at(edge_id);
+}
+
+void TransportRouter::BuildGraph()
+{
+	VertexId vertex = 0;
+	for (const Stop& stop : tc_.GetStops())
+	{
+		stop_to_vertex_[&stop] = vertex;
+		vertex_to_stop_.push_back(&stop);
+		vertex_to_stop_.push_back(&stop);
+		graph_.AddEdge({ vertex, vertex + 1, static_cast<double>(settings_.bus_wait_time) });
+		edges_info_.push_back({ nullptr, &stop, 0 });
+		vertex += 2;
+	}
+
+	for (const Bus& bus : tc_.GetBuses())
+	{
+		const vector<const Stop*>& stops = bus.stops;
+		for (size_t i = 1; i < stops.size(); ++i)
+		{
+			double geo_distance = geo::ComputeDistance(stops[i - 1]->coordinates, stops[i]->coordinates);
+			double ride_time = ComputeRideTime(settings_, tc_.GetDistanceBetweenStops(stops[i - 1], stops[i]));
+			if (geo_distance > 0)
+			{
+				max_speed_ = ride_time > 0 ? max(max_speed_, geo_distance / ride_time)
+					: numeric_limits<double>::infinity();
+			}
+		}
+		for (size_t i = 0; i < stops.size(); ++i)
+		{
+			int distance = 0;
+			for (size_t j = i + 1; j < stops.size(); ++j)
+			{
+				distance += tc_.GetDistanceBetweenStops(stops[j - 1], stops[j]);
+				graph_.AddEdge({ GetBoardVertex(stops[i]), GetWaitVertex(stops[j]),
+					ComputeRideTime(settings_, distance) });
+				edges_info_.push_back({ &bus, stops[i], static_cast<int>(j - i) });
+			}
+		}
+	}
+}
+
+TransportRouter::ShortestPathTree TransportRouter::SearchFrom(VertexId source, const vector<VertexId>& targets,
+	double max_time, const Stop* heuristic_target) const
+{
+	const double infinity = numeric_limits<double>::infinity();
+	ShortestPathTree tree;
+	tree.times.assign(graph_.GetVertexCount(), infinity);
+	tree.prev_edges.assign(graph_.GetVertexCount(), nullopt);
+	tree.is_settled.assign(graph_.GetVertexCount(), false);
+
+	vector<bool> is_target(graph_.GetVertexCount(), false);
+	size_t unsettled_count = 0;
+	for (VertexId target : targets)
+	{
+		if (!is_target[target])
+		{
+			is_target[target] = true;
+			++unsettled_count;
+		}
+	}
+
+	// Элемент очереди: приоритет (время, для A* — плюс оценка остатка) и вершина
+	using QueueItem = pair<double, VertexId>;
+	priority_queue<QueueItem, vector<QueueItem>, greater<QueueItem>> queue;
+	vector<double> estimates(heuristic_target ? graph_.GetVertexCount() : 0, -1);
+	auto get_priority = [this, heuristic_target, &estimates](double time, VertexId vertex)
+	{
+		if (!heuristic_target)
+		{
+			return time;
+		}
+		if (estimates[vertex] < 0)
+		{
+			estimates[vertex] = EstimateTime(vertex, heuristic_target);
+		}
+		return time + estimates[vertex];
+	};
+	tree.times[source] = 0;
+	queue.push({ get_priority(0, source), source });
+	const bool has_targets = !targets.empty();
+	while (!queue.empty() && (!has_targets || unsettled_count > 0))
+	{
+		VertexId vertex = queue.top().second;
+		queue.pop();
+		if (tree.is_settled[vertex])
+		{
+			continue;
+		}
+		tree.is_settled[vertex] = true;
+		++tree.settled_count;
+		double time = tree.times[vertex];
+		if (is_target[vertex])
+		{
+			--unsettled_count;
+		}
+		for (EdgeId edge_id : graph_.GetIncidentEdges(vertex))
+		{
+			const Edge<double>& edge = graph_.GetEdge(edge_id);
+			double new_time = time + edge.weight;
+			if (new_time <= max_time && new_time < tree.times[edge.to])
+			{
+				tree.times[edge.to] = new_time;
+				tree.prev_edges[edge.to] = edge_id;
+				queue.push({ get_priority(new_time, edge.to), edge.to });
+			}
+		}
+	}
+	return tree;
+}
+
+double TransportRouter::EstimateTime(VertexId vertex, const Stop* target) const
+{
+	const Stop* stop = vertex_to_stop_[vertex];
+	if (stop == target)
+	{
+		return 0;
+	}
+	// Из вершины ожидания к другой остановке не уехать, не дождавшись автобуса
+	double wait_time = vertex == GetWaitVertex(stop) ? settings_.bus_wait_time : 0;
+	if (max_speed_ == 0 || max_speed_ == numeric_limits<double>::infinity())
+	{
+		return wait_time;
+	}
+	return wait_time + geo::ComputeDistance(stop->coordinates, target->coordinates) / max_speed_;
+}
+
+VertexId TransportRouter::GetWaitVertex(const Stop* stop) const
+{
+	return stop_to_vertex_.at(stop);
+}
+
+VertexId TransportRouter::GetBoardVertex(const Stop* stop) const
+{
+	return stop_to_vertex_.at(stop) + 1;
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include "transport_catalogue.h"
+#include "graph.h"
+
+#include <limits>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+namespace transport::router
+{
+
+enum class RoutingEngine
+{
+	GRAPH,
+	RAPTOR,
+};
+
+struct RoutingSettings
+{
+	int bus_wait_time = 0;
+	double bus_velocity = 0;
+	// Движок, используемый запросами Route без явного указания "engine"
+	RoutingEngine engine = RoutingEngine::GRAPH;
+	// Направленный поиск A* для запросов Route; false — обычный Дейкстра
+	bool use_astar = true;
+};
+
+// Сведения о ребре графа: ожидание на остановке (bus == nullptr) или поездка на автобусе
+struct EdgeInfo
+{
+	const domain::Bus* bus = nullptr;
+	const domain::Stop* stop = nullptr;
+	int span_count = 0;
+};
+
+// Элемент маршрута: ожидание на остановке stop (bus == nullptr) или поездка на автобусе bus от остановки stop
+struct RouteItem
+{
+	const domain::Stop* stop = nullptr;
+	const domain::Bus* bus = nullptr;
+	int span_count = 0;
+	double time = 0;
+};
+
+struct RouteResult
+{
+	double total_time = 0;
+	int transfer_count = 0;
+	std::vector<RouteItem> items;
+	// Число вершин графа, извлечённых из очереди при поиске (только движок GRAPH)
+	size_t settled_count = 0;
+};
+
+// Время поездки (в минутах) на расстояние distance (в метрах) при скорости из настроек
+double ComputeRideTime(const RoutingSettings& settings, double distance);
+
+/*
+* Строит граф маршрутов по каталогу. Каждой остановке соответствуют две вершины:
+* "ожидание" (в неё приходят автобусы) и "посадка" (из неё автобусы отправляются).
+* Ребро ожидания ведёт из первой во вторую, рёбра поездок — из посадки на одной
+* остановке в ожидание на любой последующей остановке того же маршрута.
+* После построения объект только читается и может использоваться из нескольких потоков
+*/
+class TransportRouter
+{
+public:
+	TransportRouter(const TransportCatalogue& tc, RoutingSettings settings);
+
+	// Время в пути (в минутах) от остановки from до каждой из остановок targets.
+	// Недостижимым остановкам соответствует std::nullopt
+	std::vector<std::optional<double>> ComputeTravelTimes(const domain::Stop* from,
+		const std::vector<const domain::Stop*>& targets) const;
+
+	// Остановки, достижимые из from не более чем за max_time минут, с временем в пути,
+	// упорядоченные по возрастанию времени. Поиск не раскрывает вершины дальше max_time
+	std::vector<std::pair<const domain::Stop*, double>> ComputeReachableStops(const domain::Stop* from,
+		double max_time) const;
+
+	// Оптимальный по времени маршрут между остановками. При use_astar поиск направляется
+	// эвристикой: расстояние по прямой до цели, делённое на максимальную скорость в каталоге
+	std::optional<RouteResult> BuildRoute(const domain::Stop* from, const domain::Stop* to, bool use_astar) const;
+
+	const RoutingSettings& GetRoutingSettings() const;
+	const graph::DirectedWeightedGraph<double>& GetGraph() const;
+	const EdgeInfo& GetEdgeInfo(graph::EdgeId edge_id) const;
+
+private:
+	struct ShortestPathTree
+	{
+		std::vector<double> times;
+		std::vector<std::optional<graph::EdgeId>> prev_edges;
+		std::vector<bool> is_settled;
+		size_t settled_count = 0;
+	};
+
+	// Дейкстра из source; поиск прекращается, как только все вершины targets получили итоговое время
+	// (при пустом targets — когда исчерпаны вершины не дальше max_time).
+	// Если задана heuristic_target, очередь упорядочивается по времени с оценкой остатка пути до неё (A*)
+	ShortestPathTree SearchFrom(graph::VertexId source, const std::vector<graph::VertexId>& targets,
+		double max_time = std::numeric_limits<double>::infinity(),
+		const domain::Stop* heuristic_target = nullptr) const;
+	// Нижняя оценка времени от вершины до остановки target
+	double EstimateTime(graph::VertexId vertex, const domain::Stop* target) const;
+	void BuildGraph();
+	graph::VertexId GetWaitVertex(const domain::Stop* stop) const;
+	graph::VertexId GetBoardVertex(const domain::Stop* stop) const;
+
+	const TransportCatalogue& tc_;
+	RoutingSettings settings_;
+	graph::DirectedWeightedGraph<double> graph_;
+	std::vector<EdgeInfo> edges_info_;
+	std::unordered_map<const domain::Stop*, graph::VertexId> stop_to_vertex_;
+	std::vector<const domain::Stop*> vertex_to_stop_;
+	// Максимальное отношение расстояния по прямой ко времени поездки среди всех перегонов (м/мин).
+	// С ним оценка EstimateTime не превышает реального времени в пути при любых road_distances
+	double max_speed_ = 0;
+};
+
+} // namespace transport::router